@@ -5,64 +5,21 @@
 #include "atk_mobilenet_object_classification.h"
 #include "mongoose.h"
 
-// Base64解码表
-static const unsigned char base64_table[256] = {
-    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
-    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
-    255,255,255,255,255,255,255,255,255,255,255,62,255,255,255,63,
-    52,53,54,55,56,57,58,59,60,61,255,255,255,0,255,255,
-    255,0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,
-    15,16,17,18,19,20,21,22,23,24,25,255,255,255,255,255,
-    255,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,
-    41,42,43,44,45,46,47,48,49,50,51,255,255,255,255,255,
-    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
-    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
-    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
-    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
-    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
-    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
-    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
-    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255
-};
-
 // Base64解码函数
 std::vector<unsigned char> base64_decode(const std::string &encoded_string) {
-    size_t in_len = encoded_string.size();
-    size_t i = 0, j = 0;
-    unsigned char char_array_4[4], char_array_3[3];
-    std::vector<unsigned char> decoded_data;
-
-    while (in_len-- && (encoded_string[i] != '=')) {
-        unsigned char c = base64_table[(unsigned char)encoded_string[i++]];
-        if (c == 255) continue; // 跳过无效字符
-        
-        char_array_4[j++] = c;
-        if (j == 4) {
-            char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-            char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-            char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
-
-            for (j = 0; j < 3; j++)
-                decoded_data.push_back(char_array_3[j]);
-            j = 0;
-        }
-    }
-
-    if (j) {
-        for (size_t k = j; k < 4; k++)
-            char_array_4[k] = 0;
-
-        char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-        char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-        char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
-
-        for (size_t k = 0; k < j - 1; k++)
-            decoded_data.push_back(char_array_3[k]);
-    }
-
+    std::vector<unsigned char> decoded_data(base64_decoded_capacity(encoded_string.size()));
+    decoded_data.resize(base64_decode_into(encoded_string.data(), encoded_string.size(),
+                                           decoded_data.data()));
     return decoded_data;
 }
 
+// 单调时钟（微秒），仅在开启计时时调用
+static inline double now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
 // 添加softmax函数
 static void softmax(float* input, size_t size) {
     float max_val = input[0];
@@ -87,35 +44,81 @@ static void softmax(float* input, size_t size) {
     }
 }
 
+// 每个请求的血常规特征数
+static const size_t kFeatureCount = 34;
+
+// 启动时用于核对原生求值器与cv::dnn输出的探测样本（README中的示例特征）
+static const float kProbeFeatures[34] = {
+    5, 1, 0, 1, 10.27f, 4.59f, 131, 38.9f, 84.7f, 28.5f,
+    337, 0.01f, 0.1f, 394, 39.3f, 12.8f, 8.9f, 9, 16.9f, 0.36f,
+    7.09f, 2.5f, 0.59f, 0.05f, 0.04f, 69.1f, 24.3f, 5.7f, 0.5f, 0.4f,
+    0.07f, 0.7f, 68.4f, 7
+};
+
 // SVM Model class
+// 可被多个线程同时调用：原生求值器只读共享同一份权重；cv::dnn 回退路径
+// 为每个并发调用方借出独立的 Net 实例，实例均由同一份只读模型字节构建
 class SVMModel {
 public:
-    SVMModel(const std::string& model_path) {
-        net = cv::dnn::readNetFromONNX(model_path);
+    SVMModel(const std::string& model_path) : dnn_instances(0) {
+        std::ifstream in(model_path.c_str(), std::ios::binary);
+        model_bytes.assign(std::istreambuf_iterator<char>(in),
+                           std::istreambuf_iterator<char>());
+        release_net(create_net());  // 预先构建一个实例
+
+        if (!g_config.svm_native) {
+            printf("ℹ️ 特征模型使用cv::dnn\n");
+            return;
+        }
+        std::string error;
+        if (!native.load(model_path, &error)) {
+            printf("⚠️ 原生特征模型不可用，回退到cv::dnn: %s\n", error.c_str());
+        } else if (native.output_size() != 3 || !verify_native()) {
+            printf("⚠️ 原生特征模型输出与cv::dnn不一致，回退到cv::dnn\n");
+            native = NativeMLP();
+        } else {
+            printf("✅ 原生特征模型已启用: %zu 层, 权重 %zu 字节\n",
+                   native.layer_count(), native.weight_bytes());
+        }
     }
 
-    float predict(const std::vector<float>& features) {
-        // 使用训练时相同的标准化方法
-        std::vector<float> normalized(features.size());
-        for (size_t i = 0; i < features.size(); i++) {
-            normalized[i] = features[i];  // 先复制原始数据
+    // probs_out 非空时写入各类别概率（失败时为0）
+    float predict(const float* features, size_t n, float* probs_out = nullptr) {
+        float logits[3], probs[3];
+        int max_index = predict_class(features, n, logits, probs);
+        if (probs_out) {
+            if (max_index < 0) memset(probs_out, 0, sizeof(probs));
+            else memcpy(probs_out, probs, sizeof(probs));
         }
-        
-        cv::Mat input(1, normalized.size(), CV_32F, (void*)normalized.data());
-        net.setInput(input);
-        cv::Mat output = net.forward();
-        
-        // 检查输出形状 - 现在应该是1x3的输出
-        if (output.rows != 1 || output.cols != 3) {
-            printf("⚠️ 模型输出形状错误: %d x %d (应为 1x3)\n", output.rows, output.cols);
+        if (max_index < 0) {
             return 0.0f;
         }
+
+        // 在predict函数中添加调试输出
+    printf("原始输出值: ");
+    for (int i = 0; i < 3; i++) {
+        printf("%.4f ", logits[i]);
+    }
+    printf("\n");
+
+    printf("Softmax后概率: ");
+    for (int i = 0; i < 3; i++) {
+        printf("%.4f ", probs[i]);
+    }
+    printf("\n");
         
-        // 找出最大概率的类别并应用softmax
-        float probs[3];
-        for (int i = 0; i < 3; i++) {
-            probs[i] = output.at<float>(0, i);
+        return static_cast<float>(max_index);  // 返回类别索引
+    }
+
+    // 不带调试输出的推理，logits/probs 各3个元素，返回类别索引，失败返回-1
+    int predict_class(const float* features, size_t n, float* logits, float* probs) {
+        double t0 = now_us();
+        if (!forward(features, n, logits)) {
+            return -1;
         }
+        
+        // 找出最大概率的类别并应用softmax
+        memcpy(probs, logits, 3 * sizeof(float));
         softmax(probs, 3);
         
         float max_prob = probs[0];
@@ -126,25 +129,134 @@ public:
                 max_index = i;
             }
         }
+        latency.record(now_us() - t0);
+        return max_index;
+    }
 
-        // 在predict函数中添加调试输出
-    printf("原始输出值: ");
-    for (int i = 0; i < 3; i++) {
-        printf("%.4f ", output.at<float>(0, i));
+    // rows 个样本（各 n 个特征，连续存放）一次求值，classes 与 probs（每样本3个）依次写入，
+    // 原生求值器按层处理整批，cv::dnn 回退路径一次前向整批
+    bool predict_batch(const float* features, size_t rows, size_t n, int* classes, float* probs) {
+        std::vector<float> logits(rows * 3);
+        if (!(native.loaded() && native.run_batch(features, rows, n, logits.data())) &&
+            !dnn_forward(features, rows, n, logits.data())) {
+            return false;
+        }
+        for (size_t r = 0; r < rows; r++) {
+            float* p = probs + r * 3;
+            memcpy(p, &logits[r * 3], 3 * sizeof(float));
+            softmax(p, 3);
+            classes[r] = 0;
+            for (int i = 1; i < 3; i++) {
+                if (p[i] > p[classes[r]]) classes[r] = i;
+            }
+        }
+        return true;
     }
-    printf("\n");
 
-    printf("Softmax后概率: ");
-    for (int i = 0; i < 3; i++) {
-        printf("%.4f ", probs[i]);
+    bool using_native() const { return native.loaded(); }
+    size_t native_weight_bytes() const { return native.weight_bytes(); }
+    size_t model_size() const { return model_bytes.size(); }
+    unsigned dnn_instance_count() const { return dnn_instances.load(); }
+    const LatencyStat& predict_latency() const { return latency; }
+    
+private:
+    // 计算模型原始输出（1x3），优先使用原生求值器
+    bool forward(const float* features, size_t n, float* out) {
+        if (native.loaded() && native.run(features, n, out)) {
+            return true;
+        }
+        return dnn_forward(features, 1, n, out);
     }
-    printf("\n");
+
+    // rows 个样本一次前向，输出 rows x 3
+    bool dnn_forward(const float* features, size_t rows, size_t n, float* out) {
+        cv::dnn::Net* net = acquire_net();
+
+        // 直接引用调用方的数据，不再复制
+        cv::Mat input((int)rows, (int)n, CV_32F, (void*)features);
+        net->setInput(input);
+        cv::Mat output = net->forward();
+        release_net(net);
         
-        return static_cast<float>(max_index);  // 返回类别索引
+        // 检查输出形状 - 现在应该是 rows x 3 的输出
+        if (output.rows != (int)rows || output.cols != 3) {
+            printf("⚠️ 模型输出形状错误: %d x %d (应为 %zux3)\n", output.rows, output.cols, rows);
+            return false;
+        }
+        for (size_t r = 0; r < rows; r++) {
+            for (int i = 0; i < 3; i++) {
+                out[r * 3 + i] = output.at<float>((int)r, i);
+            }
+        }
+        return true;
     }
-    
-private:
-    cv::dnn::Net net;
+
+    cv::dnn::Net* create_net() {
+        std::unique_ptr<cv::dnn::Net> net(new cv::dnn::Net(
+            cv::dnn::readNetFromONNX(model_bytes.data(), model_bytes.size())));
+        cv::dnn::Net* raw = net.get();
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        all_nets.push_back(std::move(net));
+        dnn_instances++;
+        return raw;
+    }
+
+    // 空闲实例不足时新建，实例数等于历史最大并发调用数
+    cv::dnn::Net* acquire_net() {
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            if (!idle_nets.empty()) {
+                cv::dnn::Net* net = idle_nets.back();
+                idle_nets.pop_back();
+                return net;
+            }
+        }
+        return create_net();
+    }
+
+    void release_net(cv::dnn::Net* net) {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        idle_nets.push_back(net);
+    }
+
+    // 用探测样本及其随机扰动比较两条路径的输出
+    bool verify_native() {
+        if (native.input_size() != 34) {
+            return false;
+        }
+        unsigned int seed = 12345;
+        float probe[34];
+        for (int round = 0; round < 16; round++) {
+            for (int i = 0; i < 34; i++) {
+                seed = seed * 1103515245u + 12345u;
+                float jitter = 0.5f + (seed >> 16) / 65536.0f;  // [0.5, 1.5)
+                probe[i] = round == 0 ? kProbeFeatures[i] : kProbeFeatures[i] * jitter;
+            }
+            float expect[3], got[3];
+            if (!dnn_forward(probe, 1, 34, expect) || !native.run(probe, 34, got)) {
+                return false;
+            }
+            for (int i = 0; i < 3; i++) {
+                float tol = 1e-3f * std::max(1.0f, fabsf(expect[i]));
+                if (fabsf(expect[i] - got[i]) > tol) {
+                    printf("⚠️ 样本%d 输出%d: cv::dnn=%.6f 原生=%.6f\n",
+                           round, i, expect[i], got[i]);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    std::vector<char> model_bytes;  // 只读，所有 Net 实例共用
+    NativeMLP native;               // run() 为 const 且不分配内存，可并发调用
+
+    std::mutex pool_mutex;          // 只保护实例借还，不覆盖推理过程
+    std::vector<std::unique_ptr<cv::dnn::Net> > all_nets;
+    std::vector<cv::dnn::Net*> idle_nets;
+    std::atomic<unsigned> dnn_instances;
+
+    LatencyStat latency;
 };
 
 // Weighted fusion function
@@ -167,116 +279,1407 @@ FusionResult weighted_fusion(float svm_score, float rknn_score,
     }
     res.svm_score = svm_score;
     res.rknn_score = rknn_score;
+    res.feature_only = false;
+    res.degraded = false;
+    res.cached = false;
+    res.coalesced = false;
+    res.near_duplicate = false;
+    res.backend = kBackendNone;
+    memset(res.svm_probs, 0, sizeof(res.svm_probs));  // 由调用方填入
+    memset(res.rknn_probs, 0, sizeof(res.rknn_probs));
     return res;
 }
 
 // Global SVM model instance
 static SVMModel* svm_model = nullptr;
 
-#define HTTP_PORT "8080"
-static const char *s_listen_addr = "http://0.0.0.0:" HTTP_PORT;
+// 特征模型等CPU任务的工作线程池（--cpu-workers=0 时为空，顺序执行）
+static WorkerPool* s_cpu_pool = nullptr;
+
+// 分类请求工作线程池（--request-workers=0 时为空，在事件循环中处理）
+static WorkerPool* s_request_pool = nullptr;
+
+// 过载降级策略
+static OverloadGuard s_overload;
+
+// 推理结果后台写入
+static ResultWriter s_result_writer;
+
+// 按输入内容哈希缓存的最终结果
+static ResultCache s_result_cache;
+
+// 近似重复图像的RKNN结果（--near-dup）
+static NearDupCache s_near_dup;
+
+// 处理中的输入（singleflight）：内容相同的后到请求挂在领头请求上，不重复计算
+struct ClassifyJob;
+struct InflightCall {
+    std::vector<float> features;  // 与 image_len 一起校验，排除哈希冲突
+    size_t image_len;
+    std::vector<std::shared_ptr<ClassifyJob> > waiters;
+};
+static std::mutex s_inflight_mutex;
+static std::unordered_map<uint64_t, std::shared_ptr<InflightCall> > s_inflight;
+
+// 请求编号，随结果一起保存与返回
+static std::atomic<uint64_t> s_next_request_id(0);
+
+// 模型文件内容哈希低32位，作为结果记录中的模型版本
+static uint32_t s_rknn_model_version = 0;
+static uint32_t s_svm_model_version = 0;
+
+// 收到 SIGINT/SIGTERM 后退出事件循环，写完剩余结果
+static volatile sig_atomic_t s_signo = 0;
+
+ServerConfig g_config;
+
+// 服务器运行统计，由 /api/metrics 输出
+struct ServerStats {
+    std::chrono::steady_clock::time_point start;
+    std::atomic<uint64_t> requests;  // /api/classify 请求数
+    std::atomic<uint64_t> errors;    // 其中返回错误的请求数
+    LatencyStat total;               // 成功请求的总耗时
+
+    // 各阶段耗时（--stage-metrics）
+    LatencyStat dispatch;   // 等待请求工作线程
+    LatencyStat parse, base64, queue, decode, preprocess, npu, svm;
+    LatencyStat join_wait;  // NPU完成后等待特征模型的时间
+    LatencyStat parallel;   // NPU与特征模型并行段的墙钟时间
+    LatencyStat fusion;
+
+    // 相同输入合并：领头请求数与挂到领头请求上的请求数
+    std::atomic<uint64_t> coalesce_leaders;
+    std::atomic<uint64_t> coalesced;
+
+    // 级联模式：按特征模型预测类别统计判断次数与直接返回次数
+    std::atomic<uint64_t> cascade_evaluated[3];
+    std::atomic<uint64_t> cascade_hits[3];
+
+    ServerStats() : start(std::chrono::steady_clock::now()), requests(0), errors(0),
+                    coalesce_leaders(0), coalesced(0) {
+        for (int i = 0; i < 3; i++) {
+            cascade_evaluated[i] = 0;
+            cascade_hits[i] = 0;
+        }
+    }
+
+    void record_stages(const RequestTiming &t) {
+        dispatch.record(t.dispatch_us);
+        parse.record(t.parse_us);
+        base64.record(t.base64_us);
+        queue.record(t.queue_us);
+        decode.record(t.decode_us);
+        preprocess.record(t.preprocess_us);
+        npu.record(t.npu_us);
+        svm.record(t.svm_us);
+        join_wait.record(t.join_wait_us);
+        parallel.record(t.parallel_us);
+        fusion.record(t.fusion_us);
+    }
+};
+static ServerStats s_stats;
+
 static struct mg_mgr mgr;
 
-// 封装原有分类逻辑
-static ClassificationResult classify_image(const void *data, size_t len) {
-  ClassificationResult res = {0, 0.0f};  // 简单初始化：class_id=0, probability=0.0
-  
-  // 将静态变量改为局部静态确保线程安全
-  static std::once_flag init_flag;
-  static rknn_context ctx;
-  static rknn_input_output_num io_num;
-  static int model_width = 0, model_height = 0;
-
-  std::call_once(init_flag, [&](){
-      const char *model_path = "./model.rknn";
-      int model_len = 0;
-      unsigned char *model = load_model(model_path, &model_len);
-      if (rknn_init(&ctx, model, model_len, 0) < 0) {
-          fprintf(stderr, "Model init failed\n");
+// 图像模型主后端（--backend，默认NPU），首次分类时初始化
+static std::once_flag s_npu_init_flag;
+static std::mutex s_npu_mutex;  // 后端同一时间只允许一个请求使用
+static InferenceBackend *s_backend = nullptr;
+static int s_model_width = 0, s_model_height = 0;
+static int s_model_batch = 1;   // 输入张量的批大小
+static NpuBatcher *s_npu_batcher = nullptr;  // 批大小>1的模型经由微批处理线程推理
+
+static const char *backend_name(int backend) {
+    if (backend == kBackendNpu) {
+        return g_config.backend == "onnx" ? "onnx" : "npu";
+    }
+    return backend == kBackendCpu ? "cpu" : "none";
+}
+
+// CPU后端（--cpu-model），NPU排队过长时由溢出调度选用
+static CpuClassifier *s_cpu_classifier = nullptr;
+static OverflowScheduler s_overflow;
+
+// 流量采集（--capture-dir）
+static TrafficCapture s_capture;
+
+// 解码后图像的缓冲池（--mat-pool-mb）
+static PooledMatAllocator s_mat_pool;
+
+// 并发解码的内存预算（--decode-budget-mb）
+static DecodeBudget s_decode_budget;
+// 流式接收预分配缓冲的内存预算（--stream-budget-mb），在事件循环中申请，不等待
+static DecodeBudget s_stream_budget;
+
+// 图像解码与缩放后端（--decoder/--resizer）
+static const ImageDecoder *s_decoder = find_image_decoder("opencv");
+static const ImageResizer *s_resizer = find_image_resizer("opencv");
+
+// 请求等待及使用NPU期间计入溢出调度的NPU排队数
+struct NpuPending {
+    double npu_us;  // 成功时设为每张图像的NPU耗时
+    NpuPending() : npu_us(0) { s_overflow.npu_enter(); }
+    ~NpuPending() { s_overflow.npu_leave(npu_us); }
+};
+
+// 主后端的模型文件：RKNN 为 ./model.rknn，ONNX 为 --cpu-model
+static std::string image_model_path() {
+  return g_config.backend == "onnx" ? g_config.cpu_model : std::string("./model.rknn");
+}
+
+// CPU后端与ONNX主后端共用的输入尺寸与归一化参数
+static OnnxBackend::Options onnx_options(int width, int height) {
+  OnnxBackend::Options opt;
+  opt.width = width;
+  opt.height = height;
+  memcpy(opt.mean, g_config.cpu_mean, sizeof(opt.mean));
+  memcpy(opt.std, g_config.cpu_std, sizeof(opt.std));
+  opt.swap_rb = g_config.cpu_swap_rb;
+  return opt;
+}
+
+// 一次推理 s_model_batch 个输入（连续存放），前 count 个有效，输出按批内顺序排列
+static bool npu_run_batch(const uint8_t *input, int count, NpuBatchOutput *results) {
+  size_t bytes = (size_t)s_model_width * s_model_height * 3 * s_model_batch;
+  const float *output;
+  size_t output_count;
+  if (!s_backend->set_input(input, bytes) || !s_backend->run() ||
+      !s_backend->get_outputs(&output, &output_count)) {
+    return false;
+  }
+  // 第一个输出为分类结果，按批次均分
+  size_t per_item = output_count / s_model_batch;
+  for (int i = 0; i < count; i++) {
+    ClassificationResult r = {0, 0.0f, false, kBackendNone};
+    if (per_item >= 3) {
+      float scores[3];  // rknn_GetResult 原地做softmax，不改动后端的输出缓冲
+      memcpy(scores, output + i * per_item, sizeof(scores));
+      rknn_GetResult(scores, &r);
+    }
+    results[i].class_id = r.class_id;
+    results[i].probability = r.probability;
+    memcpy(results[i].probs, r.probs, sizeof(r.probs));
+    results[i].ok = per_item >= 3;
+  }
+  s_backend->release_outputs();
+  return true;
+}
+
+static void npu_init() {
+  std::call_once(s_npu_init_flag, [](){
+      std::string model_path = image_model_path();
+      if (g_config.backend == "onnx") {
+          s_backend = new OnnxBackend(onnx_options(g_config.onnx_width, g_config.onnx_height));
+      } else {
+          s_backend = new RknnBackend();
+      }
+      std::string error;
+      BackendAttrs attrs;
+      if (!s_backend->load(model_path, &error) || !s_backend->query(&attrs)) {
+          fprintf(stderr, "Model init failed: %s %s\n", model_path.c_str(), error.c_str());
           exit(1);
       }
+      printf("模型信息: 后端=%s, 输出数量=%d\n", s_backend->name(), attrs.n_outputs);
 
-      // 查询输入输出数量
-      if (rknn_query(ctx, RKNN_QUERY_IN_OUT_NUM, &io_num, sizeof(io_num)) < 0) {
-          fprintf(stderr, "查询输入输出数量失败\n");
+      s_model_width = attrs.width;
+      s_model_height = attrs.height;
+      s_model_batch = attrs.batch;
+      printf("模型输入: %dx%d, 批大小=%d\n", s_model_width, s_model_height, s_model_batch);
+
+      if (s_model_batch > NpuBatcher::kMaxBatch) {
+          fprintf(stderr, "模型批大小 %d 超过上限 %d\n", s_model_batch, NpuBatcher::kMaxBatch);
           exit(1);
       }
-      printf("模型信息: 输入数量=%d, 输出数量=%d\n", 
-             io_num.n_input, io_num.n_output);
-
-      // 初始化模型尺寸
-      rknn_tensor_attr input_attr = {0};
-      input_attr.index = 0;
-      rknn_query(ctx, RKNN_QUERY_INPUT_ATTR, &input_attr, sizeof(input_attr));
-      model_width = input_attr.dims[1];
-      model_height = input_attr.dims[2];
+      if (s_model_batch > 1) {
+          s_npu_batcher = new NpuBatcher(s_model_batch, g_config.npu_batch_window_us,
+                                         (size_t)s_model_width * s_model_height * 3,
+                                         npu_run_batch);
+          printf("✅ NPU微批处理已启用: 最多 %d 张/批, 等待窗口 %d 微秒\n",
+                 s_model_batch, g_config.npu_batch_window_us);
+      }
   });
+}
+
+// 封装原有分类逻辑
+// timing 非空时记录 queue/decode/preprocess/npu 各阶段耗时
+static ClassificationResult classify_image(const void *data, size_t len,
+                                           RequestTiming *timing = nullptr,
+                                           DecodeReservation *reservation = nullptr) {
+  ClassificationResult res = {0, 0.0f, false, kBackendNone};  // 简单初始化：class_id=0, probability=0.0
+  ArenaScope arena_scope;
+  bool timed = timing || s_overflow.enabled();  // 溢出调度需要NPU耗时样本
+  double t0 = timed ? now_us() : 0;
+  
+  npu_init();
+  int model_width = s_model_width, model_height = s_model_height;
 
-  // 将二进制数据解码为OpenCV Mat
-  cv::Mat img = cv::imdecode(cv::Mat(1, len, CV_8U, (void*)data), cv::IMREAD_COLOR);
-  if (img.empty()) {
+  // 将二进制数据解码为OpenCV Mat，缓冲取自缓冲池
+  cv::Mat img;
+  s_mat_pool.attach(img);
+  if (!s_decoder->decode(data, len, img)) {
     fprintf(stderr, "Image decode failed\n");
     return res;
   }
 
-  // 图像预处理
-  cv::Mat resized_img;
-  cv::resize(img, resized_img, cv::Size(model_width, model_height));
+  double t1 = timed ? now_us() : 0;
 
-  // 设置输入
-  rknn_input inputs[1];
-  memset(inputs, 0, sizeof(inputs));
-  inputs[0].index = 0;
-  inputs[0].buf = resized_img.data;
-  inputs[0].size = (uint32_t)(model_width * model_height * 3);
-  inputs[0].pass_through = false;
-  inputs[0].type = RKNN_TENSOR_UINT8;
-  inputs[0].fmt = RKNN_TENSOR_NHWC;
-  
-  if (rknn_inputs_set(ctx, 1, inputs) < 0) {
-    fprintf(stderr, "设置输入失败\n");
+  // 图像预处理：缩放结果直接写入请求内存
+  cv::Mat resized_img(model_height, model_width, CV_8UC3,
+                      RequestArena::current().allocate((size_t)model_width * model_height * 3));
+  s_resizer->resize(img, resized_img);
+  // 之后只用缩放图，解码图像交还缓冲池并归还解码内存预算
+  img.release();
+  if (reservation) reservation->release();
+
+  // 近似重复图像：在送入模型的缩放图上计算感知哈希，命中时复用之前的结果，不进入NPU
+  uint64_t phash = 0;
+  if (s_near_dup.enabled()) {
+    phash = perceptual_hash(resized_img);
+    int distance = 0;
+    if (s_near_dup.lookup(phash, &res.class_id, &res.probability, res.probs, &distance)) {
+      res.near_duplicate = true;
+      printf("近似重复图像: 汉明距离=%d, class=%d, probability=%.4f\n",
+             distance, res.class_id, res.probability);
+      if (timing) {
+        timing->decode_us = t1 - t0;
+        timing->preprocess_us = now_us() - t1;
+      }
+      return res;
+    }
+  }
+
+  double t2 = timed ? now_us() : 0;
+
+  // NPU排队过长且CPU后端空闲时改由CPU推理
+  if (s_cpu_classifier && s_overflow.try_cpu()) {
+    float logits[3];
+    bool ok = s_cpu_classifier->classify(resized_img, logits, 3);
+    double cpu_us = now_us() - t2;
+    s_overflow.cpu_done(cpu_us, ok);
+    if (!ok) {
+      return res;
+    }
+    rknn_GetResult(logits, &res);
+    res.backend = kBackendCpu;
+    printf("分类结果 (CPU):\n  class=%d, probability=%.4f\n", res.class_id, res.probability);
+    if (s_near_dup.enabled()) {
+      s_near_dup.insert(phash, res.class_id, res.probability, res.probs);
+    }
+    if (timing) {
+      timing->decode_us = t1 - t0;
+      timing->preprocess_us = t2 - t1;
+      timing->npu_us = cpu_us;
+    }
     return res;
   }
 
-  // 执行推理
-  if (rknn_run(ctx, nullptr) < 0) {
-    fprintf(stderr, "Inference failed\n");
+  NpuPending pending;
+
+  // 批大小>1的模型：交给微批处理线程，与其他请求拼成一批推理
+  if (s_npu_batcher) {
+    double wait_us = 0, run_us = 0;
+    int fill = 0;
+    NpuBatchOutput out = s_npu_batcher->submit(resized_img.data, &wait_us, &run_us, &fill);
+    if (!out.ok) {
+      fprintf(stderr, "批量推理失败\n");
+      return res;
+    }
+    res.class_id = out.class_id;
+    res.probability = out.probability;
+    memcpy(res.probs, out.probs, sizeof(res.probs));
+    res.backend = kBackendNpu;
+    pending.npu_us = run_us / std::max(1, fill);
+    printf("分类结果 (批内 %d 张):\n  class=%d, probability=%.4f\n",
+           fill, res.class_id, res.probability);
+    if (s_near_dup.enabled()) {
+      s_near_dup.insert(phash, res.class_id, res.probability, res.probs);
+    }
+    if (timing) {
+      timing->decode_us = t1 - t0;
+      timing->preprocess_us = t2 - t1;
+      timing->queue_us = wait_us;
+      timing->npu_us = run_us;
+      timing->npu_batch = fill;
+    }
     return res;
   }
 
-  // 获取输出
-  rknn_output outputs[io_num.n_output];
-  memset(outputs, 0, sizeof(outputs));
-  for (int i = 0; i < io_num.n_output; i++) {
-      outputs[i].want_float = 1;
+  std::lock_guard<std::mutex> npu_lock(s_npu_mutex);
+  double t3 = timed ? now_us() : 0;
+
+  NpuBatchOutput out;
+  if (!npu_run_batch(resized_img.data, 1, &out) || !out.ok) {
+    return res;
   }
-  
-  if (rknn_outputs_get(ctx, io_num.n_output, outputs, NULL) < 0) {
-      fprintf(stderr, "获取输出失败\n");
-      return res;
+  res.class_id = out.class_id;
+  res.probability = out.probability;
+  memcpy(res.probs, out.probs, sizeof(res.probs));
+  res.backend = kBackendNpu;
+
+  // 打印结果用于调试
+  printf("分类结果:\n");
+  printf("  class=%d, probability=%.4f\n", res.class_id, res.probability);
+
+  if (s_near_dup.enabled()) {
+    s_near_dup.insert(phash, res.class_id, res.probability, res.probs);
   }
 
-  // 处理每个输出
-  for (int i = 0; i < io_num.n_output; i++) {
-      float *buffer = (float *)outputs[i].buf;
-      
-      printf("处理输出 %d: 大小=%u 字节\n", i, outputs[i].size);
-      
-      // 只处理第一个输出（假设这是分类结果）
-      if (i == 0) {
-          rknn_GetResult(buffer, &res);
+  double t4 = timed ? now_us() : 0;
+  pending.npu_us = t4 - t3;
+  if (timing) {
+      timing->decode_us = t1 - t0;
+      timing->preprocess_us = t2 - t1;
+      timing->queue_us = t3 - t2;
+      timing->npu_us = t4 - t3;
+      timing->npu_batch = 1;
+  }
+  
+  return res;
+}
+
+// 从请求JSON中解析34个特征值到 features[kFeatureCount]，失败时返回错误响应体
+// 直接在请求体上逐个数值解析（忽略空格与方括号），不产生临时字符串
+static const char *parse_features(const std::string &json_str, float *features) {
+  size_t count = 0;
+  size_t features_pos = json_str.find("\"features\":[");
+  if (features_pos != std::string::npos) {
+      size_t start = features_pos + 11;
+      size_t end = json_str.find("]", start);
+      if (end != std::string::npos) {
+          const char *p = json_str.data() + start;
+          const char *last = json_str.data() + end;
+          
+          // 验证字符串是否只包含数字和逗号
+          for (const char *q = p; q < last; q++) {
+              if (!strchr("0123456789,.-[] ", *q) || *q == '\0') {
+                  printf("⚠️ 特征格式错误: 包含非法字符\n");
+                  printf("原始特征字符串: %.*s\n", (int)(last - p), p);
+                  return "{\"error\":\"Invalid features format: contains invalid characters\"}";
+              }
+          }
           
-          // 打印结果用于调试
-          printf("分类结果:\n");
-          printf("  class=%d, probability=%.4f\n", 
-                 res.class_id, res.probability);
+          // 逗号分隔，空项跳过
+          char num[64];
+          while (p < last) {
+              size_t len = 0;
+              for (; p < last && *p != ','; p++) {
+                  if (*p != ' ' && *p != '[' && len + 1 < sizeof(num)) num[len++] = *p;
+              }
+              if (p < last) p++;  // 跳过逗号
+              if (len == 0) continue;
+              num[len] = '\0';
+              char *num_end;
+              float v = strtof(num, &num_end);
+              if (num_end == num) {
+                  printf("⚠️ 特征解析失败: %s\n", num);
+                  return "{\"error\":\"Invalid features format: failed to parse numbers\"}";
+              }
+              if (count < kFeatureCount) features[count] = v;
+              count++;
+          }
       }
   }
+  
+  // 检查特征数量
+  if (count != kFeatureCount) {
+      printf("⚠️ 特征数量错误: 期望34个，实际收到%zu个\n", count);
+      return "{\"error\":\"Invalid features: expected 34 features\"}";
+  }
+  return nullptr;
+}
+
+// 生成 Server-Timing 响应头（dur 单位为毫秒）
+static void format_server_timing(const RequestTiming &t, char *buf, size_t size) {
+  snprintf(buf, size,
+           "Server-Timing: dispatch;dur=%.3f, parse;dur=%.3f, b64;dur=%.3f, queue;dur=%.3f, "
+           "decode;dur=%.3f, preprocess;dur=%.3f, npu;dur=%.3f, svm;dur=%.3f, "
+           "join;dur=%.3f, parallel;dur=%.3f, fusion;dur=%.3f, total;dur=%.3f\r\n",
+           t.dispatch_us / 1e3, t.parse_us / 1e3, t.base64_us / 1e3, t.queue_us / 1e3,
+           t.decode_us / 1e3, t.preprocess_us / 1e3, t.npu_us / 1e3,
+           t.svm_us / 1e3, t.join_wait_us / 1e3, t.parallel_us / 1e3,
+           t.fusion_us / 1e3, t.total_us / 1e3);
+}
+
+// 生成响应JSON中的 timing 对象（前置逗号，直接拼接在结果字段之后）
+static void format_timing_json(const RequestTiming &t, char *buf, size_t size) {
+  snprintf(buf, size,
+           ",\"timing\":{\"dispatch_ms\":%.3f,\"parse_ms\":%.3f,\"base64_ms\":%.3f,\"queue_ms\":%.3f,"
+           "\"decode_ms\":%.3f,\"preprocess_ms\":%.3f,\"npu_ms\":%.3f,"
+           "\"svm_ms\":%.3f,\"join_wait_ms\":%.3f,\"parallel_ms\":%.3f,"
+           "\"fusion_ms\":%.3f,\"total_ms\":%.3f}",
+           t.dispatch_us / 1e3, t.parse_us / 1e3, t.base64_us / 1e3, t.queue_us / 1e3,
+           t.decode_us / 1e3, t.preprocess_us / 1e3, t.npu_us / 1e3,
+           t.svm_us / 1e3, t.join_wait_us / 1e3, t.parallel_us / 1e3,
+           t.fusion_us / 1e3, t.total_us / 1e3);
+}
+
+// 一次 /api/classify 请求，可在事件循环或请求工作线程中处理
+struct ClassifyJob : std::enable_shared_from_this<ClassifyJob> {
+    unsigned long conn_id;
+    std::string body;        // 请求体副本
+    struct timespec start;   // 事件循环收到完整请求的时刻
+    double received_us;      // 同上，用于计算调度排队时间
+    bool degraded;           // 过载降级：只用特征模型应答
+    bool admitted;           // 已计入 OverloadGuard 的NPU积压
+    uint64_t request_id;
+    uint64_t input_hash;     // 解析完成后计算
+    bool capture;            // 被流量采集抽中
+    uint64_t arrival_unix_us;
+    std::unique_ptr<StreamingBody> stream;  // 流式接收时已解码的图像，body 中image字段为空
+    std::unique_ptr<DecodeReservation> stream_reservation;  // stream 占用的流式接收预算
+};
+
+// 处理结果，由事件循环发送
+struct ClassifyReply {
+    int status;
+    std::string headers;
+    std::string body;
+};
+
+static std::string pack_reply(const ClassifyReply &reply);
+
+// 把请求与响应写入流量存档，耗时从事件循环收到完整请求算起
+static void capture_reply(const ClassifyJob &job, const ClassifyReply &reply) {
+  if (job.capture) {
+    s_capture.record(job.arrival_unix_us, now_us() - job.received_us, reply.status,
+                     job.body, reply.body);
+  }
+}
 
-  // 确保释放输出资源
-  rknn_outputs_release(ctx, io_num.n_output, outputs);
+// 设置错误响应并计数
+static void set_error(ClassifyReply *reply, int code, const char *body) {
+  s_stats.errors++;
+  reply->status = code;
+  reply->headers.clear();
+  reply->body = body;
+}
+
+// 生成分类结果响应，记录统计并保存结果
+static void finish_classify(ClassifyReply *reply, const FusionResult &final_res,
+                            RequestTiming &timing, const ClassifyJob &job) {
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed = (end.tv_sec - job.start.tv_sec) +
+                  (end.tv_nsec - job.start.tv_nsec) / 1e9;
+  printf("🕒 处理耗时: %.3f 秒\n", elapsed);
+  timing.total_us = elapsed * 1e6;
+  s_stats.total.record(timing.total_us);
+  if (g_config.stage_metrics) {
+      s_stats.record_stages(timing);
+  }
   
-  return res;
+  printf("📤 发送响应...\n");
+
+  // Generate JSON response
+  char timing_json[384] = "";
+  char timing_header[512] = "";
+  if (g_config.timing_json) {
+      format_timing_json(timing, timing_json, sizeof(timing_json));
+  }
+  if (g_config.timing_header) {
+      format_server_timing(timing, timing_header, sizeof(timing_header));
+  }
+
+  char json_response[1024];
+  snprintf(json_response, sizeof(json_response),
+      "{\"class\":%d,\"probability\":%.4f,\"blood_score\":%.4f,\"rknn_score\":%.4f,"
+      "\"request_id\":%llu,\"backend\":\"%s\"%s%s%s%s%s%s}",
+      final_res.class_id,
+      final_res.probability,
+      final_res.svm_score,
+      final_res.rknn_score,
+      (unsigned long long)job.request_id,
+      backend_name(final_res.backend),
+      final_res.feature_only ? ",\"feature_only\":true" : "",
+      final_res.degraded ? ",\"degraded\":true" : "",
+      final_res.cached ? ",\"cached\":true" : "",
+      final_res.coalesced ? ",\"coalesced\":true" : "",
+      final_res.near_duplicate ? ",\"near_duplicate\":true" : "",
+      timing_json);
+
+  printf("%s: 类别=%d, 概率=%.4f, 血常规分数=%.4f, RKNN分数=%.4f\n",
+         final_res.cached ? "缓存结果" : final_res.coalesced ? "合并请求结果" :
+         final_res.feature_only ? "特征模型结果" : "融合结果",
+         final_res.class_id, final_res.probability,
+         final_res.svm_score, final_res.rknn_score);
+
+  char headers[640];
+  snprintf(headers, sizeof(headers), "Content-Type: application/json\r\n%s",
+           timing_header);
+  reply->status = 200;
+  reply->headers = headers;
+  reply->body = json_response;
+
+  // 保存推理结果
+  save_inference_result(final_res, timing, job.request_id, job.input_hash);
+}
+
+// 定位 "image" 字段的字符串内容（不含引号）
+static bool find_image_field(const std::string &json_str, size_t *start, size_t *len) {
+  size_t image_pos = json_str.find("\"image\":");
+  if (image_pos == std::string::npos) return false;
+  size_t begin = json_str.find("\"", image_pos + 8);
+  if (begin == std::string::npos) return false;
+  size_t end = json_str.find("\"", begin + 1);
+  if (end == std::string::npos) return false;
+  *start = begin + 1;
+  *len = end - begin - 1;
+  return true;
+}
+
+// 图像尺寸超过 --max-image-pixels/--max-image-side，或解码所需内存超过整个预算
+static bool image_too_large(const ImageInfo &info) {
+  size_t bytes = s_decoder->decode_bytes(info);
+  bool too_large =
+      (g_config.max_image_pixels > 0 &&
+       (uint64_t)info.width * info.height > g_config.max_image_pixels) ||
+      (g_config.max_image_side > 0 &&
+       (info.width > g_config.max_image_side || info.height > g_config.max_image_side)) ||
+      !s_decode_budget.fits(bytes);
+  if (too_large) {
+    printf("⚠️ 图像过大: %s %dx%d, %d通道, 预计解码内存 %.1f MB\n",
+           image_format_name(info.format), info.width, info.height, info.components,
+           bytes / (1024.0 * 1024.0));
+  }
+  return too_large;
+}
+
+// 只用特征模型给出结果（级联命中或过载降级）
+static bool feature_only_result(const float *features, RequestTiming *tp,
+                                FusionResult *res, float *confidence) {
+  double t0 = tp ? now_us() : 0;
+  float logits[3], probs[3];
+  int cls = svm_model->predict_class(features, kFeatureCount, logits, probs);
+  if (tp) tp->svm_us = now_us() - t0;
+  if (cls < 0) {
+      return false;
+  }
+  *res = FusionResult();
+  res->class_id = cls;
+  res->probability = probs[cls];
+  res->svm_score = (float)cls;
+  memcpy(res->svm_probs, probs, sizeof(res->svm_probs));
+  res->feature_only = true;
+  *confidence = probs[cls];
+  return true;
+}
+
+// 把本次计算的结果放入缓存，cost_us 为本次请求总耗时
+static void cache_result(const ClassifyJob &job, const float *features, size_t image_len,
+                         uint64_t image_check, const FusionResult &res, double cost_us) {
+  CachedResult cached;
+  cached.class_id = res.class_id;
+  cached.probability = res.probability;
+  cached.svm_score = res.svm_score;
+  cached.rknn_score = res.rknn_score;
+  memcpy(cached.svm_probs, res.svm_probs, sizeof(cached.svm_probs));
+  memcpy(cached.rknn_probs, res.rknn_probs, sizeof(cached.rknn_probs));
+  cached.feature_only = res.feature_only;
+  cached.backend = res.backend;
+  s_result_cache.insert(job.input_hash, features, kFeatureCount, image_len, image_check,
+                        cached, cost_us);
+}
+
+// 领头请求结束（成功或出错）时从表中移除，并为每个挂起的请求生成响应
+struct InflightLeader {
+    uint64_t key;
+    bool active;
+    const ClassifyReply *reply;
+    FusionResult res;
+    bool has_res;  // 成功时为 true，否则挂起的请求收到相同的错误响应
+
+    InflightLeader() : key(0), active(false), reply(nullptr), has_res(false) {}
+    ~InflightLeader() {
+        if (!active) return;
+        std::shared_ptr<InflightCall> call;
+        {
+            std::lock_guard<std::mutex> lock(s_inflight_mutex);
+            auto it = s_inflight.find(key);
+            if (it == s_inflight.end()) return;
+            call = it->second;
+            s_inflight.erase(it);
+        }
+        for (size_t i = 0; i < call->waiters.size(); i++) {
+            ClassifyJob &waiter = *call->waiters[i];
+            ClassifyReply r;
+            if (has_res) {
+                FusionResult shared = res;
+                shared.coalesced = true;
+                RequestTiming timing = {};
+                finish_classify(&r, shared, timing, waiter);
+            } else {
+                s_stats.errors++;
+                r = *reply;
+            }
+            capture_reply(waiter, r);
+            std::string packed = pack_reply(r);
+            mg_wakeup(&mgr, waiter.conn_id, packed.data(), packed.size());
+        }
+    }
+};
+
+// 请求离开NPU路径时（正常完成或提前返回）从积压中扣除
+struct BacklogGuard {
+    bool active;
+    explicit BacklogGuard(bool admitted) : active(admitted) {}
+    ~BacklogGuard() { release(); }
+    void release() {
+        if (active) s_overload.leave();
+        active = false;
+    }
+};
+
+// 分类流水线：解析、级联/降级判断、Base64解码、NPU与特征模型fork/join、融合
+// 返回 false 表示已挂到处理中的相同请求上，响应由领头请求发出。golden 工具也直接调用
+bool process_classify(ClassifyJob &job, ClassifyReply *reply) {
+  // 析构顺序：先分发合并请求的结果，再释放NPU积压，最后复位请求内存
+  ArenaScope arena_scope;
+  BacklogGuard backlog(job.admitted);
+  InflightLeader leader;
+  leader.reply = reply;
+
+  // 仅在开启计时输出、阶段统计或过载降级时才采集各阶段时间戳
+  bool want_timing = g_config.timing_header || g_config.timing_json ||
+                     g_config.stage_metrics || s_overload.enabled();
+  RequestTiming timing = {};
+  RequestTiming *tp = want_timing ? &timing : nullptr;
+  double ts = tp ? now_us() : 0;
+  if (tp) tp->dispatch_us = ts - job.received_us;
+  
+  // Simple JSON parser
+  const std::string &json_str = job.body;
+  
+  // Extract features with error handling
+  float features[kFeatureCount];
+  const char *feature_error = parse_features(json_str, features);
+  if (feature_error) {
+      set_error(reply, 400, feature_error);
+      return true;
+  }
+
+  // 输入内容哈希：image字段base64文本的哈希作为种子，再计算特征值
+  // 流式接收时图像文本先于特征值到达，因此先对图像单独计算
+  StreamingBody *stream = job.stream.get();
+  size_t image_start = 0, image_len = 0;
+  bool has_image;
+  // image_check 为另一种子的哈希，只供结果缓存校验键冲突
+  uint64_t image_hash = 0, image_check = 0;
+  if (stream) {
+      has_image = stream->has_image();
+      image_len = stream->image_text_len();
+      image_hash = stream->image_hash();
+      image_check = stream->image_check();
+  } else {
+      has_image = find_image_field(json_str, &image_start, &image_len);
+      if (has_image && image_len) {
+          image_hash = content_hash64(json_str.data() + image_start, image_len);
+          if (s_result_cache.enabled()) {
+              image_check = content_hash64(json_str.data() + image_start, image_len,
+                                           kContentCheckSeed);
+          }
+      }
+  }
+  job.input_hash = content_hash64(features, sizeof(features), image_hash);
+
+  // 结果缓存：相同图像与特征直接返回上次的结果，不解码、不进入NPU（降级时同样优先）
+  if (s_result_cache.enabled()) {
+      CachedResult cached;
+      double saved_us = 0;
+      if (s_result_cache.lookup(job.input_hash, features, kFeatureCount, image_len,
+                                image_check, &cached, &saved_us)) {
+          if (tp) tp->parse_us = now_us() - ts;
+          backlog.release();
+          FusionResult res = FusionResult();
+          res.class_id = cached.class_id;
+          res.probability = cached.probability;
+          res.svm_score = cached.svm_score;
+          res.rknn_score = cached.rknn_score;
+          memcpy(res.svm_probs, cached.svm_probs, sizeof(res.svm_probs));
+          memcpy(res.rknn_probs, cached.rknn_probs, sizeof(res.rknn_probs));
+          res.feature_only = cached.feature_only;
+          res.backend = cached.backend;
+          res.cached = true;
+          finish_classify(reply, res, timing, job);
+          s_result_cache.record_hit_cost(saved_us, timing.total_us);
+          return true;
+      }
+  }
+
+  // 过载降级：不进入NPU队列，直接用特征模型应答
+  if (job.degraded) {
+      if (tp) tp->parse_us = now_us() - ts;
+      FusionResult res;
+      float confidence;
+      if (!feature_only_result(features, tp, &res, &confidence)) {
+          set_error(reply, 500, "{\"error\":\"Feature model failed\"}");
+          return true;
+      }
+      res.degraded = true;
+      printf("⚠️ 过载降级应答: 类别=%d, 置信度=%.4f\n", res.class_id, confidence);
+      finish_classify(reply, res, timing, job);
+      return true;
+  }
+  
+  // 图像数据直接引用请求体中的 image 字段，不复制
+  const char *image_data = json_str.data() + image_start;
+  if (!has_image || image_len == 0) {
+      printf("⚠️ JSON解析失败: 未找到image字段\n");
+      set_error(reply, 400, "{\"error\":\"Invalid JSON: missing image field\"}");
+      return true;
+  }
+
+  // 合并相同输入：已有相同请求在处理时挂到它上面，由它完成后通过 mg_wakeup 回复
+  // 需要请求工作线程异步回复，事件循环内处理时不合并
+  if (g_config.coalesce && s_request_pool) {
+      std::lock_guard<std::mutex> lock(s_inflight_mutex);
+      auto it = s_inflight.find(job.input_hash);
+      if (it == s_inflight.end()) {
+          std::shared_ptr<InflightCall> call(new InflightCall());
+          call->features.assign(features, features + kFeatureCount);
+          call->image_len = image_len;
+          s_inflight[job.input_hash] = call;
+          leader.key = job.input_hash;
+          leader.active = true;
+          s_stats.coalesce_leaders++;
+      } else if (it->second->image_len == image_len &&
+                 std::equal(features, features + kFeatureCount, it->second->features.begin())) {
+          it->second->waiters.push_back(job.shared_from_this());
+          s_stats.coalesced++;
+          printf("🔗 与处理中的相同请求合并 (请求 %llu)\n", (unsigned long long)job.request_id);
+          return false;
+      }
+  }
+  
+  // 级联模式：先运行特征模型，置信度达到该类别阈值时直接返回，不再解码图像
+  float svm_score = 0.0f;
+  float svm_probs[kResultClasses] = {0};
+  bool svm_ready = false;
+  if (g_config.cascade) {
+      if (tp) {
+          double now = now_us();
+          tp->parse_us += now - ts;
+          ts = now;
+      }
+      FusionResult res;
+      float confidence;
+      if (feature_only_result(features, tp, &res, &confidence)) {
+          int cls = res.class_id;
+          svm_score = res.svm_score;
+          memcpy(svm_probs, res.svm_probs, sizeof(svm_probs));
+          svm_ready = true;
+          s_stats.cascade_evaluated[cls]++;
+          printf("级联判断: 类别=%d, 置信度=%.4f, 阈值=%.4f\n",
+                 cls, confidence, g_config.cascade_thresholds[cls]);
+          if (confidence >= g_config.cascade_thresholds[cls]) {
+              s_stats.cascade_hits[cls]++;
+              backlog.release();
+              finish_classify(reply, res, timing, job);
+              cache_result(job, features, image_len, image_check, res, timing.total_us);
+              leader.res = res;
+              leader.has_res = true;
+              return true;
+          }
+      }
+      if (tp) ts = now_us();
+  }
+  
+  unsigned char *decoded_image;
+  size_t decoded_len;
+  if (stream) {
+      // 已在接收过程中解码
+      decoded_image = const_cast<unsigned char *>(stream->image());
+      decoded_len = stream->image_size();
+      if (tp) {
+          tp->parse_us += now_us() - ts;
+          tp->base64_us = stream->decode_us();
+      }
+  } else {
+  // 打印部分图像数据用于调试
+  printf("图像数据大小: %zu bytes\n", image_len);
+  printf("图像数据前100字节: ");
+  for (size_t i = 0; i < std::min(image_len, (size_t)100); i++) {
+      printf("%02x ", (unsigned char)image_data[i]);
+      if ((i + 1) % 16 == 0) printf("\n");
+  }
+  printf("\n");
+  
+  // Base64解码图像数据
+  printf("开始Base64解码图像数据\n");
+  if (tp) {
+      double now = now_us();
+      tp->parse_us += now - ts;
+      ts = now;
+  }
+  decoded_image =
+      RequestArena::current().alloc_array<unsigned char>(base64_decoded_capacity(image_len));
+  decoded_len = base64_decode_into(image_data, image_len, decoded_image);
+  if (tp) tp->base64_us = now_us() - ts;
+  printf("Base64解码完成，解码后数据大小: %zu bytes\n", decoded_len);
+  }
+  
+  if (decoded_len == 0) {
+      printf("⚠️ Base64解码失败\n");
+      set_error(reply, 400, "{\"error\":\"Failed to decode base64 image\"}");
+      return true;
+  }
+
+  // 按文件头检查图像尺寸，并为解码预留内存，避免超大图像或并发解码耗尽内存
+  ImageInfo info;
+  ImageHeaderStatus header;
+  if (stream) {
+      header = stream->header_status();
+      info = stream->image_info();
+  } else {
+      header = parse_image_header(decoded_image, decoded_len, &info);
+  }
+  DecodeReservation reservation;
+  if (header == kHeaderParsed) {
+      if (image_too_large(info)) {
+          s_decode_budget.note_rejected();
+          set_error(reply, 413, "{\"error\":\"Image too large\"}");
+          return true;
+      }
+      if (!reservation.acquire(s_decode_budget, s_decoder->decode_bytes(info))) {
+          printf("⚠️ 解码内存预算不足，放弃请求 %llu\n", (unsigned long long)job.request_id);
+          set_error(reply, 503, "{\"error\":\"Decode memory budget exhausted\"}");
+          return true;
+      }
+  } else {
+      s_decode_budget.note_unknown();
+  }
+  
+  // 特征模型（CPU）与图像模型（NPU）相互独立：fork 特征模型到CPU工作线程，
+  // 当前线程执行图像分类，两者都完成后再融合
+  if (tp) ts = now_us();
+  double svm_us = 0;
+  auto run_svm = [&]() {
+      double t0 = tp ? now_us() : 0;
+      svm_score = svm_model->predict(features, kFeatureCount, svm_probs);
+      if (tp) svm_us = now_us() - t0;
+  };
+  std::future<void> svm_done;
+  if (svm_ready) {
+      // 级联未命中时特征模型已算过
+  } else if (s_cpu_pool) {
+      svm_done = s_cpu_pool->submit(run_svm);
+  } else {
+      run_svm();
+  }
+
+  ClassificationResult rknn_res = classify_image(decoded_image, decoded_len, tp, &reservation);
+  backlog.release();
+  if (tp && s_overload.enabled() && rknn_res.backend == kBackendNpu) {
+      // 组批时按批内张数摊分，得到每张图像占用NPU的时间
+      s_overload.observe(tp->npu_us / std::max(1, tp->npu_batch),
+                         tp->dispatch_us + tp->queue_us);
+  }
+
+  if (svm_done.valid()) {
+      double tw = tp ? now_us() : 0;
+      svm_done.get();
+      if (tp) tp->join_wait_us = now_us() - tw;
+  }
+  if (tp) {
+      double now = now_us();
+      if (!svm_ready) tp->svm_us = svm_us;
+      tp->parallel_us = now - ts;
+      ts = now;
+  }
+  
+  // Combine results
+  FusionResult final_res = weighted_fusion(svm_score, rknn_res.probability);
+  memcpy(final_res.svm_probs, svm_probs, sizeof(final_res.svm_probs));
+  memcpy(final_res.rknn_probs, rknn_res.probs, sizeof(final_res.rknn_probs));
+  final_res.near_duplicate = rknn_res.near_duplicate;
+  final_res.backend = rknn_res.backend;
+  if (tp) tp->fusion_us = now_us() - ts;
+  
+  finish_classify(reply, final_res, timing, job);
+  // NPU失败时概率为0，不缓存，下次重新计算
+  if (rknn_res.probability > 0) {
+      cache_result(job, features, image_len, image_check, final_res, timing.total_us);
+  }
+  leader.res = final_res;
+  leader.has_res = true;
+  return true;
+}
+
+// 工作线程通过 mg_wakeup 把响应交回事件循环：[status][headers长度][headers][body]
+static std::string pack_reply(const ClassifyReply &reply) {
+  std::string out;
+  int32_t status = reply.status;
+  uint32_t hlen = (uint32_t)reply.headers.size();
+  out.append((const char *)&status, sizeof(status));
+  out.append((const char *)&hlen, sizeof(hlen));
+  out += reply.headers;
+  out += reply.body;
+  return out;
+}
+
+// 解析命令行参数。parse_args/init_models/init_cpu_workers 供服务器与部分工具共用，
+// 与 save_inference_result 一样不加 static，用不到它们的工具（microbench）不会报未使用
+bool parse_args(int argc, char *argv[], ServerConfig *cfg) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (strncmp(arg, "--timing=", 9) == 0) {
+      const char *v = arg + 9;
+      cfg->timing_header = !strcmp(v, "header") || !strcmp(v, "all");
+      cfg->timing_json = !strcmp(v, "json") || !strcmp(v, "all");
+      if (!cfg->timing_header && !cfg->timing_json && strcmp(v, "off")) {
+        fprintf(stderr, "无效的 --timing 取值: %s\n", v);
+        return false;
+      }
+    } else if (strncmp(arg, "--svm-native=", 13) == 0) {
+      cfg->svm_native = atoi(arg + 13) != 0;
+    } else if (strncmp(arg, "--svm-bench=", 12) == 0) {
+      cfg->svm_bench_threads = atoi(arg + 12);
+    } else if (strncmp(arg, "--cpu-workers=", 14) == 0) {
+      cfg->cpu_workers = atoi(arg + 14);
+    } else if (strncmp(arg, "--stage-metrics=", 16) == 0) {
+      cfg->stage_metrics = atoi(arg + 16) != 0;
+    } else if (strncmp(arg, "--request-workers=", 18) == 0) {
+      cfg->request_workers = atoi(arg + 18);
+    } else if (strncmp(arg, "--results-file=", 15) == 0) {
+      cfg->results_file = arg + 15;
+    } else if (strncmp(arg, "--results-flush-rows=", 21) == 0) {
+      cfg->results_flush_rows = atoi(arg + 21);
+    } else if (strncmp(arg, "--results-flush-ms=", 19) == 0) {
+      cfg->results_flush_ms = atoi(arg + 19);
+    } else if (strncmp(arg, "--results-fsync=", 16) == 0) {
+      cfg->results_fsync = atoi(arg + 16) != 0;
+    } else if (strncmp(arg, "--results-queue=", 16) == 0) {
+      cfg->results_queue = atoi(arg + 16);
+    } else if (strncmp(arg, "--results-rotate-mb=", 20) == 0) {
+      cfg->results_rotate_mb = atof(arg + 20);
+    } else if (strncmp(arg, "--results-rotate-s=", 19) == 0) {
+      cfg->results_rotate_s = atoi(arg + 19);
+    } else if (strncmp(arg, "--results-compress=", 19) == 0) {
+      cfg->results_compress = atoi(arg + 19) != 0;
+    } else if (strncmp(arg, "--results-retain-mb=", 20) == 0) {
+      cfg->results_retain_mb = atof(arg + 20);
+    } else if (strncmp(arg, "--store-dir=", 12) == 0) {
+      cfg->store_dir = arg + 12;
+    } else if (strncmp(arg, "--store-segment-mb=", 19) == 0) {
+      cfg->store_segment_mb = atof(arg + 19);
+    } else if (strncmp(arg, "--store-retain-mb=", 18) == 0) {
+      cfg->store_retain_mb = atof(arg + 18);
+    } else if (strncmp(arg, "--results-query-limit=", 22) == 0) {
+      cfg->results_query_limit = atoi(arg + 22);
+    } else if (strncmp(arg, "--cache-mb=", 11) == 0) {
+      cfg->cache_mb = atof(arg + 11);
+    } else if (strncmp(arg, "--cache-ttl-s=", 14) == 0) {
+      cfg->cache_ttl_s = atof(arg + 14);
+    } else if (strncmp(arg, "--coalesce=", 11) == 0) {
+      cfg->coalesce = atoi(arg + 11) != 0;
+    } else if (strncmp(arg, "--near-dup=", 11) == 0) {
+      cfg->near_dup = atoi(arg + 11) != 0;
+    } else if (strncmp(arg, "--near-dup-distance=", 20) == 0) {
+      cfg->near_dup_distance = atoi(arg + 20);
+    } else if (strncmp(arg, "--near-dup-entries=", 19) == 0) {
+      cfg->near_dup_entries = atoi(arg + 19);
+    } else if (strncmp(arg, "--near-dup-ttl-s=", 17) == 0) {
+      cfg->near_dup_ttl_s = atof(arg + 17);
+    } else if (strncmp(arg, "--npu-batch-window-us=", 22) == 0) {
+      cfg->npu_batch_window_us = atoi(arg + 22);
+    } else if (strncmp(arg, "--npu-bench=", 12) == 0) {
+      cfg->npu_bench_rounds = atoi(arg + 12);
+    } else if (strncmp(arg, "--backend=", 10) == 0) {
+      cfg->backend = arg + 10;
+      if (cfg->backend != "rknn" && cfg->backend != "onnx") {
+        fprintf(stderr, "无效的 --backend 取值: %s\n", arg + 10);
+        return false;
+      }
+    } else if (strncmp(arg, "--onnx-input=", 13) == 0) {
+      if (sscanf(arg + 13, "%dx%d", &cfg->onnx_width, &cfg->onnx_height) != 2 ||
+          cfg->onnx_width <= 0 || cfg->onnx_height <= 0) {
+        fprintf(stderr, "无效的 --onnx-input 取值: %s\n", arg + 13);
+        return false;
+      }
+    } else if (strncmp(arg, "--cpu-model=", 12) == 0) {
+      cfg->cpu_model = arg + 12;
+    } else if (strncmp(arg, "--cpu-slots=", 12) == 0) {
+      cfg->cpu_slots = atoi(arg + 12);
+    } else if (strncmp(arg, "--cpu-mean=", 11) == 0 || strncmp(arg, "--cpu-std=", 10) == 0) {
+      bool mean = arg[6] == 'm';
+      const char *value = strchr(arg, '=') + 1;
+      float *dst = mean ? cfg->cpu_mean : cfg->cpu_std;
+      if (sscanf(value, "%f,%f,%f", &dst[0], &dst[1], &dst[2]) != 3 ||
+          (!mean && (dst[0] == 0 || dst[1] == 0 || dst[2] == 0))) {
+        fprintf(stderr, "无效的 %s\n", arg);
+        return false;
+      }
+    } else if (strncmp(arg, "--cpu-swap-rb=", 14) == 0) {
+      cfg->cpu_swap_rb = atoi(arg + 14) != 0;
+    } else if (strncmp(arg, "--capture-dir=", 14) == 0) {
+      cfg->capture_dir = arg + 14;
+    } else if (strncmp(arg, "--capture-sample=", 17) == 0) {
+      cfg->capture_sample = atoi(arg + 17);
+    } else if (strncmp(arg, "--capture-max-mb=", 17) == 0) {
+      cfg->capture_max_mb = atof(arg + 17);
+    } else if (strncmp(arg, "--mat-pool-mb=", 14) == 0) {
+      cfg->mat_pool_mb = atof(arg + 14);
+    } else if (strncmp(arg, "--mat-pool-idle-s=", 18) == 0) {
+      cfg->mat_pool_idle_s = atof(arg + 18);
+    } else if (strncmp(arg, "--stream-body=", 14) == 0) {
+      cfg->stream_body = atoi(arg + 14) != 0;
+    } else if (strncmp(arg, "--stream-max-mb=", 16) == 0) {
+      cfg->stream_max_mb = atof(arg + 16);
+    } else if (strncmp(arg, "--stream-budget-mb=", 19) == 0) {
+      cfg->stream_budget_mb = atof(arg + 19);
+    } else if (strncmp(arg, "--decoder=", 10) == 0) {
+      cfg->decoder = arg + 10;
+      if (!find_image_decoder(cfg->decoder)) {
+        fprintf(stderr, "无效的 --decoder 取值: %s\n", arg + 10);
+        return false;
+      }
+    } else if (strncmp(arg, "--resizer=", 10) == 0) {
+      cfg->resizer = arg + 10;
+      if (!find_image_resizer(cfg->resizer)) {
+        fprintf(stderr, "无效的 --resizer 取值: %s\n", arg + 10);
+        return false;
+      }
+    } else if (strncmp(arg, "--max-image-pixels=", 19) == 0) {
+      cfg->max_image_pixels = strtoull(arg + 19, NULL, 10);
+    } else if (strncmp(arg, "--max-image-side=", 17) == 0) {
+      cfg->max_image_side = atoi(arg + 17);
+    } else if (strncmp(arg, "--decode-budget-mb=", 19) == 0) {
+      cfg->decode_budget_mb = atof(arg + 19);
+    } else if (strncmp(arg, "--decode-wait-ms=", 17) == 0) {
+      cfg->decode_wait_ms = atoi(arg + 17);
+    } else if (strncmp(arg, "--degrade=", 10) == 0) {
+      cfg->degrade = atoi(arg + 10) != 0;
+    } else if (strncmp(arg, "--degrade-slo-ms=", 17) == 0) {
+      cfg->degrade_slo_ms = atof(arg + 17);
+    } else if (strncmp(arg, "--degrade-exit-ms=", 18) == 0) {
+      cfg->degrade_exit_ms = atof(arg + 18);
+    } else if (strncmp(arg, "--degrade-hold-ms=", 18) == 0) {
+      cfg->degrade_hold_ms = atof(arg + 18);
+    } else if (strncmp(arg, "--cascade=", 10) == 0) {
+      cfg->cascade = atoi(arg + 10) != 0;
+    } else if (strncmp(arg, "--cascade-thresholds=", 21) == 0) {
+      // 只给一个值时对所有类别生效
+      float t[3];
+      int n = sscanf(arg + 21, "%f,%f,%f", &t[0], &t[1], &t[2]);
+      if (n != 1 && n != 3) {
+        fprintf(stderr, "无效的 --cascade-thresholds 取值: %s\n", arg + 21);
+        return false;
+      }
+      for (int k = 0; k < 3; k++) {
+        cfg->cascade_thresholds[k] = n == 1 ? t[0] : t[k];
+      }
+    } else {
+      fprintf(stderr, "未知参数: %s\n", arg);
+      return false;
+    }
+  }
+  if (cfg->backend == "onnx" && cfg->cpu_model.empty()) {
+    fprintf(stderr, "--backend=onnx 需要同时指定 --cpu-model\n");
+    return false;
+  }
+  return true;
+}
+
+// 加载特征模型并按配置设置结果缓存、近似重复缓存与图像缓冲池
+void init_models() {
+  // Initialize SVM model
+  svm_model = new SVMModel("nn_model.onnx");
+  s_rknn_model_version = (uint32_t)file_hash64(image_model_path().c_str());
+  s_svm_model_version = (uint32_t)file_hash64("nn_model.onnx");
+  s_result_cache.configure((size_t)(g_config.cache_mb * 1024 * 1024),
+                           (uint64_t)(g_config.cache_ttl_s * 1000));
+  s_result_cache.set_model_version(((uint64_t)s_rknn_model_version << 32) |
+                                   s_svm_model_version);
+  if (g_config.near_dup) {
+    s_near_dup.configure((size_t)std::max(0, g_config.near_dup_entries),
+                         g_config.near_dup_distance,
+                         (uint64_t)(g_config.near_dup_ttl_s * 1000));
+    s_near_dup.set_model_version(s_rknn_model_version);
+  }
+  s_mat_pool.configure((size_t)(std::max(0.0, g_config.mat_pool_mb) * 1024 * 1024),
+                       (uint64_t)(std::max(0.0, g_config.mat_pool_idle_s) * 1000));
+  s_decoder = find_image_decoder(g_config.decoder);
+  s_resizer = find_image_resizer(g_config.resizer);
+  printf("图像解码后端: %s, 缩放后端: %s\n", s_decoder->name(), s_resizer->name());
+  s_decode_budget.configure((size_t)(std::max(0.0, g_config.decode_budget_mb) * 1024 * 1024),
+                            std::max(0, g_config.decode_wait_ms));
+  s_stream_budget.configure((size_t)(std::max(0.0, g_config.stream_budget_mb) * 1024 * 1024), 0);
+}
+
+// CPU溢出推理与特征模型工作线程
+void init_cpu_workers() {
+  // 主后端本身就是ONNX时不再溢出
+  if (!g_config.cpu_model.empty() && g_config.cpu_slots > 0 && g_config.backend != "onnx") {
+    npu_init();  // CPU后端的输入尺寸与RKNN模型一致
+    CpuClassifier::Options cpu_opt;
+    cpu_opt.model_path = g_config.cpu_model;
+    cpu_opt.slots = g_config.cpu_slots;
+    cpu_opt.onnx = onnx_options(s_model_width, s_model_height);
+    std::string error;
+    CpuClassifier *cpu = new CpuClassifier();
+    if (cpu->load(cpu_opt, &error)) {
+      s_cpu_classifier = cpu;
+      s_overflow.configure(cpu->slots(), cpu->warmup_us());
+      printf("✅ CPU溢出推理已启用: %d 个实例, 单次约 %.1f ms\n",
+             cpu->slots(), cpu->warmup_us() / 1000);
+    } else {
+      printf("⚠️ CPU后端加载失败，只使用NPU: %s\n", error.c_str());
+      delete cpu;
+    }
+  }
+  if (g_config.cpu_workers > 0) {
+    s_cpu_pool = new WorkerPool(g_config.cpu_workers);
+  }
+}
+
+// 微基准等工具直接包含本文件时定义 ATK_NO_MAIN，复用其中的函数。
+// 以下只有服务器用到（HTTP处理、定时器、基准模式），工具中不编译，避免未使用警告
+#ifndef ATK_NO_MAIN
+// 退出过程中不再把请求交给请求工作线程，以便等它们处理完
+static bool s_stopping = false;
+
+#define HTTP_PORT "8080"
+static const char *s_listen_addr = "http://0.0.0.0:" HTTP_PORT;
+
+// 生成 /api/metrics 响应
+static std::string metrics_json() {
+  double uptime = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - s_stats.start).count();
+  JsonWriter w;
+  w.begin_object();
+  w.field("uptime_s", uptime);
+  w.field("rss_bytes", (uint64_t)process_rss_bytes());
+
+  w.begin_object("requests");
+  w.field("total", (uint64_t)s_stats.requests.load());
+  w.field("errors", (uint64_t)s_stats.errors.load());
+  w.latency("latency", s_stats.total);
+  w.end_object();
+
+  if (g_config.stage_metrics) {
+    w.begin_object("stages");
+    w.latency("dispatch", s_stats.dispatch);
+    w.latency("parse", s_stats.parse);
+    w.latency("base64", s_stats.base64);
+    w.latency("queue", s_stats.queue);
+    w.latency("decode", s_stats.decode);
+    w.latency("preprocess", s_stats.preprocess);
+    w.latency("npu", s_stats.npu);
+    w.latency("svm", s_stats.svm);
+    w.latency("join_wait", s_stats.join_wait);
+    w.latency("parallel", s_stats.parallel);
+    w.latency("fusion", s_stats.fusion);
+    w.end_object();
+  }
+
+  w.begin_object("cascade");
+  w.field("enabled", g_config.cascade);
+  uint64_t evaluated = 0, hits = 0;
+  for (int i = 0; i < 3; i++) {
+    char key[16];
+    uint64_t e = s_stats.cascade_evaluated[i].load();
+    uint64_t h = s_stats.cascade_hits[i].load();
+    evaluated += e;
+    hits += h;
+    snprintf(key, sizeof(key), "class_%d", i);
+    w.begin_object(key);
+    w.field("threshold", (double)g_config.cascade_thresholds[i]);
+    w.field("evaluated", e);
+    w.field("hits", h);
+    w.field("hit_rate", e ? (double)h / e : 0.0);
+    w.end_object();
+  }
+  w.field("evaluated", evaluated);
+  w.field("hits", hits);
+  w.field("hit_rate", evaluated ? (double)hits / evaluated : 0.0);
+  w.end_object();
+
+  char version[16];
+  w.begin_object("models");
+  snprintf(version, sizeof(version), "%08x", s_rknn_model_version);
+  w.field("rknn", version);
+  snprintf(version, sizeof(version), "%08x", s_svm_model_version);
+  w.field("svm", version);
+  w.end_object();
+  s_overload.write_metrics(w);
+  s_result_cache.write_metrics(w);
+  s_near_dup.write_metrics(w);
+  if (s_npu_batcher) {
+    s_npu_batcher->write_metrics(w);
+  }
+  s_overflow.write_metrics(w);
+  s_capture.write_metrics(w);
+  g_arena_stats.write_metrics(w);
+  s_mat_pool.write_metrics(w);
+  s_decode_budget.write_metrics(w);
+  s_stream_budget.write_metrics(w, "stream_budget");
+  w.begin_object("coalesce");
+  w.field("enabled", g_config.coalesce && s_request_pool != nullptr);
+  {
+    std::lock_guard<std::mutex> lock(s_inflight_mutex);
+    w.field("inflight", (uint64_t)s_inflight.size());
+  }
+  w.field("leaders", (uint64_t)s_stats.coalesce_leaders.load());
+  w.field("coalesced", (uint64_t)s_stats.coalesced.load());
+  w.end_object();
+  s_result_writer.write_metrics(w);
+
+  w.begin_object("cpu_pool");
+  w.field("workers", (uint64_t)(s_cpu_pool ? s_cpu_pool->size() : 0));
+  w.field("pending", (uint64_t)(s_cpu_pool ? s_cpu_pool->pending() : 0));
+  w.end_object();
+
+  w.begin_object("request_pool");
+  w.field("workers", (uint64_t)(s_request_pool ? s_request_pool->size() : 0));
+  w.field("pending", (uint64_t)(s_request_pool ? s_request_pool->pending() : 0));
+  w.end_object();
+
+  w.begin_object("svm");
+  w.field("backend", svm_model->using_native() ? "native" : "dnn");
+  w.field("model_bytes", (uint64_t)svm_model->model_size());
+  w.field("native_weight_bytes", (uint64_t)svm_model->native_weight_bytes());
+  w.field("dnn_instances", (uint64_t)svm_model->dnn_instance_count());
+  w.latency("predict", svm_model->predict_latency());
+  w.end_object();
+
+  w.end_object();
+  return w.str();
+}
+
+// /api/results 单次最多返回条数
+static const int kMaxResultsQueryLimit = 10000;
+
+struct ResultsQuery {
+    JsonWriter *w;
+    uint64_t matched;
+    uint64_t limit;
+};
+
+static void hex64(char *buf, size_t size, uint64_t v) {
+  snprintf(buf, size, "%016llx", (unsigned long long)v);
+}
+
+static bool emit_result_record(const ResultRecord &rec, void *arg) {
+  ResultsQuery *q = (ResultsQuery *)arg;
+  if (q->matched == q->limit) {
+      q->matched++;  // 多数一条，用于判断是否截断
+      return false;
+  }
+  q->matched++;
+  JsonWriter &w = *q->w;
+  char hex[24];
+  w.begin_object();
+  w.field("time", rec.time_us / 1e6);
+  w.field("request_id", (uint64_t)rec.request_id);
+  w.field("class", (uint64_t)rec.class_id);
+  w.field("probability", (double)rec.probability);
+  w.field("blood_score", (double)rec.svm_score);
+  w.field("rknn_score", (double)rec.rknn_score);
+  w.begin_array("svm_probs");
+  for (int i = 0; i < kResultClasses; i++) w.field(nullptr, (double)rec.svm_probs[i]);
+  w.end_array();
+  w.begin_array("rknn_probs");
+  for (int i = 0; i < kResultClasses; i++) w.field(nullptr, (double)rec.rknn_probs[i]);
+  w.end_array();
+  w.field("feature_only", (rec.flags & kResultFeatureOnly) != 0);
+  w.field("degraded", (rec.flags & kResultDegraded) != 0);
+  w.field("cached", (rec.flags & kResultCached) != 0);
+  w.field("coalesced", (rec.flags & kResultCoalesced) != 0);
+  w.field("near_duplicate", (rec.flags & kResultNearDuplicate) != 0);
+  w.field("cpu_backend", (rec.flags & kResultCpuBackend) != 0);
+  hex64(hex, sizeof(hex), rec.input_hash);
+  w.field("input_hash", hex);
+  snprintf(hex, sizeof(hex), "%08x", rec.rknn_model);
+  w.field("rknn_model", hex);
+  snprintf(hex, sizeof(hex), "%08x", rec.svm_model);
+  w.field("svm_model", hex);
+  w.begin_object("stages_us");
+  for (int i = 0; i < kStageCount; i++) {
+      w.field(kResultStageNames[i], (uint64_t)rec.stage_us[i]);
+  }
+  w.end_object();
+  w.end_object();
+  return true;
+}
+
+// 解析 from/to 参数为微秒（见 parse_unix_time_us），参数不存在或为空时保持 *out 不变
+static bool parse_query_time_us(struct mg_http_message *hm, const char *name, bool clamp,
+                                uint64_t *out) {
+  char buf[32];
+  int n = mg_http_get_var(&hm->query, name, buf, sizeof(buf));
+  if (n == -3) return false;  // 过长或URL编码错误
+  if (n <= 0) return true;
+  return parse_unix_time_us(buf, clamp, out);
+}
+
+// GET /api/results?from=&to=&class=&limit= 的参数，在事件循环中解析
+struct ResultsQueryArgs {
+    uint64_t from_us;
+    uint64_t to_us;
+    int class_id;
+    int limit;
+};
+
+// from/to 为Unix时间（秒），不合法时返回 false
+static bool parse_results_query(struct mg_http_message *hm, ResultsQueryArgs *args) {
+  char buf[32];
+  args->from_us = 0;
+  args->to_us = UINT64_MAX;
+  args->class_id = -1;
+  args->limit = g_config.results_query_limit;
+  if (!parse_query_time_us(hm, "from", false, &args->from_us) ||
+      !parse_query_time_us(hm, "to", true, &args->to_us)) {
+      return false;
+  }
+  if (mg_http_get_var(&hm->query, "class", buf, sizeof(buf)) > 0) {
+      args->class_id = atoi(buf);
+  }
+  if (mg_http_get_var(&hm->query, "limit", buf, sizeof(buf)) > 0) {
+      args->limit = atoi(buf);
+  }
+  args->limit = std::max(1, std::min(args->limit, kMaxResultsQueryLimit));
+  return true;
+}
+
+// 通过 mmap 扫描数据段，稀疏索引跳过时间不相交的块；可能读盘，在请求工作线程中执行
+static std::string results_json(const ResultsQueryArgs &args) {
+  JsonWriter w;
+  ResultsQuery q = {&w, 0, (uint64_t)args.limit};
+  double t0 = now_us();
+  w.begin_object();
+  w.begin_array("records");
+  uint64_t scanned = ResultStore::query(g_config.store_dir, args.from_us, args.to_us,
+                                        args.class_id, emit_result_record, &q);
+  w.end_array();
+  w.field("count", (uint64_t)std::min(q.matched, q.limit));
+  w.field("truncated", q.matched > q.limit);
+  w.field("scanned", (uint64_t)scanned);
+  w.field("query_ms", (now_us() - t0) / 1000.0);
+  w.end_object();
+  return w.str();
+}
+
+// 发送响应，成功时确保数据发送完成后关闭连接
+static void send_reply(struct mg_connection *c, const ClassifyReply &reply) {
+  mg_http_reply(c, reply.status, reply.headers.c_str(), "%s", reply.body.c_str());
+  // 流式接收的连接已脱离HTTP协议处理，无论成功与否都在发送后关闭
+  if (reply.status == 200 || c->pfn == NULL) {
+    c->is_resp = 1;  // 标记为响应已发送
+    c->is_draining = 1;  // 确保所有数据都被发送
+  }
+}
+
+static bool unpack_reply(struct mg_str data, ClassifyReply *reply) {
+  int32_t status;
+  uint32_t hlen;
+  if (data.len < sizeof(status) + sizeof(hlen)) return false;
+  memcpy(&status, data.buf, sizeof(status));
+  memcpy(&hlen, data.buf + sizeof(status), sizeof(hlen));
+  size_t off = sizeof(status) + sizeof(hlen);
+  if (data.len - off < hlen) return false;
+  reply->status = status;
+  reply->headers.assign(data.buf + off, hlen);
+  reply->body.assign(data.buf + off + hlen, data.len - off - hlen);
+  return true;
 }
 
 // 添加自定义方法比较函数
@@ -285,9 +1688,182 @@ static int method_cmp(struct mg_str method, const char *expected) {
   return method.len != n || strncasecmp(method.buf, expected, n) != 0;
 }
 
+// 事件循环收到完整请求体时创建分类任务
+static std::shared_ptr<ClassifyJob> new_classify_job(struct mg_connection *c,
+                                                     uint64_t request_id, bool capture) {
+  std::shared_ptr<ClassifyJob> job(new ClassifyJob());
+  job->conn_id = c->id;
+  clock_gettime(CLOCK_MONOTONIC, &job->start);
+  job->received_us = now_us();
+  job->degraded = s_overload.should_degrade();
+  job->admitted = !job->degraded;
+  job->request_id = request_id;
+  job->input_hash = 0;
+  job->capture = capture;
+  job->arrival_unix_us = job->capture ? (uint64_t)std::chrono::duration_cast<
+      std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count() : 0;
+  if (job->admitted) {
+    s_overload.admit();
+  }
+  return job;
+}
+
+// 交给请求工作线程或在事件循环内处理
+static void dispatch_classify(struct mg_connection *c, const std::shared_ptr<ClassifyJob> &job) {
+  if (s_request_pool && !job->degraded && !s_stopping) {
+    // 交给请求工作线程，完成后通过 mg_wakeup 回到事件循环发送
+    printf("📥 已加入处理队列\n");
+    s_request_pool->post([job]() {
+      ClassifyReply reply;
+      if (process_classify(*job, &reply)) {
+        capture_reply(*job, reply);
+        std::string packed = pack_reply(reply);
+        mg_wakeup(&mgr, job->conn_id, packed.data(), packed.size());
+      }
+    });
+  } else {
+    ClassifyReply reply;
+    process_classify(*job, &reply);
+    capture_reply(*job, reply);
+    send_reply(c, reply);
+  }
+}
+
+// 结果查询交给请求工作线程，避免扫描数据段时阻塞事件循环
+static void dispatch_results_query(struct mg_connection *c, const ResultsQueryArgs &args) {
+  ClassifyReply reply;
+  reply.status = 200;
+  reply.headers = "Content-Type: application/json\r\n";
+  if (s_request_pool && !s_stopping) {
+    unsigned long conn_id = c->id;
+    s_request_pool->post([conn_id, args, reply]() mutable {
+      reply.body = results_json(args);
+      std::string packed = pack_reply(reply);
+      mg_wakeup(&mgr, conn_id, packed.data(), packed.size());
+    });
+  } else {
+    reply.body = results_json(args);
+    send_reply(c, reply);
+  }
+}
+
+// 流式接收中的请求，保存在 c->fn_data
+struct StreamingClassify {
+    uint64_t request_id;
+    bool capture;
+    bool finished;  // 已分发或已回复错误，之后到达的数据丢弃
+    bool size_checked;  // 已按文件头检查过图像尺寸
+    std::unique_ptr<StreamingBody> body;  // 收齐后连同预算移交给 ClassifyJob
+    std::unique_ptr<DecodeReservation> reservation;
+
+    StreamingClassify(uint64_t id, bool cap, size_t content_length,
+                      std::unique_ptr<DecodeReservation> r)
+        : request_id(id), capture(cap), finished(false), size_checked(false),
+          body(new StreamingBody(content_length, cap)), reservation(std::move(r)) {}
+};
+
+// --stream-body：收到 /api/classify 的请求头后接管连接，请求体边到达边解码
+// 分块传输（没有 Content-Length）的请求仍走缓冲模式
+static void start_streaming(struct mg_connection *c, struct mg_http_message *hm) {
+  if (!g_config.stream_body || c->fn_data != NULL) return;
+  if (!mg_match(hm->uri, mg_str("/api/classify"), NULL) || method_cmp(hm->method, "POST")) return;
+  struct mg_str *cl = mg_http_get_header(hm, "Content-Length");
+  if (cl == NULL || mg_http_get_header(hm, "Transfer-Encoding") != NULL) return;
+  uint64_t content_length = 0;
+  if (!mg_str_to_num(*cl, 10, &content_length, sizeof(content_length))) return;
+
+  s_stats.requests++;
+  if (content_length > g_config.stream_max_mb * 1024 * 1024) {
+    printf("⚠️ 请求体过大: %llu bytes\n", (unsigned long long)content_length);
+    s_stats.errors++;
+    mg_http_reply(c, 413, "", "{\"error\":\"Request body too large\"}");
+    c->is_draining = 1;
+    mg_iobuf_del(&c->recv, 0, c->recv.len);
+    return;
+  }
+  printf("\n=== 流式接收请求 %s %.*s, Content-Length=%llu ===\n", c->rem.ip,
+         (int)hm->uri.len, hm->uri.buf, (unsigned long long)content_length);
+  uint64_t request_id = ++s_next_request_id;
+  bool capture = s_capture.sampled(request_id);
+  // 解码缓冲（被采集时还有请求体文本）按 Content-Length 一次分配，先从预算中扣除
+  size_t stream_bytes = base64_decoded_capacity((size_t)content_length) +
+                        (capture ? (size_t)content_length : 0);
+  std::unique_ptr<DecodeReservation> reservation(new DecodeReservation());
+  if (!reservation->acquire(s_stream_budget, stream_bytes)) {
+    printf("⚠️ 流式接收内存预算不足，放弃请求 %llu\n", (unsigned long long)request_id);
+    s_stats.errors++;
+    mg_http_reply(c, 503, "", "{\"error\":\"Stream memory budget exhausted\"}");
+    c->is_draining = 1;
+    mg_iobuf_del(&c->recv, 0, c->recv.len);
+    return;
+  }
+  c->fn_data = new StreamingClassify(request_id, capture, (size_t)content_length,
+                                     std::move(reservation));
+  // 去掉请求头后 mongoose 不再解析该连接，之后的数据以 MG_EV_READ 交给 fn。
+  // 请求头不一定从缓冲区开头算起：同一次读到的、排在前面的流水线请求已处理完，
+  // mongoose 本应在解析循环结束后删除它们，但接管后它直接返回，所以一并删除
+  size_t head_end = (size_t)(hm->head.buf - (char *)c->recv.buf) + hm->head.len;
+  mg_iobuf_del(&c->recv, 0, head_end);
+}
+
+// 把已收到的请求体交给流式解码，收齐后分发
+static void feed_streaming(struct mg_connection *c, StreamingClassify *sc) {
+  if (sc->finished) {
+    mg_iobuf_del(&c->recv, 0, c->recv.len);
+    return;
+  }
+  StreamingBody &body = *sc->body;
+  size_t n = std::min(c->recv.len, body.remaining());
+  bool ok = body.feed((const char *)c->recv.buf, n);
+  mg_iobuf_del(&c->recv, 0, c->recv.len);
+  if (!ok) {
+    printf("⚠️ 流式接收提前结束: %s\n", body.error());
+    sc->finished = true;
+    s_stats.errors++;
+    mg_http_reply(c, 400, "", "{\"error\":\"%s\"}", body.error());
+    c->is_draining = 1;
+    return;
+  }
+  // 读到文件头中的尺寸后立即检查，过大的图像不必等请求体收完
+  if (!sc->size_checked && body.header_status() == kHeaderParsed) {
+    sc->size_checked = true;
+    if (image_too_large(body.image_info())) {
+      sc->finished = true;
+      s_decode_budget.note_rejected();
+      s_stats.errors++;
+      mg_http_reply(c, 413, "", "{\"error\":\"Image too large\"}");
+      c->is_draining = 1;
+      return;
+    }
+  }
+  if (!body.complete()) return;
+
+  sc->finished = true;
+  printf("✅ 请求体接收完成，图像 %zu bytes (%s)，开始处理图像分类...\n",
+         body.image_size(), image_format_name(body.image_format()));
+  std::shared_ptr<ClassifyJob> job = new_classify_job(c, sc->request_id, sc->capture);
+  job->body = body.take_text();
+  job->stream = std::move(sc->body);
+  job->stream_reservation = std::move(sc->reservation);
+  dispatch_classify(c, job);
+}
+
 // HTTP事件处理
 static void fn(struct mg_connection *c, int ev, void *ev_data) {
-  if (ev == MG_EV_HTTP_MSG) {
+  if (ev == MG_EV_HTTP_HDRS) {
+    start_streaming(c, (struct mg_http_message *)ev_data);
+  } else if ((ev == MG_EV_READ || ev == MG_EV_POLL) && c->fn_data != NULL) {
+    if (c->recv.len > 0) feed_streaming(c, (StreamingClassify *)c->fn_data);
+  } else if (ev == MG_EV_CLOSE && c->fn_data != NULL) {
+    delete (StreamingClassify *)c->fn_data;
+    c->fn_data = NULL;
+  } else if (ev == MG_EV_WAKEUP) {
+    // 请求工作线程处理完成（分类或结果查询）
+    ClassifyReply reply;
+    if (unpack_reply(*(struct mg_str *)ev_data, &reply)) {
+      send_reply(c, reply);
+    }
+  } else if (ev == MG_EV_HTTP_MSG) {
     struct mg_http_message *hm = (struct mg_http_message *)ev_data;
     
     // 添加详细的请求日志
@@ -309,148 +1885,36 @@ static void fn(struct mg_connection *c, int ev, void *ev_data) {
     printf("请求体大小: %zu bytes\n", hm->body.len);
     
     struct mg_str uri_pattern = mg_str("/api/classify");
-    if (mg_match(hm->uri, uri_pattern, NULL)) {
+    if (mg_match(hm->uri, mg_str("/api/metrics"), NULL)) {
+      mg_http_reply(c, 200, "Content-Type: application/json\r\n", "%s",
+                    metrics_json().c_str());
+    } else if (mg_match(hm->uri, mg_str("/api/results"), NULL)) {
+      if (g_config.store_dir.empty()) {
+        mg_http_reply(c, 404, "", "{\"error\":\"Result store disabled\"}");
+      } else {
+        ResultsQueryArgs args;
+        if (parse_results_query(hm, &args)) {
+          dispatch_results_query(c, args);
+        } else {
+          mg_http_reply(c, 400, "", "{\"error\":\"Invalid from/to\"}");
+        }
+      }
+    } else if (mg_match(hm->uri, uri_pattern, NULL)) {
+      s_stats.requests++;
       if (method_cmp(hm->method, "POST")) {
         printf("⚠️ 方法不匹配 | 实际方法: %.*s\n", 
                (int)hm->method.len, hm->method.buf);
+        s_stats.errors++;
         mg_http_reply(c, 405, "", "{\"error\":\"Method not allowed\"}");
         return;
       }
       
       printf("✅ 开始处理图像分类...\n");
-      struct timespec start, end;
-      clock_gettime(CLOCK_MONOTONIC, &start);
-      
-      // Simple JSON parser
-      std::string json_str(hm->body.buf, hm->body.len);
-      
-      // Extract image data
-      std::string image_data;
-      size_t image_pos = json_str.find("\"image\":");
-      if (image_pos != std::string::npos) {
-          size_t start = json_str.find("\"", image_pos + 8);
-          if (start != std::string::npos) {
-              size_t end = json_str.find("\"", start + 1);
-              if (end != std::string::npos) {
-                  image_data = json_str.substr(start + 1, end - start - 1);
-              }
-          }
-      }
-      
-      if (image_data.empty()) {
-          printf("⚠️ JSON解析失败: 未找到image字段\n");
-          mg_http_reply(c, 400, "", "{\"error\":\"Invalid JSON: missing image field\"}");
-          return;
-      }
-      
-      // 打印部分图像数据用于调试
-      printf("图像数据大小: %zu bytes\n", image_data.size());
-      printf("图像数据前100字节: ");
-      for (size_t i = 0; i < std::min(image_data.size(), (size_t)100); i++) {
-          printf("%02x ", (unsigned char)image_data[i]);
-          if ((i + 1) % 16 == 0) printf("\n");
-      }
-      printf("\n");
-      
-      // Base64解码图像数据
-      printf("开始Base64解码图像数据\n");
-      std::vector<unsigned char> decoded_image = base64_decode(image_data);
-      printf("Base64解码完成，解码后数据大小: %zu bytes\n", decoded_image.size());
-      
-      if (decoded_image.empty()) {
-          printf("⚠️ Base64解码失败\n");
-          mg_http_reply(c, 400, "", "{\"error\":\"Failed to decode base64 image\"}");
-          return;
-      }
-      
-      ClassificationResult rknn_res = classify_image(
-          decoded_image.data(), decoded_image.size());
-      
-      // Extract features with error handling
-      std::vector<float> features;
-      size_t features_pos = json_str.find("\"features\":[");
-      if (features_pos != std::string::npos) {
-          size_t start = features_pos + 11;
-          size_t end = json_str.find("]", start);
-          if (end != std::string::npos) {
-              std::string features_str = json_str.substr(start, end - start);
-              
-              // 去除所有空格和方括号
-              features_str.erase(std::remove(features_str.begin(), features_str.end(), ' '), features_str.end());
-              features_str.erase(std::remove(features_str.begin(), features_str.end(), '['), features_str.end());
-              features_str.erase(std::remove(features_str.begin(), features_str.end(), ']'), features_str.end());
-              
-              // 验证字符串是否只包含数字和逗号
-              if (features_str.find_first_not_of("0123456789,.-") != std::string::npos) {
-                  printf("⚠️ 特征格式错误: 包含非法字符\n");
-                  printf("原始特征字符串: %s\n", features_str.c_str());
-                  mg_http_reply(c, 400, "", "{\"error\":\"Invalid features format: contains invalid characters\"}");
-                  return;
-              }
-              
-              size_t pos = 0;
-              try {
-                  while ((pos = features_str.find(',')) != std::string::npos) {
-                      std::string num_str = features_str.substr(0, pos);
-                      if (!num_str.empty()) {
-                          features.push_back(std::stof(num_str));
-                      }
-                      features_str.erase(0, pos + 1);
-                  }
-                  if (!features_str.empty()) {
-                      features.push_back(std::stof(features_str));
-                  }
-              } catch (const std::invalid_argument& e) {
-                  printf("⚠️ 特征解析失败: %s\n", e.what());
-                  printf("原始特征字符串: %s\n", features_str.c_str());
-                  mg_http_reply(c, 400, "", "{\"error\":\"Invalid features format: failed to parse numbers\"}");
-                  return;
-              }
-          }
-      }
-      
-      // 检查特征数量
-      if (features.size() != 34) {
-          printf("⚠️ 特征数量错误: 期望34个，实际收到%zu个\n", features.size());
-          mg_http_reply(c, 400, "", "{\"error\":\"Invalid features: expected 34 features\"}");
-          return;
-      }
-      
-      float svm_score = svm_model->predict(features);
-      
-      // Combine results
-      FusionResult final_res = weighted_fusion(svm_score, rknn_res.probability);
-      
-      clock_gettime(CLOCK_MONOTONIC, &end);
-      double elapsed = (end.tv_sec - start.tv_sec) +
-                      (end.tv_nsec - start.tv_nsec) / 1e9;
-      printf("🕒 处理耗时: %.3f 秒\n", elapsed);
-      
-      printf("📤 发送响应...\n");
-
-      // Generate JSON response
-      char json_response[512];
-      snprintf(json_response, sizeof(json_response),
-          "{\"class\":%d,\"probability\":%.4f,\"blood_score\":%.4f,\"rknn_score\":%.4f}",
-          final_res.class_id,
-          final_res.probability,
-          final_res.svm_score,
-          final_res.rknn_score);
-
-      printf("融合结果: 类别=%d, 概率=%.4f, 血常规分数=%.4f, RKNN分数=%.4f\n",
-             final_res.class_id, final_res.probability,
-             final_res.svm_score, final_res.rknn_score);
-
-      // Send response
-      mg_http_reply(c, 200, "Content-Type: application/json\r\n", "%s",
-                   json_response);
-
-      // 确保数据发送完成
-      c->is_resp = 1;  // 标记为响应已发送
-      c->is_draining = 1;  // 确保所有数据都被发送
-
-      // 保存推理结果
-      save_inference_result(final_res, elapsed);
+      uint64_t request_id = ++s_next_request_id;
+      std::shared_ptr<ClassifyJob> job =
+          new_classify_job(c, request_id, s_capture.sampled(request_id));
+      job->body.assign(hm->body.buf, hm->body.len);
+      dispatch_classify(c, job);
     } else {
       printf("⚠️ 拒绝请求：路径未找到\n");
       mg_http_reply(c, 404, "", "{\"error\":\"Not Found\"}");
@@ -459,73 +1923,271 @@ static void fn(struct mg_connection *c, int ev, void *ev_data) {
   }
 }
 
+// --svm-bench=N：以 1,2,4..N 个线程并发调用特征模型，输出吞吐与内存随线程数的变化
+static void run_svm_bench(SVMModel *model, int max_threads) {
+  printf("特征模型并发测试 (后端: %s)\n", model->using_native() ? "native" : "dnn");
+  printf("%8s %16s %14s %12s\n", "线程数", "吞吐(次/秒)", "常驻内存(KB)", "dnn实例数");
+  for (int threads = 1; threads <= max_threads;
+       threads = (threads * 2 > max_threads && threads < max_threads) ? max_threads : threads * 2) {
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> calls(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+      workers.push_back(std::thread([&]() {
+        float logits[3], probs[3];
+        uint64_t n = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+          model->predict_class(kProbeFeatures, 34, logits, probs);
+          n++;
+        }
+        calls += n;
+      }));
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    stop = true;
+    for (size_t t = 0; t < workers.size(); t++) {
+      workers[t].join();
+    }
+    printf("%8d %16.0f %14zu %12u\n", threads, (double)calls.load(),
+           process_rss_bytes() / 1024, model->dnn_instance_count());
+  }
+}
+
+// --npu-bench=N：批内有效输入数取 1..模型批大小，各推理 N 次，
+// 输出批次耗时与每张耗时，用于选择 --npu-batch-window-us
+static void run_npu_bench(int rounds) {
+  npu_init();
+  size_t input_bytes = (size_t)s_model_width * s_model_height * 3;
+  std::vector<uint8_t> input(input_bytes * s_model_batch, 0);
+  std::vector<NpuBatchOutput> outputs(s_model_batch);
+  printf("NPU批处理测试 (模型批大小: %d, 每组 %d 次)\n", s_model_batch, rounds);
+  printf("%10s %16s %16s %16s\n", "有效输入数", "批次耗时(ms)", "每张耗时(ms)", "吞吐(张/秒)");
+  for (int fill = 1; fill <= s_model_batch; fill++) {
+    double start = now_us();
+    for (int i = 0; i < rounds; i++) {
+      if (!npu_run_batch(input.data(), fill, outputs.data())) {
+        fprintf(stderr, "NPU批处理测试失败\n");
+        return;
+      }
+    }
+    double batch_us = (now_us() - start) / rounds;
+    printf("%10d %16.2f %16.2f %16.1f\n", fill, batch_us / 1000,
+           batch_us / fill / 1000, fill * 1e6 / batch_us);
+  }
+}
+
+// 解析命令行参数，格式为 --key=value
+static void print_usage(const char *prog) {
+  printf("用法: %s [选项]\n", prog);
+  printf("  --timing=off|header|json|all  附加各阶段耗时 (默认 off)\n");
+  printf("  --svm-native=0|1              特征模型使用原生求值器 (默认 1)\n");
+  printf("  --svm-bench=N                 测试特征模型 1..N 线程并发吞吐后退出\n");
+  printf("  --cpu-workers=N               特征模型工作线程数，0为与NPU顺序执行 (默认 1)\n");
+  printf("  --stage-metrics=0|1           在 /api/metrics 中统计各阶段耗时 (默认 0)\n");
+  printf("  --request-workers=N           分类请求工作线程数，0为在事件循环中处理 (默认 2)\n");
+  printf("  --cascade=0|1                 特征模型置信度足够时跳过图像模型 (默认 0)\n");
+  printf("  --cascade-thresholds=a[,b,c]  各类别的级联置信度阈值 (默认 0.95)\n");
+  printf("  --results-file=PATH           推理结果CSV文件 (默认 inference_results.csv)\n");
+  printf("  --results-flush-rows=N        每累计N行写出一次 (默认 64)\n");
+  printf("  --results-flush-ms=N          每N毫秒写出一次，0为关闭 (默认 1000)\n");
+  printf("  --results-fsync=0|1           写出后 fdatasync (默认 0)\n");
+  printf("  --results-queue=N             结果队列容量 (默认 4096)\n");
+  printf("  --results-rotate-mb=N         结果文件超过N MB时轮转，0为关闭 (默认 0)\n");
+  printf("  --results-rotate-s=N          每N秒轮转一次(按本地时间对齐)，0为关闭 (默认 0)\n");
+  printf("  --results-compress=0|1        gzip压缩轮转出的分段 (默认 1)\n");
+  printf("  --results-retain-mb=N         分段合计上限(MB)，超出删除最旧的，0为不限 (默认 64)\n");
+  printf("  --store-dir=DIR                二进制结果存储目录，空为关闭 (默认 results)\n");
+  printf("  --store-segment-mb=N          数据段大小(MB) (默认 8)\n");
+  printf("  --store-retain-mb=N           数据段合计上限(MB)，0为不限 (默认 128)\n");
+  printf("  --results-query-limit=N       /api/results 默认最多返回条数 (默认 1000)\n");
+  printf("  --cache-mb=N                  结果缓存内存上限(MB)，0为关闭 (默认 2)\n");
+  printf("  --cache-ttl-s=N               缓存条目有效期(秒)，0为不过期 (默认 600)\n");
+  printf("  --coalesce=0|1                相同输入的并发请求共用一次计算 (默认 1)\n");
+  printf("  --near-dup=0|1                近似重复图像复用RKNN结果 (默认 0)\n");
+  printf("  --near-dup-distance=N         感知哈希最大汉明距离 0-15 (默认 4)\n");
+  printf("  --near-dup-entries=N          近似重复缓存条目数 (默认 4096)\n");
+  printf("  --near-dup-ttl-s=N            条目有效期(秒)，0为不过期 (默认 600)\n");
+  printf("  --npu-batch-window-us=N       批大小>1的模型组批最长等待微秒 (默认 2000)\n");
+  printf("  --npu-bench=N                 测试NPU各批内输入数的耗时与吞吐后退出\n");
+  printf("  --backend=rknn|onnx           图像模型主后端，onnx 使用 --cpu-model 在CPU上推理 (默认 rknn)\n");
+  printf("  --onnx-input=WxH              onnx 主后端的模型输入尺寸 (默认 224x224)\n");
+  printf("  --cpu-model=PATH              图像模型ONNX导出，NPU排队过长时溢出到CPU推理 (默认关闭)\n");
+  printf("  --cpu-slots=N                 CPU后端最多同时推理的请求数 (默认 1)\n");
+  printf("  --cpu-mean=a,b,c              CPU后端输入减去的均值 (默认 0,0,0)\n");
+  printf("  --cpu-std=a,b,c               CPU后端输入除以的标准差 (默认 1,1,1)\n");
+  printf("  --cpu-swap-rb=0|1             CPU模型输入为RGB (默认 0)\n");
+  printf("  --capture-dir=DIR             采集 /api/classify 请求到流量存档，供 replay 重放\n");
+  printf("  --capture-sample=N            每N个请求采集1个 (默认 1)\n");
+  printf("  --capture-max-mb=N            单个存档大小上限(MB)，0为不限 (默认 1024)\n");
+  printf("  --mat-pool-mb=N               图像解码缓冲池保留的空闲内存(MB)，0为关闭 (默认 64)\n");
+  printf("  --mat-pool-idle-s=N           空闲N秒后释放缓冲池内存，0为不释放 (默认 30)\n");
+  printf("  --stream-body=0|1             边接收边解码请求体中的图像 (默认 0)\n");
+  printf("  --stream-max-mb=N             流式接收的请求体大小上限(MB) (默认 32)\n");
+  printf("  --stream-budget-mb=N          流式接收缓冲之和上限(MB)，超过返回503，0为关闭 (默认 96)\n");
+  printf("  --decoder=opencv|stb          图像解码后端 (默认 opencv)\n");
+  printf("  --resizer=opencv|stb          缩放后端 (默认 opencv)\n");
+  printf("  --max-image-pixels=N          图像像素数上限，超过返回413，0为不限制 (默认 16000000)\n");
+  printf("  --max-image-side=N            图像宽或高上限，超过返回413，0为不限制 (默认 8192)\n");
+  printf("  --decode-budget-mb=N          并发解码的内存预算(MB)，0为关闭 (默认 192)\n");
+  printf("  --decode-wait-ms=N            预算不足时最多等待的毫秒数，超时返回503 (默认 2000)\n");
+  printf("  --degrade=0|1                 NPU过载时只用特征模型应答 (默认 0)\n");
+  printf("  --degrade-slo-ms=N            预计NPU排队超过该值时进入降级 (默认 200)\n");
+  printf("  --degrade-exit-ms=N           预计NPU排队低于该值时退出降级 (默认 SLO/2)\n");
+  printf("  --degrade-hold-ms=N           降级最短持续时间 (默认 1000)\n");
+}
+
+static void signal_handler(int signo) {
+  s_signo = signo;
+}
+
+// 定时要求结果写入线程刷新
+static void results_flush_timer(void *arg) {
+  (void)arg;
+  s_result_writer.request_flush();
+}
+
+// 流量停止后按积压退出过载降级
+static void overload_timer(void *arg) {
+  (void)arg;
+  s_overload.tick();
+}
+
+// 空闲时释放图像缓冲池
+static void mat_pool_timer(void *arg) {
+  (void)arg;
+  size_t freed = s_mat_pool.trim_if_idle();
+  if (freed > 0) {
+    printf("🧹 图像缓冲池空闲，释放 %.1f MB\n", freed / 1048576.0);
+  }
+}
+
 int main(int argc, char *argv[]) {
-  // Initialize SVM model
-  svm_model = new SVMModel("nn_model.onnx");
+  if (!parse_args(argc, argv, &g_config)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  init_models();
+  if (g_config.svm_bench_threads > 0) {
+    run_svm_bench(svm_model, g_config.svm_bench_threads);
+    return 0;
+  }
+  if (g_config.npu_bench_rounds > 0) {
+    run_npu_bench(g_config.npu_bench_rounds);
+    return 0;
+  }
+  init_cpu_workers();
+  if (g_config.request_workers > 0) {
+    s_request_pool = new WorkerPool(g_config.request_workers);
+  }
+  double exit_ms = g_config.degrade_exit_ms >= 0 ? g_config.degrade_exit_ms
+                                                 : g_config.degrade_slo_ms / 2;
+  s_overload.configure(g_config.degrade, g_config.degrade_slo_ms, exit_ms,
+                       g_config.degrade_hold_ms);
   
+  ResultWriter::Options writer_opt;
+  writer_opt.path = g_config.results_file;
+  writer_opt.flush_rows = g_config.results_flush_rows;
+  writer_opt.fsync = g_config.results_fsync;
+  writer_opt.queue_capacity = g_config.results_queue;
+  writer_opt.rotate_bytes = (uint64_t)(g_config.results_rotate_mb * 1024 * 1024);
+  writer_opt.rotate_period_s = g_config.results_rotate_s;
+  writer_opt.compress = g_config.results_compress;
+  writer_opt.retain_bytes = (uint64_t)(g_config.results_retain_mb * 1024 * 1024);
+  writer_opt.store_dir = g_config.store_dir;
+  writer_opt.store_segment_bytes = (uint64_t)(g_config.store_segment_mb * 1024 * 1024);
+  writer_opt.store_retain_bytes = (uint64_t)(g_config.store_retain_mb * 1024 * 1024);
+  s_result_writer.start(writer_opt);
+
+  if (!g_config.capture_dir.empty()) {
+    TrafficCapture::Options capture_opt;
+    capture_opt.dir = g_config.capture_dir;
+    capture_opt.sample = g_config.capture_sample;
+    capture_opt.max_bytes = (uint64_t)(g_config.capture_max_mb * 1024 * 1024);
+    capture_opt.queue_bytes = 64 << 20;
+    s_capture.start(capture_opt);
+  }
+
+  signal(SIGINT, signal_handler);
+  signal(SIGTERM, signal_handler);
+
   mg_mgr_init(&mgr);
-  mg_http_listen(&mgr, s_listen_addr, fn, NULL);
+  mg_wakeup_init(&mgr);  // 工作线程通过 mg_wakeup 回传响应
+  if (g_config.results_flush_ms > 0) {
+    mg_timer_add(&mgr, g_config.results_flush_ms, MG_TIMER_REPEAT,
+                 results_flush_timer, NULL);
+  }
+  if (s_overload.enabled()) {
+    mg_timer_add(&mgr, 1000, MG_TIMER_REPEAT, overload_timer, NULL);
+  }
+  if (s_mat_pool.enabled()) {
+    mg_timer_add(&mgr, 1000, MG_TIMER_REPEAT, mat_pool_timer, NULL);
+  }
+  struct mg_connection *listener = mg_http_listen(&mgr, s_listen_addr, fn, NULL);
   printf("🚀 服务器已启动，监听地址: %s\n", s_listen_addr);
   printf("📡 等待客户端连接...\n");
   
   // 主事件循环
-  for (;;) {
+  while (s_signo == 0) {
     mg_mgr_poll(&mgr, 50); // 50ms timeout
   }
   
+  printf("收到信号 %d，正在退出...\n", (int)s_signo);
+  // 不再接受新连接；已在处理的请求继续完成，响应仍经事件循环发出，结果写完后再停止写入线程
+  if (listener) listener->is_closing = 1;
+  s_stopping = true;
+  if (s_request_pool) {
+    while (!s_request_pool->idle()) {
+      mg_mgr_poll(&mgr, 50);
+    }
+    delete s_request_pool;
+    s_request_pool = nullptr;
+  }
+  delete s_cpu_pool;
+  s_cpu_pool = nullptr;
+  mg_mgr_poll(&mgr, 0);  // 发出最后一批 mg_wakeup 传回的响应
+  s_result_writer.stop();
+  s_capture.stop();
   mg_mgr_free(&mgr);
   return 0;
 }
-
-static unsigned char *load_model(const char *filename, int *model_size) {
-  FILE *fp = fopen(filename, "rb");
-  if (fp == NULL) {
-    printf("fopen %s fail!\n", filename);
-    return NULL;
-  }
-
-  fseek(fp, 0, SEEK_END);
-  unsigned int model_len = ftell(fp);
-  unsigned char *model = (unsigned char *)malloc(model_len);
-  fseek(fp, 0, SEEK_SET);
-
-  if (model_len != fread(model, 1, model_len, fp)) {
-    printf("fread %s fail!\n", filename);
-    free(model);
-    return NULL;
-  }
-  *model_size = model_len;
-
-  if (fp) {
-    fclose(fp);
-  }
-  return model;
-}
+#endif  // ATK_NO_MAIN
 
 // 修改结果处理函数
-// 保存推理结果到CSV文件
-void save_inference_result(const FusionResult& result, double processing_time) {
-    static std::mutex file_mutex;
-    std::lock_guard<std::mutex> lock(file_mutex);
-    
-    // 获取当前时间
-    auto now = std::chrono::system_clock::now();
-    auto now_time_t = std::chrono::system_clock::to_time_t(now);
-    
-    // 打开文件追加写入
-    std::ofstream outfile("inference_results.csv", std::ios::app);
-    if (!outfile.is_open()) {
-        printf("⚠️ 无法打开结果文件\n");
-        return;
+// 保存推理结果（CSV与二进制结果存储）：只入队，由后台写入线程批量写出
+void save_inference_result(const FusionResult& result, const RequestTiming& timing,
+                           uint64_t request_id, uint64_t input_hash) {
+    ResultRow row;
+    ResultRecord &rec = row.record;
+    memset(&rec, 0, sizeof(rec));
+    rec.time_us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    rec.request_id = request_id;
+    rec.input_hash = input_hash;
+    rec.rknn_model = s_rknn_model_version;
+    rec.svm_model = s_svm_model_version;
+    rec.class_id = result.class_id;
+    rec.flags = (result.feature_only ? kResultFeatureOnly : 0) |
+                (result.degraded ? kResultDegraded : 0) |
+                (result.cached ? kResultCached : 0) |
+                (result.coalesced ? kResultCoalesced : 0) |
+                (result.near_duplicate ? kResultNearDuplicate : 0) |
+                (result.backend == kBackendCpu ? kResultCpuBackend : 0);
+    rec.probability = result.probability;
+    rec.svm_score = result.svm_score;
+    rec.rknn_score = result.rknn_score;
+    memcpy(rec.svm_probs, result.svm_probs, sizeof(rec.svm_probs));
+    memcpy(rec.rknn_probs, result.rknn_probs, sizeof(rec.rknn_probs));
+    const double stages[kStageCount] = {
+        timing.dispatch_us, timing.parse_us, timing.base64_us, timing.queue_us,
+        timing.decode_us, timing.preprocess_us, timing.npu_us, timing.svm_us,
+        timing.join_wait_us, timing.parallel_us, timing.fusion_us, timing.total_us
+    };
+    for (int i = 0; i < kStageCount; i++) {
+        rec.stage_us[i] = stages[i] > 0 ? (uint32_t)stages[i] : 0;
     }
-    
-    // 写入CSV格式数据
-    outfile << std::put_time(std::localtime(&now_time_t), "%Y-%m-%d %H:%M:%S") << ","
-            << result.class_id << ","
-            << result.probability << ","
-            << result.svm_score << ","
-            << result.rknn_score << ","
-            << processing_time << "\n";
+    row.processing_time = timing.total_us / 1e6;
+    s_result_writer.enqueue(row);
 }
 
 static int rknn_GetResult(float *prob_data, struct ClassificationResult *result) {
@@ -545,6 +2207,7 @@ static int rknn_GetResult(float *prob_data, struct ClassificationResult *result)
     
     result->class_id = max_index;  // 0: 健康, 1: 细菌感染, 2: 支原体感染
     result->probability = max_prob;
+    memcpy(result->probs, prob_data, sizeof(result->probs));
     
     return 0;
 }
\ No newline at end of file
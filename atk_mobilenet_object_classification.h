@@ -21,6 +21,9 @@
 #include <fstream>
 #include <iomanip>
 #include <chrono>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
 
 // RKNN相关
 #include "rknn_api.h"
@@ -31,14 +34,76 @@
 // HTTP服务器相关
 #include "mongoose.h"
 
+// 特征模型原生求值器
+#include "native_mlp.h"
+
+// 运行统计
+#include "metrics.h"
+
+// CPU工作线程池
+#include "worker_pool.h"
+
+// 过载降级策略
+#include "overload_guard.h"
+
+// 推理结果后台写入
+#include "result_writer.h"
+
+// 输入内容哈希与模型版本
+#include "content_hash.h"
+
+// 重复输入的结果缓存
+#include "result_cache.h"
+
+// 近似重复图像（感知哈希）缓存
+#include "near_dup_cache.h"
+
+// NPU动态微批处理
+#include "npu_batcher.h"
+
+// 图像模型推理后端（RKNN / ONNX）
+#include "rknn_backend.h"
+#include "onnx_backend.h"
+
+// NPU排队过长时溢出到CPU推理
+#include "cpu_classifier.h"
+#include "overflow_scheduler.h"
+#include "traffic_capture.h"
+
+// 请求内临时内存
+#include "request_arena.h"
+
+// 图像解码缓冲池
+#include "mat_pool.h"
+
+// Base64解码与流式请求体
+#include "base64.h"
+#include "image_header.h"
+#include "stream_body.h"
+
+// 解码前的尺寸检查与解码内存预算
+#include "decode_budget.h"
+
+// 图像解码/缩放后端
+#include "image_codec.h"
+
 
 // 函数声明
-static unsigned char *load_model(const char *filename, int *model_size);
 static int rknn_GetResult(float *prob_data, struct ClassificationResult *result);
 
+// 图像模型推理所用后端
+enum InferBackend {
+    kBackendNone = 0,  // 未运行图像模型（级联、降级、近似重复或推理失败）
+    kBackendNpu,
+    kBackendCpu        // NPU排队过长时溢出到CPU
+};
+
 struct ClassificationResult {
     int class_id;
     float probability;
+    bool near_duplicate;  // 复用近似重复图像的结果，未运行NPU
+    int backend;          // InferBackend
+    float probs[kResultClasses];  // softmax后的各类别概率，失败时为0
 };
 
 // 分类结果结构体
@@ -47,10 +112,98 @@ struct FusionResult {
     float probability;
     float svm_score;
     float rknn_score;
+    bool feature_only;  // 仅由特征模型给出，未运行图像模型
+    bool degraded;      // 过载降级时给出
+    bool cached;        // 来自结果缓存
+    bool coalesced;     // 与同时处理中的相同请求共用结果
+    bool near_duplicate;  // 图像模型得分来自近似重复图像
+    int backend;          // 图像模型后端（InferBackend）
+    float svm_probs[kResultClasses];   // 特征模型各类别概率，未运行时为0
+    float rknn_probs[kResultClasses];  // 图像模型各类别概率，未运行时为0
 };
 
+// 单个请求各阶段耗时（微秒），用于 Server-Timing 响应头 / timing 字段
+struct RequestTiming {
+    double dispatch_us;    // 等待请求工作线程
+    double parse_us;       // JSON解析（image字段与features）
+    double base64_us;      // Base64解码
+    double queue_us;       // 等待NPU的排队时间（工作线程间竞争NPU）
+    double decode_us;      // JPEG解码
+    double preprocess_us;  // 缩放等预处理
+    double npu_us;         // 图像模型推理及取输出（溢出到CPU时为CPU推理）
+    double svm_us;         // 血常规特征模型（在CPU工作线程中与NPU并行）
+    double join_wait_us;   // NPU完成后等待特征模型的时间
+    double parallel_us;    // NPU与特征模型并行段的墙钟时间
+    double fusion_us;      // 结果融合
+    double total_us;       // 请求总耗时
+    int npu_batch;         // 所在NPU批次的有效输入数（未运行NPU时为0）
+};
+
+// 服务器运行配置（命令行参数 --key=value）
+struct ServerConfig {
+    bool timing_header = false;  // 响应附加 Server-Timing 头
+    bool timing_json = false;    // 响应JSON附加 timing 对象
+    bool svm_native = true;      // 特征模型优先使用原生求值器
+    int svm_bench_threads = 0;   // >0 时只运行特征模型并发测试
+    int cpu_workers = 1;         // 特征模型工作线程数，0 为顺序执行
+    bool stage_metrics = false;  // /api/metrics 统计各阶段耗时（开启后每个请求都采集阶段时间戳）
+    bool cascade = false;        // 特征模型置信度足够时跳过图像模型
+    float cascade_thresholds[3] = {0.95f, 0.95f, 0.95f};  // 各类别的级联阈值
+    int request_workers = 2;         // 分类请求工作线程数，0 为在事件循环中处理
+    bool degrade = false;            // NPU过载时只用特征模型应答
+    double degrade_slo_ms = 200;     // 预计NPU排队超过该值进入降级
+    double degrade_exit_ms = -1;     // 低于该值退出降级，<0 表示 SLO/2
+    double degrade_hold_ms = 1000;   // 降级最短持续时间
+    std::string results_file = "inference_results.csv";  // 推理结果CSV
+    int results_flush_rows = 64;     // 每累计N行写出一次
+    int results_flush_ms = 1000;     // 定时写出间隔，0 为关闭
+    bool results_fsync = false;      // 写出后 fdatasync
+    int results_queue = 4096;        // 结果队列容量
+    double results_rotate_mb = 0;    // 按大小轮转，0 为关闭
+    int results_rotate_s = 0;        // 按周期轮转（秒），0 为关闭
+    bool results_compress = true;    // 压缩轮转出的分段
+    double results_retain_mb = 64;   // 分段合计上限，0 为不限制
+    std::string store_dir = "results";  // 二进制结果存储目录，空为关闭
+    double store_segment_mb = 8;     // 数据段大小
+    double store_retain_mb = 128;    // 数据段合计上限，0 为不限制
+    int results_query_limit = 1000;  // /api/results 默认最多返回条数
+    double cache_mb = 2;             // 结果缓存内存上限，0 为关闭
+    double cache_ttl_s = 600;        // 缓存条目有效期，0 为不过期
+    bool coalesce = true;            // 相同输入的并发请求共用一次计算
+    bool near_dup = false;           // 感知哈希近似重复图像复用RKNN结果
+    int near_dup_distance = 4;       // 最大汉明距离
+    int near_dup_entries = 4096;     // 条目数
+    double near_dup_ttl_s = 600;     // 条目有效期，0 为不过期
+    int npu_batch_window_us = 2000;  // 批大小>1的模型：组批最长等待时间
+    int npu_bench_rounds = 0;        // >0 时只运行NPU批处理测试
+    std::string backend = "rknn";    // 图像模型主后端：rknn 或 onnx（无NPU的主机上使用 --cpu-model）
+    int onnx_width = 224;            // onnx 主后端的模型输入尺寸
+    int onnx_height = 224;
+    std::string cpu_model;           // 图像模型的ONNX导出，非空时NPU排队过长的请求溢出到CPU
+    int cpu_slots = 1;               // CPU后端最多同时推理的请求数
+    float cpu_mean[3] = {0, 0, 0};   // CPU后端输入归一化，与RKNN转换参数一致
+    float cpu_std[3] = {1, 1, 1};
+    bool cpu_swap_rb = false;        // CPU模型输入为RGB
+    std::string capture_dir;         // 流量存档目录，非空时采集 /api/classify 请求供 replay 重放
+    int capture_sample = 1;          // 每N个请求采集1个
+    double capture_max_mb = 1024;    // 单个存档大小上限，0 为不限制
+    double mat_pool_mb = 64;         // 图像解码缓冲池保留的空闲内存上限，0 为关闭
+    double mat_pool_idle_s = 30;     // 超过该时间没有请求时释放缓冲池的空闲内存，0 为不释放
+    bool stream_body = false;        // 边接收边解码 /api/classify 的图像字段
+    double stream_max_mb = 32;       // 流式模式下请求体大小上限
+    double stream_budget_mb = 96;    // 所有流式接收中的请求预分配缓冲之和的上限，0 为关闭
+    std::string decoder = "opencv";  // 图像解码后端：opencv / stb
+    std::string resizer = "opencv";  // 缩放后端：opencv / stb
+    uint64_t max_image_pixels = 16000000;  // 解码前按文件头检查的像素数上限，0 为不限制
+    int max_image_side = 8192;       // 宽或高上限，0 为不限制
+    double decode_budget_mb = 192;   // 并发解码预计占用内存之和的上限，0 为关闭
+    int decode_wait_ms = 2000;       // 预算不足时等待的时间，超时放弃
+};
+
+extern ServerConfig g_config;
+
 // 添加结果保存函数声明
-void save_inference_result(const FusionResult& result,
-                         double processing_time);
+void save_inference_result(const FusionResult& result, const RequestTiming& timing,
+                           uint64_t request_id, uint64_t input_hash);
 
 #endif // _ATK_MOBILENET_OBJECT_CLASSIFICATION_H
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "base64.h"
+
+// Base64解码表
+static const unsigned char base64_table[256] = {
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,62,255,255,255,63,
+    52,53,54,55,56,57,58,59,60,61,255,255,255,0,255,255,
+    255,0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,
+    15,16,17,18,19,20,21,22,23,24,25,255,255,255,255,255,
+    255,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,
+    41,42,43,44,45,46,47,48,49,50,51,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255
+};
+
+void Base64StreamDecoder::feed(const char *in, size_t len) {
+    unsigned char char_array_3[3];
+    for (size_t i = 0; i < len && !done_; i++) {
+        if (in[i] == '=') {
+            done_ = true;
+            break;
+        }
+        unsigned char c = base64_table[(unsigned char)in[i]];
+        if (c == 255) continue; // 跳过无效字符
+
+        quad_[j_++] = c;
+        if (j_ == 4) {
+            char_array_3[0] = (quad_[0] << 2) + ((quad_[1] & 0x30) >> 4);
+            char_array_3[1] = ((quad_[1] & 0xf) << 4) + ((quad_[2] & 0x3c) >> 2);
+            char_array_3[2] = ((quad_[2] & 0x3) << 6) + quad_[3];
+            out_[n_++] = char_array_3[0];
+            out_[n_++] = char_array_3[1];
+            out_[n_++] = char_array_3[2];
+            j_ = 0;
+        }
+    }
+}
+
+size_t Base64StreamDecoder::finish() {
+    if (j_) {
+        unsigned char char_array_3[3];
+        for (size_t k = j_; k < 4; k++)
+            quad_[k] = 0;
+
+        char_array_3[0] = (quad_[0] << 2) + ((quad_[1] & 0x30) >> 4);
+        char_array_3[1] = ((quad_[1] & 0xf) << 4) + ((quad_[2] & 0x3c) >> 2);
+        char_array_3[2] = ((quad_[2] & 0x3) << 6) + quad_[3];
+
+        for (size_t k = 0; k < j_ - 1; k++)
+            out_[n_++] = char_array_3[k];
+        j_ = 0;
+    }
+    return n_;
+}
+
+size_t base64_decode_into(const char *encoded, size_t len, unsigned char *out) {
+    Base64StreamDecoder decoder(out);
+    decoder.feed(encoded, len);
+    return decoder.finish();
+}
@@ -0,0 +1,34 @@
+#ifndef _BASE64_H
+#define _BASE64_H
+
+#include <stddef.h>
+
+// 解码后长度的上限
+static inline size_t base64_decoded_capacity(size_t encoded_len) {
+    return encoded_len / 4 * 3 + 3;
+}
+
+// 分段输入的Base64解码器，写入调用方提供的缓冲（至少为全部输入的 base64_decoded_capacity）
+// 跳过无效字符，遇到第一个 '=' 后忽略其余输入
+class Base64StreamDecoder {
+public:
+    explicit Base64StreamDecoder(unsigned char *out) : out_(out), n_(0), j_(0), done_(false) {}
+
+    void feed(const char *in, size_t len);
+    // 输出末尾不足4个字符的部分，返回解码后的总长度
+    size_t finish();
+
+    size_t size() const { return n_; }
+
+private:
+    unsigned char *out_;
+    size_t n_;
+    unsigned char quad_[4];
+    size_t j_;
+    bool done_;
+};
+
+// 一次解码整段输入，返回解码后长度
+size_t base64_decode_into(const char *encoded, size_t len, unsigned char *out);
+
+#endif // _BASE64_H
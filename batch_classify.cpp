@@ -0,0 +1,448 @@
+// 离线批量分类：不经过HTTP，直接对清单或目录中的图片运行推理流水线
+// 用法: batch_classify [选项] [服务器参数...] [图片或目录...]
+//   --manifest=FILE       CSV清单，每行为 图片路径,34个特征值（路径相对清单所在目录）
+//                         直接给出的图片与目录没有特征值，只输出图像模型结果
+//   --out=FILE            结果CSV (默认 batch_results.csv)，为空时不写
+//   --store-dir=DIR       同时写入二进制结果存储（可用 /api/results 或 results_to_csv 读取）
+//   --decode-threads=N    解码与预处理线程数 (默认 CPU核心数)
+//   --feature-batch=N     特征模型每批样本数 (默认 64)
+//   --queue=N             各阶段之间的队列长度 (默认 64)
+// 其余 -- 参数按服务器的启动参数解析，如 --backend=onnx --cpu-model=FILE --cpu-slots=2
+// --npu-batch-window-us=N --svm-native=0。
+//
+// 流水线：解码线程读取文件、解码（--decoder）、缩放到模型输入尺寸 → 推理线程
+// （NPU一个线程，每次取满模型批大小；配置了 --cpu-model 时另有 --cpu-slots 个CPU线程
+// 从同一队列取图）→ 特征模型线程按批求值并融合 → 主线程写出结果并每秒报告进度。
+// 结果按完成顺序写出，index 列为输入中的序号。
+
+#define ATK_NO_MAIN
+#include "atk_mobilenet_object_classification.cpp"
+
+#include <algorithm>
+#include <deque>
+
+#include "manifest.h"
+
+struct BatchOptions {
+    std::string manifest;
+    std::string out = "batch_results.csv";
+    std::string store_dir;
+    int decode_threads = 0;
+    int feature_batch = 64;
+    int queue = 64;
+};
+
+static BatchOptions s_opt;
+
+struct BatchItem {
+    size_t index;
+    const ManifestEntry *entry;
+    cv::Mat input;        // 缩放后的模型输入
+    uint64_t input_hash;  // 图片文件内容与特征值
+    const char *error;    // 非空表示失败
+    ClassificationResult image;
+    int svm_class;
+    float svm_prob;
+    float svm_probs[kResultClasses];
+    FusionResult result;
+    RequestTiming timing;
+};
+
+// 有界阻塞队列；close() 后 pop 取完剩余元素后返回 false
+class ItemQueue {
+public:
+    explicit ItemQueue(size_t capacity) : capacity_(capacity), closed_(false) {}
+
+    void push(BatchItem *item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this]() { return items_.size() < capacity_; });
+        items_.push_back(item);
+        not_empty_.notify_one();
+    }
+
+    // 等到至少一个元素后，最多再等 window_us 凑满 max 个
+    bool pop(std::vector<BatchItem *> *out, size_t max, int window_us) {
+        out->clear();
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this]() { return closed_ || !items_.empty(); });
+        if (items_.empty()) return false;
+        if (items_.size() < max && window_us > 0) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(window_us);
+            not_empty_.wait_until(lock, deadline, [this, max]() {
+                return closed_ || items_.size() >= max;
+            });
+        }
+        while (!items_.empty() && out->size() < max) {
+            out->push_back(items_.front());
+            items_.pop_front();
+        }
+        not_full_.notify_all();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    bool closed_;
+    std::deque<BatchItem *> items_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_, not_full_;
+};
+
+// 一个阶段的全部线程结束后关闭下游队列
+struct Stage {
+    std::atomic<int> running;
+    ItemQueue *downstream;
+    std::atomic<uint64_t> busy_us;  // 各线程处理耗时之和
+
+    Stage(int threads, ItemQueue *next) : running(threads), downstream(next), busy_us(0) {}
+    void exit() {
+        if (--running == 0) downstream->close();
+    }
+};
+
+static bool read_file(const std::string &path, std::vector<unsigned char> *out) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in) return false;
+    out->assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !out->empty();
+}
+
+static void decode_worker(const std::vector<ManifestEntry> *entries, std::atomic<size_t> *next,
+                          ItemQueue *infer, ItemQueue *done, Stage *stage) {
+    std::vector<unsigned char> bytes;
+    for (size_t i; (i = (*next)++) < entries->size();) {
+        double t0 = now_us();
+        BatchItem *item = new BatchItem();
+        item->index = i;
+        item->entry = &(*entries)[i];
+        const std::vector<float> &features = item->entry->features;
+        if (!read_file(item->entry->path, &bytes)) {
+            item->error = "read";
+            done->push(item);
+            continue;
+        }
+        item->input_hash = content_hash64(bytes.data(), bytes.size(),
+            content_hash64(features.data(), features.size() * sizeof(float)));
+        // 解码缓冲与模型输入都取自服务器的图像缓冲池（--mat-pool-mb）
+        cv::Mat img;
+        s_mat_pool.attach(img);
+        bool decoded = s_decoder->decode(bytes.data(), bytes.size(), img);
+        double t1 = now_us();
+        item->timing.decode_us = t1 - t0;
+        if (!decoded) {
+            item->error = "decode";
+            done->push(item);
+            continue;
+        }
+        s_mat_pool.attach(item->input);
+        item->input.create(s_model_height, s_model_width, CV_8UC3);
+        s_resizer->resize(img, item->input);
+        double t2 = now_us();
+        item->timing.preprocess_us = t2 - t1;
+        stage->busy_us += (uint64_t)(t2 - t0);
+        infer->push(item);
+    }
+    stage->exit();
+}
+
+// 主后端：每次最多取模型批大小张图，一次推理
+static void npu_worker(ItemQueue *infer, ItemQueue *features, Stage *stage,
+                       std::atomic<uint64_t> *batches) {
+    size_t item_bytes = (size_t)s_model_width * s_model_height * 3;
+    std::vector<uint8_t> input(item_bytes * s_model_batch, 0);
+    std::vector<NpuBatchOutput> outputs(s_model_batch);
+    std::vector<BatchItem *> batch;
+    while (infer->pop(&batch, s_model_batch, g_config.npu_batch_window_us)) {
+        int n = (int)batch.size();
+        for (int i = 0; i < n; i++) {
+            memcpy(&input[i * item_bytes], batch[i]->input.data, item_bytes);
+        }
+        if (n < s_model_batch) {
+            memset(&input[n * item_bytes], 0, (s_model_batch - n) * item_bytes);
+        }
+        double t0 = now_us();
+        bool ok = npu_run_batch(input.data(), n, outputs.data());
+        double run_us = now_us() - t0;
+        stage->busy_us += (uint64_t)run_us;
+        (*batches)++;
+        for (int i = 0; i < n; i++) {
+            BatchItem *item = batch[i];
+            if (!ok || !outputs[i].ok) {
+                item->error = "inference";
+            } else {
+                item->image.class_id = outputs[i].class_id;
+                item->image.probability = outputs[i].probability;
+                memcpy(item->image.probs, outputs[i].probs, sizeof(item->image.probs));
+                item->image.backend = kBackendNpu;
+            }
+            item->timing.npu_us = run_us / n;
+            item->timing.npu_batch = n;
+            item->input.release();
+            features->push(item);
+        }
+    }
+    stage->exit();
+}
+
+// CPU后端（--cpu-model）：与NPU线程从同一队列取图，谁空闲谁处理
+static void cpu_worker(ItemQueue *infer, ItemQueue *features, Stage *stage) {
+    std::vector<BatchItem *> batch;
+    while (infer->pop(&batch, 1, 0)) {
+        BatchItem *item = batch[0];
+        float logits[3];
+        double t0 = now_us();
+        if (s_cpu_classifier->classify(item->input, logits, 3)) {
+            rknn_GetResult(logits, &item->image);
+            item->image.backend = kBackendCpu;
+        } else {
+            item->error = "inference";
+        }
+        item->timing.npu_us = now_us() - t0;
+        item->timing.npu_batch = 1;
+        stage->busy_us += (uint64_t)item->timing.npu_us;
+        item->input.release();
+        features->push(item);
+    }
+    stage->exit();
+}
+
+// 特征模型按批求值后与图像模型结果融合；没有特征值的样本直接采用图像模型结果
+static void feature_worker(ItemQueue *features, ItemQueue *done, Stage *stage) {
+    std::vector<BatchItem *> batch, rows;
+    std::vector<float> packed;
+    std::vector<int> classes;
+    std::vector<float> probs;
+    while (features->pop(&batch, s_opt.feature_batch, 1000)) {
+        double t0 = now_us();
+        rows.clear();
+        packed.clear();
+        for (size_t i = 0; i < batch.size(); i++) {
+            BatchItem *item = batch[i];
+            if (!item->error && !item->entry->features.empty()) {
+                rows.push_back(item);
+                packed.insert(packed.end(), item->entry->features.begin(),
+                              item->entry->features.end());
+            }
+        }
+        classes.resize(rows.size());
+        probs.resize(rows.size() * 3);
+        bool ok = rows.empty() || svm_model->predict_batch(
+            packed.data(), rows.size(), kManifestFeatures, classes.data(), probs.data());
+        double svm_us = now_us() - t0;
+        for (size_t r = 0; r < rows.size(); r++) {
+            rows[r]->svm_class = ok ? classes[r] : -1;
+            rows[r]->svm_prob = ok ? probs[r * 3 + classes[r]] : 0.0f;
+            if (ok) memcpy(rows[r]->svm_probs, &probs[r * 3], sizeof(rows[r]->svm_probs));
+            rows[r]->timing.svm_us = svm_us / rows.size();
+        }
+        for (size_t i = 0; i < batch.size(); i++) {
+            BatchItem *item = batch[i];
+            if (item->error) {
+                // 前面的阶段已失败，原样交给写出
+            } else if (item->entry->features.empty()) {
+                item->result = FusionResult();
+                item->result.class_id = item->image.class_id;
+                item->result.probability = item->image.probability;
+                item->result.rknn_score = item->image.probability;
+                memcpy(item->result.rknn_probs, item->image.probs, sizeof(item->result.rknn_probs));
+                item->result.backend = item->image.backend;
+            } else if (item->svm_class < 0) {
+                item->error = "feature_model";
+            } else {
+                item->result = weighted_fusion((float)item->svm_class, item->image.probability);
+                memcpy(item->result.svm_probs, item->svm_probs, sizeof(item->result.svm_probs));
+                memcpy(item->result.rknn_probs, item->image.probs, sizeof(item->result.rknn_probs));
+                item->result.backend = item->image.backend;
+            }
+            done->push(item);
+        }
+        stage->busy_us += (uint64_t)(now_us() - t0);
+    }
+    stage->exit();
+}
+
+static void print_batch_usage(const char *prog) {
+    printf("用法: %s [选项] [服务器参数...] [图片或目录...]\n", prog);
+    printf("  --manifest=FILE       CSV清单: 图片路径,34个特征值\n");
+    printf("  --out=FILE            结果CSV (默认 batch_results.csv)\n");
+    printf("  --store-dir=DIR       同时写入二进制结果存储\n");
+    printf("  --decode-threads=N    解码与预处理线程数 (默认 CPU核心数)\n");
+    printf("  --feature-batch=N     特征模型每批样本数 (默认 64)\n");
+    printf("  --queue=N             阶段间队列长度 (默认 64)\n");
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<char *> server_args(1, argv[0]);
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--manifest=", 11) == 0) {
+            s_opt.manifest = arg + 11;
+        } else if (strncmp(arg, "--out=", 6) == 0) {
+            s_opt.out = arg + 6;
+        } else if (strncmp(arg, "--store-dir=", 12) == 0) {
+            s_opt.store_dir = arg + 12;
+        } else if (strncmp(arg, "--decode-threads=", 17) == 0) {
+            s_opt.decode_threads = atoi(arg + 17);
+        } else if (strncmp(arg, "--feature-batch=", 16) == 0) {
+            s_opt.feature_batch = std::max(1, atoi(arg + 16));
+        } else if (strncmp(arg, "--queue=", 8) == 0) {
+            s_opt.queue = std::max(1, atoi(arg + 8));
+        } else if (strcmp(arg, "--help") == 0) {
+            print_batch_usage(argv[0]);
+            return 0;
+        } else if (strncmp(arg, "--", 2) == 0) {
+            server_args.push_back(argv[i]);
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    g_config.cache_mb = 0;
+    if (!parse_args((int)server_args.size(), server_args.data(), &g_config)) {
+        print_batch_usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<ManifestEntry> entries;
+    std::string error;
+    if (!s_opt.manifest.empty() && !load_manifest(s_opt.manifest, &entries, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!add_image_path(paths[i], &entries, &error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+    if (entries.empty()) {
+        print_batch_usage(argv[0]);
+        return 1;
+    }
+
+    init_models();
+    init_cpu_workers();
+    npu_init();
+
+    FILE *csv = NULL;
+    if (!s_opt.out.empty()) {
+        csv = fopen(s_opt.out.c_str(), "w");
+        if (!csv) {
+            fprintf(stderr, "无法写入 %s\n", s_opt.out.c_str());
+            return 1;
+        }
+        fprintf(csv, "index,path,class,probability,blood_score,rknn_class,rknn_score,backend,error\n");
+    }
+    if (!s_opt.store_dir.empty()) {
+        ResultWriter::Options writer_opt;
+        writer_opt.flush_rows = 256;
+        writer_opt.fsync = false;
+        writer_opt.queue_capacity = 4096;
+        writer_opt.rotate_bytes = 0;
+        writer_opt.rotate_period_s = 0;
+        writer_opt.compress = false;
+        writer_opt.retain_bytes = 0;
+        writer_opt.store_dir = s_opt.store_dir;
+        writer_opt.store_segment_bytes = (uint64_t)(g_config.store_segment_mb * 1024 * 1024);
+        writer_opt.store_retain_bytes = 0;  // 离线结果全部保留
+        if (!s_result_writer.start(writer_opt)) {
+            fprintf(stderr, "无法打开结果存储 %s\n", s_opt.store_dir.c_str());
+            return 1;
+        }
+    }
+
+    int decode_threads = s_opt.decode_threads > 0 ? s_opt.decode_threads
+                                                  : std::max(1u, std::thread::hardware_concurrency());
+    int cpu_threads = s_cpu_classifier ? s_cpu_classifier->slots() : 0;
+    printf("样本 %zu 个, 后端 %s (批大小 %d)%s, 解码线程 %d, 特征模型 %s 每批 %d\n",
+           entries.size(), s_backend->name(), s_model_batch,
+           cpu_threads ? " + CPU" : "", decode_threads,
+           svm_model->using_native() ? "native" : "dnn", s_opt.feature_batch);
+
+    ItemQueue infer_queue(s_opt.queue), feature_queue(s_opt.queue), done_queue(s_opt.queue);
+    Stage decode_stage(decode_threads, &infer_queue);
+    Stage infer_stage(1 + cpu_threads, &feature_queue);
+    Stage feature_stage(1, &done_queue);
+    std::atomic<size_t> next(0);
+    std::atomic<uint64_t> npu_batches(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < decode_threads; i++) {
+        threads.push_back(std::thread(decode_worker, &entries, &next, &infer_queue,
+                                      &done_queue, &decode_stage));
+    }
+    threads.push_back(std::thread(npu_worker, &infer_queue, &feature_queue, &infer_stage,
+                                  &npu_batches));
+    for (int i = 0; i < cpu_threads; i++) {
+        threads.push_back(std::thread(cpu_worker, &infer_queue, &feature_queue, &infer_stage));
+    }
+    threads.push_back(std::thread(feature_worker, &feature_queue, &done_queue, &feature_stage));
+
+    // 写出结果；失败的样本也写一行，error 列给出失败阶段
+    double start = now_us(), last_report = start;
+    size_t done = 0, failed = 0, last_done = 0, npu_items = 0, cpu_items = 0;
+    std::vector<BatchItem *> batch;
+    while (done < entries.size() && done_queue.pop(&batch, 256, 0)) {
+        for (size_t i = 0; i < batch.size(); i++) {
+            BatchItem *item = batch[i];
+            const FusionResult &r = item->result;
+            if (item->error) {
+                failed++;
+                if (csv) {
+                    fprintf(csv, "%zu,%s,,,,,,,%s\n", item->index, item->entry->path.c_str(),
+                            item->error);
+                }
+            } else {
+                (item->image.backend == kBackendCpu ? cpu_items : npu_items)++;
+                item->timing.total_us = item->timing.decode_us + item->timing.preprocess_us +
+                                        item->timing.npu_us + item->timing.svm_us;
+                if (csv) {
+                    char blood[16] = "";
+                    if (!item->entry->features.empty()) {
+                        snprintf(blood, sizeof(blood), "%.0f", r.svm_score);
+                    }
+                    fprintf(csv, "%zu,%s,%d,%.4f,%s,%d,%.4f,%s,\n", item->index,
+                            item->entry->path.c_str(), r.class_id, r.probability, blood,
+                            item->image.class_id, item->image.probability,
+                            backend_name(r.backend));
+                }
+                if (!s_opt.store_dir.empty()) {
+                    save_inference_result(r, item->timing, item->index + 1, item->input_hash);
+                }
+            }
+            delete item;
+            done++;
+        }
+        double now = now_us();
+        if (now - last_report >= 1e6) {
+            fprintf(stderr, "已处理 %zu/%zu, 当前 %.1f 张/秒, 平均 %.1f 张/秒, 失败 %zu\n",
+                    done, entries.size(), (done - last_done) * 1e6 / (now - last_report),
+                    done * 1e6 / (now - start), failed);
+            last_report = now;
+            last_done = done;
+        }
+    }
+    for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+    double wall_us = now_us() - start;
+
+    if (csv) fclose(csv);
+    s_result_writer.stop();
+
+    printf("完成 %zu 个样本 (失败 %zu), 耗时 %.2f 秒, %.1f 张/秒\n",
+           done, failed, wall_us / 1e6, done * 1e6 / wall_us);
+    // 各阶段忙碌时间占比，接近100%的阶段即为瓶颈
+    printf("解码与预处理: %d 线程, 平均占用 %.0f%%\n", decode_threads,
+           decode_stage.busy_us.load() * 100.0 / (wall_us * decode_threads));
+    printf("图像推理: NPU %zu 张 / %llu 批 (平均 %.2f 张/批)", npu_items,
+           (unsigned long long)npu_batches.load(),
+           npu_batches.load() ? (double)npu_items / npu_batches.load() : 0.0);
+    if (cpu_threads) printf(", CPU %zu 张", cpu_items);
+    printf(", 平均占用 %.0f%%\n", infer_stage.busy_us.load() * 100.0 / (wall_us * (1 + cpu_threads)));
+    printf("特征模型与融合: 平均占用 %.0f%%\n", feature_stage.busy_us.load() * 100.0 / wall_us);
+    return failed ? 2 : 0;
+}
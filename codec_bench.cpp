@@ -0,0 +1,428 @@
+// 图像解码/缩放后端（--decoder/--resizer）的对比测试
+// 用法: codec_bench [选项] 图片或目录...
+//   --manifest=FILE     CSV清单（与 golden/batch_classify 相同），只使用其中的图片
+//   --decoders=LIST     参与比较的解码后端，逗号分隔 (默认 opencv,stb)
+//   --resizers=LIST     参与比较的缩放后端 (默认 opencv,stb)
+//   --size=WxH          缩放目标尺寸 (默认 224x224，与模型输入一致)
+//   --reps=N            每张图片每个后端的测量次数，取中位数 (默认 5)
+//   --cpu=N             绑定到第N个CPU核心
+//   --json=FILE         结果写成JSON
+//
+// 每个后端输出：单张耗时（各图片中位数的平均值、p50、p95、最大值）、吞吐（百万像素/秒）、
+// 单次调用期间的堆内存峰值（相对调用前），以及与 opencv 后端输出的平均/最大像素差
+// （解码比较解码图像，缩放比较同一解码图像的缩放结果）。
+// 像素差不为0时模型输入随之变化，切换后端前应再用 golden 核对分类结果。
+
+#include <errno.h>
+#include <malloc.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+#include "image_codec.h"
+#include "manifest.h"
+#include "metrics.h"
+
+// ---- 堆内存峰值 ----
+// 包装 glibc 的 malloc 系列，按 malloc_usable_size 统计开启计数的线程上的存活字节数。
+// 调用前分配、调用中释放的内存会使存活字节数低于起点，峰值按相对起点计算。
+static __thread bool t_counting = false;
+static __thread int64_t t_live = 0;
+static __thread int64_t t_peak = 0;
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+
+static inline void *count_alloc(void *p) {
+    if (t_counting && p) {
+        t_live += (int64_t)malloc_usable_size(p);
+        if (t_live > t_peak) t_peak = t_live;
+    }
+    return p;
+}
+static inline void count_free(void *p) {
+    if (t_counting && p) t_live -= (int64_t)malloc_usable_size(p);
+}
+
+void *malloc(size_t size) { return count_alloc(__libc_malloc(size)); }
+void *calloc(size_t n, size_t size) { return count_alloc(__libc_calloc(n, size)); }
+void *realloc(void *ptr, size_t size) {
+    count_free(ptr);
+    return count_alloc(__libc_realloc(ptr, size));
+}
+void free(void *ptr) {
+    count_free(ptr);
+    __libc_free(ptr);
+}
+int posix_memalign(void **out, size_t alignment, size_t size) {
+    void *p = count_alloc(__libc_memalign(alignment, size));
+    if (!p) return ENOMEM;
+    *out = p;
+    return 0;
+}
+void *memalign(size_t alignment, size_t size) {
+    return count_alloc(__libc_memalign(alignment, size));
+}
+void *aligned_alloc(size_t alignment, size_t size) {
+    return count_alloc(__libc_memalign(alignment, size));
+}
+}
+#endif
+
+static void begin_counting() {
+    t_live = 0;
+    t_peak = 0;
+    t_counting = true;
+}
+
+static size_t end_counting() {
+    t_counting = false;
+    return (size_t)t_peak;
+}
+
+static double now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+struct CodecBenchOptions {
+    std::string manifest;
+    std::vector<std::string> decoders;
+    std::vector<std::string> resizers;
+    int width = 224;
+    int height = 224;
+    int reps = 5;
+    int cpu = -1;
+    std::string json_file;
+};
+
+static CodecBenchOptions s_opt;
+
+struct Image {
+    std::string path;
+    std::vector<unsigned char> bytes;
+    cv::Mat reference;          // opencv 解码结果
+    cv::Mat reference_resized;  // 由 reference 经 opencv 缩放
+};
+
+// 一个后端在全部图片上的测量结果
+struct BackendStats {
+    std::string kind;  // decode / resize
+    std::string name;
+    int images = 0;
+    int failed = 0;
+    std::vector<double> us;      // 每张图片的中位耗时
+    std::vector<size_t> peak;    // 每张图片单次调用的堆内存峰值
+    double pixels = 0;           // 处理的像素总数（源图像）
+    double total_us = 0;         // us 之和
+    double diff_sum = 0;         // 与 opencv 输出的平均绝对像素差之和
+    double diff_max = 0;
+};
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t idx = (size_t)(p * (v.size() - 1) + 0.5);
+    return v[idx];
+}
+
+static double median(std::vector<double> v) { return percentile(v, 0.5); }
+
+// 平均与最大绝对差，尺寸不同时返回 false
+static bool pixel_diff(const cv::Mat &a, const cv::Mat &b, double *mean, double *max) {
+    if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type()) return false;
+    uint64_t sum = 0;
+    int peak = 0;
+    size_t row_bytes = (size_t)a.cols * a.elemSize();
+    for (int y = 0; y < a.rows; y++) {
+        const unsigned char *pa = a.ptr<unsigned char>(y);
+        const unsigned char *pb = b.ptr<unsigned char>(y);
+        for (size_t x = 0; x < row_bytes; x++) {
+            int d = abs((int)pa[x] - (int)pb[x]);
+            sum += d;
+            if (d > peak) peak = d;
+        }
+    }
+    size_t bytes = row_bytes * a.rows;
+    *mean = bytes ? (double)sum / bytes : 0;
+    *max = peak;
+    return true;
+}
+
+static void record(BackendStats *stats, const Image &img, const std::vector<double> &samples,
+                   size_t peak, const cv::Mat &out, const cv::Mat &reference) {
+    double us = median(samples);
+    stats->images++;
+    stats->us.push_back(us);
+    stats->peak.push_back(peak);
+    stats->total_us += us;
+    stats->pixels += (double)img.reference.cols * img.reference.rows;
+    double mean = 0, max = 0;
+    if (pixel_diff(out, reference, &mean, &max)) {
+        stats->diff_sum += mean;
+        stats->diff_max = std::max(stats->diff_max, max);
+    } else {
+        stats->diff_sum += 255;
+        stats->diff_max = 255;
+    }
+}
+
+static BackendStats bench_decoder(const ImageDecoder *decoder, const std::vector<Image> &images) {
+    BackendStats stats;
+    stats.kind = "decode";
+    stats.name = decoder->name();
+    for (size_t i = 0; i < images.size(); i++) {
+        const Image &img = images[i];
+        std::vector<double> samples;
+        size_t peak = 0;
+        cv::Mat out;
+        bool ok = true;
+        for (int r = 0; r < s_opt.reps && ok; r++) {
+            out.release();
+            begin_counting();
+            double t0 = now_us();
+            ok = decoder->decode(img.bytes.data(), img.bytes.size(), out);
+            samples.push_back(now_us() - t0);
+            peak = std::max(peak, end_counting());
+        }
+        if (!ok) {
+            fprintf(stderr, "%s 解码失败: %s\n", decoder->name(), img.path.c_str());
+            stats.failed++;
+            continue;
+        }
+        record(&stats, img, samples, peak, out, img.reference);
+    }
+    return stats;
+}
+
+static BackendStats bench_resizer(const ImageResizer *resizer, const std::vector<Image> &images) {
+    BackendStats stats;
+    stats.kind = "resize";
+    stats.name = resizer->name();
+    cv::Mat out(s_opt.height, s_opt.width, CV_8UC3);
+    for (size_t i = 0; i < images.size(); i++) {
+        const Image &img = images[i];
+        std::vector<double> samples;
+        size_t peak = 0;
+        for (int r = 0; r < s_opt.reps; r++) {
+            begin_counting();
+            double t0 = now_us();
+            resizer->resize(img.reference, out);
+            samples.push_back(now_us() - t0);
+            peak = std::max(peak, end_counting());
+        }
+        record(&stats, img, samples, peak, out, img.reference_resized);
+    }
+    return stats;
+}
+
+static void print_stats(const BackendStats &s) {
+    double mpix_s = s.total_us > 0 ? s.pixels / s.total_us : 0;
+    std::vector<double> peak_mb;
+    for (size_t i = 0; i < s.peak.size(); i++) peak_mb.push_back(s.peak[i] / (1024.0 * 1024.0));
+    double peak_avg = 0;
+    for (size_t i = 0; i < peak_mb.size(); i++) peak_avg += peak_mb[i];
+    if (!peak_mb.empty()) peak_avg /= peak_mb.size();
+    printf("%-7s %-7s %5d %4d %9.3f %9.3f %9.3f %9.3f %9.1f %9.2f %9.2f %8.3f %5.0f\n",
+           s.kind.c_str(), s.name.c_str(), s.images, s.failed,
+           s.images ? s.total_us / s.images / 1e3 : 0, percentile(s.us, 0.5) / 1e3,
+           percentile(s.us, 0.95) / 1e3, percentile(s.us, 1.0) / 1e3, mpix_s, peak_avg,
+           peak_mb.empty() ? 0 : *std::max_element(peak_mb.begin(), peak_mb.end()),
+           s.images ? s.diff_sum / s.images : 0, s.diff_max);
+}
+
+static void write_stats(JsonWriter &w, const BackendStats &s) {
+    w.begin_object();
+    w.field("kind", s.kind.c_str());
+    w.field("name", s.name.c_str());
+    w.field("images", (uint64_t)s.images);
+    w.field("failed", (uint64_t)s.failed);
+    w.field("avg_ms", s.images ? s.total_us / s.images / 1e3 : 0.0);
+    w.field("p50_ms", percentile(s.us, 0.5) / 1e3);
+    w.field("p95_ms", percentile(s.us, 0.95) / 1e3);
+    w.field("max_ms", percentile(s.us, 1.0) / 1e3);
+    w.field("mpixels_per_s", s.total_us > 0 ? s.pixels / s.total_us : 0.0);
+    size_t peak_max = s.peak.empty() ? 0 : *std::max_element(s.peak.begin(), s.peak.end());
+    double peak_sum = 0;
+    for (size_t i = 0; i < s.peak.size(); i++) peak_sum += s.peak[i];
+    w.field("peak_bytes_avg", s.peak.empty() ? 0.0 : peak_sum / s.peak.size());
+    w.field("peak_bytes_max", (uint64_t)peak_max);
+    w.field("diff_mean", s.images ? s.diff_sum / s.images : 0.0);
+    w.field("diff_max", s.diff_max);
+    w.end_object();
+}
+
+static std::vector<std::string> split_list(const char *arg) {
+    std::vector<std::string> out;
+    std::string cur;
+    for (const char *p = arg;; p++) {
+        if (*p == ',' || *p == '\0') {
+            if (!cur.empty()) out.push_back(cur);
+            cur.clear();
+            if (*p == '\0') break;
+        } else {
+            cur += *p;
+        }
+    }
+    return out;
+}
+
+static void print_codec_bench_usage(const char *prog) {
+    printf("用法: %s [选项] 图片或目录...\n", prog);
+    printf("  --manifest=FILE   CSV清单: 图片路径,34个特征值\n");
+    printf("  --decoders=LIST   解码后端，逗号分隔 (默认 opencv,stb)\n");
+    printf("  --resizers=LIST   缩放后端，逗号分隔 (默认 opencv,stb)\n");
+    printf("  --size=WxH        缩放目标尺寸 (默认 224x224)\n");
+    printf("  --reps=N          每张图片每个后端的测量次数 (默认 5)\n");
+    printf("  --cpu=N           绑定到第N个CPU核心\n");
+    printf("  --json=FILE       结果写成JSON\n");
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> paths;
+    s_opt.decoders = split_list("opencv,stb");
+    s_opt.resizers = split_list("opencv,stb");
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--manifest=", 11) == 0) {
+            s_opt.manifest = arg + 11;
+        } else if (strncmp(arg, "--decoders=", 11) == 0) {
+            s_opt.decoders = split_list(arg + 11);
+        } else if (strncmp(arg, "--resizers=", 11) == 0) {
+            s_opt.resizers = split_list(arg + 11);
+        } else if (strncmp(arg, "--size=", 7) == 0) {
+            if (sscanf(arg + 7, "%dx%d", &s_opt.width, &s_opt.height) != 2 ||
+                s_opt.width <= 0 || s_opt.height <= 0) {
+                fprintf(stderr, "无效的 --size 取值: %s\n", arg + 7);
+                return 1;
+            }
+        } else if (strncmp(arg, "--reps=", 7) == 0) {
+            s_opt.reps = std::max(1, atoi(arg + 7));
+        } else if (strncmp(arg, "--cpu=", 6) == 0) {
+            s_opt.cpu = atoi(arg + 6);
+        } else if (strncmp(arg, "--json=", 7) == 0) {
+            s_opt.json_file = arg + 7;
+        } else if (strcmp(arg, "--help") == 0) {
+            print_codec_bench_usage(argv[0]);
+            return 0;
+        } else if (strncmp(arg, "--", 2) == 0) {
+            fprintf(stderr, "未知参数: %s\n", arg);
+            return 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    for (size_t i = 0; i < s_opt.decoders.size(); i++) {
+        if (!find_image_decoder(s_opt.decoders[i])) {
+            fprintf(stderr, "无效的解码后端: %s\n", s_opt.decoders[i].c_str());
+            return 1;
+        }
+    }
+    for (size_t i = 0; i < s_opt.resizers.size(); i++) {
+        if (!find_image_resizer(s_opt.resizers[i])) {
+            fprintf(stderr, "无效的缩放后端: %s\n", s_opt.resizers[i].c_str());
+            return 1;
+        }
+    }
+    if (s_opt.cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(s_opt.cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            perror("sched_setaffinity");
+        }
+    }
+
+    std::vector<ManifestEntry> entries;
+    std::string error;
+    if (!s_opt.manifest.empty() && !load_manifest(s_opt.manifest, &entries, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!add_image_path(paths[i], &entries, &error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+
+    // 读入全部图片，以 opencv 后端的输出作为像素差的参照
+    const ImageDecoder *ref_decoder = find_image_decoder("opencv");
+    const ImageResizer *ref_resizer = find_image_resizer("opencv");
+    std::vector<Image> images;
+    double total_mpix = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        Image img;
+        img.path = entries[i].path;
+        std::ifstream in(img.path.c_str(), std::ios::binary);
+        img.bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        if (img.bytes.empty()) {
+            fprintf(stderr, "无法读取 %s\n", img.path.c_str());
+            return 1;
+        }
+        if (!ref_decoder->decode(img.bytes.data(), img.bytes.size(), img.reference)) {
+            fprintf(stderr, "跳过无法解码的图片 %s\n", img.path.c_str());
+            continue;
+        }
+        img.reference_resized.create(s_opt.height, s_opt.width, CV_8UC3);
+        ref_resizer->resize(img.reference, img.reference_resized);
+        total_mpix += img.reference.cols * (double)img.reference.rows / 1e6;
+        images.push_back(img);
+    }
+    if (images.empty()) {
+        print_codec_bench_usage(argv[0]);
+        return 1;
+    }
+    printf("图片 %zu 张，共 %.1f 百万像素，缩放到 %dx%d，每项测量 %d 次\n",
+           images.size(), total_mpix, s_opt.width, s_opt.height, s_opt.reps);
+
+    std::vector<BackendStats> results;
+    for (size_t i = 0; i < s_opt.decoders.size(); i++) {
+        results.push_back(bench_decoder(find_image_decoder(s_opt.decoders[i]), images));
+    }
+    for (size_t i = 0; i < s_opt.resizers.size(); i++) {
+        results.push_back(bench_resizer(find_image_resizer(s_opt.resizers[i]), images));
+    }
+
+    printf("%-7s %-7s %5s %4s %9s %9s %9s %9s %9s %9s %9s %8s %5s\n", "阶段", "后端", "图片",
+           "失败", "平均(ms)", "p50(ms)", "p95(ms)", "最大(ms)", "MP/s", "峰值MB", "最大MB",
+           "像素差", "最大差");
+    for (size_t i = 0; i < results.size(); i++) {
+        print_stats(results[i]);
+    }
+
+    if (!s_opt.json_file.empty()) {
+        JsonWriter w;
+        w.begin_object();
+        w.field("images", (uint64_t)images.size());
+        w.field("megapixels", total_mpix);
+        w.field("reps", (uint64_t)s_opt.reps);
+        w.begin_array("backends");
+        for (size_t i = 0; i < results.size(); i++) {
+            write_stats(w, results[i]);
+        }
+        w.end_array();
+        w.end_object();
+        FILE *f = fopen(s_opt.json_file.c_str(), "w");
+        if (!f) {
+            perror(s_opt.json_file.c_str());
+            return 1;
+        }
+        fprintf(f, "%s\n", w.str().c_str());
+        fclose(f);
+    }
+    return 0;
+}
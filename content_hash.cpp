@@ -0,0 +1,161 @@
+#include "content_hash.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const uint64_t kPrime1 = 11400714785074694791ULL;
+static const uint64_t kPrime2 = 14029467366897019727ULL;
+static const uint64_t kPrime3 = 1609587929392839161ULL;
+static const uint64_t kPrime4 = 9650029242287828579ULL;
+static const uint64_t kPrime5 = 2870177450012600261ULL;
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// 非对齐读取，ARM上由编译器展开为安全的字节访问
+static inline uint64_t read64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    acc = rotl64(acc, 31);
+    return acc * kPrime1;
+}
+
+static inline uint64_t merge64(uint64_t acc, uint64_t val) {
+    acc ^= round64(0, val);
+    return acc * kPrime1 + kPrime4;
+}
+
+static inline uint64_t merge_lanes(const uint64_t v[4]) {
+    uint64_t h = rotl64(v[0], 1) + rotl64(v[1], 7) + rotl64(v[2], 12) + rotl64(v[3], 18);
+    h = merge64(h, v[0]);
+    h = merge64(h, v[1]);
+    h = merge64(h, v[2]);
+    h = merge64(h, v[3]);
+    return h;
+}
+
+static inline void init_lanes(uint64_t v[4], uint64_t seed) {
+    v[0] = seed + kPrime1 + kPrime2;
+    v[1] = seed + kPrime2;
+    v[2] = seed;
+    v[3] = seed - kPrime1;
+}
+
+// 处理不足32字节的尾部并做最后的混合
+static uint64_t finalize(uint64_t h, const unsigned char *p, const unsigned char *end) {
+    while (p + 8 <= end) {
+        h ^= round64(0, read64(p));
+        h = rotl64(h, 27) * kPrime1 + kPrime4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)read32(p) * kPrime1;
+        h = rotl64(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * kPrime5;
+        h = rotl64(h, 11) * kPrime1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t content_hash64(const void *data, size_t len, uint64_t seed) {
+    const unsigned char *p = (const unsigned char *)data;
+    const unsigned char *end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+        const unsigned char *limit = end - 32;
+        uint64_t v[4];
+        init_lanes(v, seed);
+        do {
+            v[0] = round64(v[0], read64(p));
+            v[1] = round64(v[1], read64(p + 8));
+            v[2] = round64(v[2], read64(p + 16));
+            v[3] = round64(v[3], read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = merge_lanes(v);
+    } else {
+        h = seed + kPrime5;
+    }
+
+    h += (uint64_t)len;
+    return finalize(h, p, end);
+}
+
+ContentHasher::ContentHasher(uint64_t seed) : seed_(seed), total_(0), buffered_(0) {
+    init_lanes(v_, seed);
+}
+
+void ContentHasher::update(const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    const unsigned char *end = p + len;
+    total_ += len;
+    if (buffered_ + len < 32) {
+        memcpy(buf_ + buffered_, p, len);
+        buffered_ += len;
+        return;
+    }
+    if (buffered_ > 0) {
+        size_t fill = 32 - buffered_;
+        memcpy(buf_ + buffered_, p, fill);
+        p += fill;
+        v_[0] = round64(v_[0], read64(buf_));
+        v_[1] = round64(v_[1], read64(buf_ + 8));
+        v_[2] = round64(v_[2], read64(buf_ + 16));
+        v_[3] = round64(v_[3], read64(buf_ + 24));
+        buffered_ = 0;
+    }
+    while (p + 32 <= end) {
+        v_[0] = round64(v_[0], read64(p));
+        v_[1] = round64(v_[1], read64(p + 8));
+        v_[2] = round64(v_[2], read64(p + 16));
+        v_[3] = round64(v_[3], read64(p + 24));
+        p += 32;
+    }
+    buffered_ = end - p;
+    memcpy(buf_, p, buffered_);
+}
+
+uint64_t ContentHasher::digest() const {
+    uint64_t h = total_ >= 32 ? merge_lanes(v_) : seed_ + kPrime5;
+    h += total_;
+    return finalize(h, buf_, buf_ + buffered_);
+}
+
+// 分块读取，每块的哈希作为下一块的种子
+uint64_t file_hash64(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return 0;
+    static const size_t kChunk = 64 * 1024;
+    unsigned char *buf = new unsigned char[kChunk];
+    uint64_t h = 0;
+    size_t n;
+    while ((n = fread(buf, 1, kChunk, fp)) > 0) {
+        h = content_hash64(buf, n, h);
+    }
+    delete[] buf;
+    fclose(fp);
+    return h;
+}
@@ -0,0 +1,32 @@
+#ifndef _CONTENT_HASH_H
+#define _CONTENT_HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 64位内容哈希（XXH64算法），用于输入去重标识与模型版本
+// 非加密哈希，只用于区分内容，不能防篡改
+uint64_t content_hash64(const void *data, size_t len, uint64_t seed = 0);
+
+// 校验哈希的种子：同一内容以不同种子再算一次，两个哈希同时相同才认为内容相同
+static const uint64_t kContentCheckSeed = 0x9E3779B97F4A7C15ULL;
+
+// 分段输入的 content_hash64：依次 update 后 digest() 与整段一次计算的结果相同
+class ContentHasher {
+public:
+    explicit ContentHasher(uint64_t seed = 0);
+    void update(const void *data, size_t len);
+    uint64_t digest() const;
+
+private:
+    uint64_t seed_;
+    uint64_t v_[4];
+    uint64_t total_;
+    unsigned char buf_[32];  // 不足32字节的部分
+    size_t buffered_;
+};
+
+// 整个文件的内容哈希，读取失败返回0
+uint64_t file_hash64(const char *path);
+
+#endif // _CONTENT_HASH_H
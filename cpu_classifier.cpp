@@ -0,0 +1,74 @@
+#include "cpu_classifier.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+
+static double steady_us() {
+    return std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CpuClassifier::CpuClassifier() : warmup_us_(0) {}
+
+bool CpuClassifier::load(const Options &opt, std::string *error) {
+    for (int i = 0; i < std::max(1, opt.slots); i++) {
+        std::unique_ptr<InferenceBackend> backend(new OnnxBackend(opt.onnx));
+        if (!backend->load(opt.model_path, error)) {
+            all_.clear();
+            idle_.clear();
+            return false;
+        }
+        idle_.push_back(backend.get());
+        all_.push_back(std::move(backend));
+    }
+
+    // 首次推理包含内存分配等一次性开销，预热后再计时作为初始估计
+    std::vector<uint8_t> zero((size_t)opt.onnx.width * opt.onnx.height * 3, 0);
+    float out[3];
+    if (!forward(all_[0].get(), zero.data(), zero.size(), out, 3)) {
+        *error = "预热推理失败";
+        all_.clear();
+        idle_.clear();
+        return false;
+    }
+    double t0 = steady_us();
+    forward(all_[0].get(), zero.data(), zero.size(), out, 3);
+    warmup_us_ = steady_us() - t0;
+    return true;
+}
+
+bool CpuClassifier::forward(InferenceBackend *backend, const uint8_t *data, size_t bytes,
+                            float *out, int n) {
+    const float *output;
+    size_t count;
+    if (!backend->set_input(data, bytes) || !backend->run() ||
+        !backend->get_outputs(&output, &count)) {
+        return false;
+    }
+    bool ok = (int)count >= n;
+    if (ok) {
+        std::copy(output, output + n, out);
+    } else {
+        fprintf(stderr, "CPU模型输出个数 %zu 少于 %d\n", count, n);
+    }
+    backend->release_outputs();
+    return ok;
+}
+
+bool CpuClassifier::classify(const cv::Mat &img, float *out, int n) {
+    InferenceBackend *backend;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_cv_.wait(lock, [this]() { return !idle_.empty(); });
+        backend = idle_.back();
+        idle_.pop_back();
+    }
+    bool ok = forward(backend, img.data, img.total() * img.elemSize(), out, n);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_.push_back(backend);
+    }
+    idle_cv_.notify_one();
+    return ok;
+}
@@ -0,0 +1,46 @@
+#ifndef _CPU_CLASSIFIER_H
+#define _CPU_CLASSIFIER_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+#include "onnx_backend.h"
+
+// NPU排队过长时使用的CPU后端：slots 个 OnnxBackend 实例，
+// 每个实例同一时间只供一个请求使用。
+class CpuClassifier {
+public:
+    struct Options {
+        std::string model_path;
+        int slots;                  // 最多同时推理的请求数
+        OnnxBackend::Options onnx;  // 输入尺寸与归一化
+    };
+
+    CpuClassifier();
+
+    // 加载模型并用全零图像预热一次，失败时返回 false 并给出原因
+    bool load(const Options &opt, std::string *error);
+    bool loaded() const { return !all_.empty(); }
+    int slots() const { return (int)all_.size(); }
+    double warmup_us() const { return warmup_us_; }
+
+    // 对已缩放到模型尺寸的BGR图像推理，输出前 n 个原始得分
+    bool classify(const cv::Mat &img, float *out, int n);
+
+private:
+    static bool forward(InferenceBackend *backend, const uint8_t *data, size_t bytes,
+                        float *out, int n);
+
+    double warmup_us_;
+
+    std::mutex mutex_;
+    std::condition_variable idle_cv_;
+    std::vector<std::unique_ptr<InferenceBackend> > all_;
+    std::vector<InferenceBackend *> idle_;
+};
+
+#endif // _CPU_CLASSIFIER_H
@@ -0,0 +1,90 @@
+#include "decode_budget.h"
+
+#include <time.h>
+#include <chrono>
+
+static double now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+DecodeBudget::DecodeBudget()
+    : budget_(0), wait_ms_(0), in_use_(0), peak_(0), active_(0),
+      acquired_(0), waited_(0), shed_(0), rejected_(0), unknown_(0) {}
+
+void DecodeBudget::configure(size_t budget, int wait_ms) {
+    budget_ = budget;
+    wait_ms_ = wait_ms;
+}
+
+bool DecodeBudget::acquire(size_t bytes) {
+    if (!enabled()) return true;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (in_use_ + bytes > budget_) {
+        // 没有其他解码时必定放得下（fits() 已检查），不会无限等待
+        waited_++;
+        double t0 = now_us();
+        bool ok = cond_.wait_for(lock, std::chrono::milliseconds(wait_ms_),
+                                 [&]() { return in_use_ + bytes <= budget_; });
+        wait_.record(now_us() - t0);
+        if (!ok) {
+            shed_++;
+            return false;
+        }
+    }
+    in_use_ += bytes;
+    active_++;
+    if (in_use_ > peak_) peak_ = in_use_;
+    acquired_++;
+    return true;
+}
+
+void DecodeBudget::release(size_t bytes) {
+    if (!enabled()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        in_use_ -= bytes;
+        active_--;
+    }
+    cond_.notify_all();
+}
+
+void DecodeBudget::write_metrics(JsonWriter &w, const char *name) const {
+    size_t in_use, peak;
+    int active;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        in_use = in_use_;
+        peak = peak_;
+        active = active_;
+    }
+    w.begin_object(name);
+    w.field("enabled", enabled());
+    w.field("budget_bytes", (uint64_t)budget_);
+    w.field("wait_ms", (uint64_t)wait_ms_);
+    w.field("in_use_bytes", (uint64_t)in_use);
+    w.field("peak_bytes", (uint64_t)peak);
+    w.field("active", (uint64_t)active);
+    w.field("acquired", acquired_.load());
+    w.field("waited", waited_.load());
+    w.field("shed", shed_.load());
+    w.field("rejected", rejected_.load());
+    w.field("unknown_size", unknown_.load());
+    w.latency("wait", wait_);
+    w.end_object();
+}
+
+bool DecodeReservation::acquire(DecodeBudget &budget, size_t bytes) {
+    release();
+    if (!budget.acquire(bytes)) return false;
+    budget_ = &budget;
+    bytes_ = bytes;
+    return true;
+}
+
+void DecodeReservation::release() {
+    if (budget_) budget_->release(bytes_);
+    budget_ = nullptr;
+    bytes_ = 0;
+}
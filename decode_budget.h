@@ -0,0 +1,72 @@
+#ifndef _DECODE_BUDGET_H
+#define _DECODE_BUDGET_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "metrics.h"
+
+// 图像解码内存预算：所有并发解码按文件头预估的内存之和不超过 budget
+// 预算不足时等待其他解码完成，超过 wait_ms 仍不足则放弃（由调用方返回503）
+// 只约束解码到缩放完成这一段，缩放后解码图像即释放
+// 流式接收的请求体缓冲用另一个实例单独计预算（wait_ms 为0，不足时立即放弃）
+class DecodeBudget {
+public:
+    DecodeBudget();
+
+    // budget 为0时关闭，acquire() 总是立即成功
+    void configure(size_t budget, int wait_ms);
+    bool enabled() const { return budget_ > 0; }
+    size_t budget() const { return budget_; }
+
+    // 单张图像的预估超过整个预算，等待也不会成功
+    bool fits(size_t bytes) const { return !enabled() || bytes <= budget_; }
+
+    bool acquire(size_t bytes);
+    void release(size_t bytes);
+
+    // 由调用方记录，只用于统计
+    void note_rejected() { rejected_++; }
+    void note_unknown() { unknown_++; }
+
+    void write_metrics(JsonWriter &w, const char *name = "decode_budget") const;
+
+private:
+    size_t budget_;
+    int wait_ms_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    size_t in_use_;
+    size_t peak_;
+    int active_;
+
+    std::atomic<uint64_t> acquired_;
+    std::atomic<uint64_t> waited_;    // 需要等待的次数
+    std::atomic<uint64_t> shed_;      // 等待超时放弃的次数
+    std::atomic<uint64_t> rejected_;  // 超过像素限制或整个预算而返回413
+    std::atomic<uint64_t> unknown_;   // 文件头读不出尺寸、未计入预算的解码
+    LatencyStat wait_;
+};
+
+// 持有一次解码的预算，析构或 release() 时归还
+class DecodeReservation {
+public:
+    DecodeReservation() : budget_(nullptr), bytes_(0) {}
+    ~DecodeReservation() { release(); }
+
+    bool acquire(DecodeBudget &budget, size_t bytes);
+    void release();
+
+private:
+    DecodeReservation(const DecodeReservation &);
+    DecodeReservation &operator=(const DecodeReservation &);
+
+    DecodeBudget *budget_;
+    size_t bytes_;
+};
+
+#endif // _DECODE_BUDGET_H
@@ -0,0 +1,501 @@
+// 优化路径与参考路径的结果一致性检查
+// 用法: golden [选项] [服务器参数...] 图片或目录...
+//   --manifest=FILE     CSV清单，每行为 图片路径,34个特征值（路径相对清单所在目录）；
+//                       直接给出的图片使用README中的示例特征
+//   --threads=N         优化路径的并发请求数 (默认 4)，批大小>1的模型可借此组批
+//   --tol=X             概率与RKNN分数的允许误差 (默认 0.001)
+//   --tol-cpu=X         由CPU后端溢出推理的样本的允许误差 (默认 0.05)
+//   --record=FILE       把参考路径的结果写成基准文件
+//   --golden=FILE       另与之前记录的基准文件比较（模型或依赖库升级后核对）
+//   --verbose           保留服务器的逐请求日志
+// 其余 -- 参数按服务器的启动参数解析，如 --backend=onnx --cpu-model=FILE --svm-native=0。
+//
+// 参考路径按逐步优化之前的做法依次执行：原始的Base64解码、cv::imdecode + cv::resize、
+// 后端单张推理、float softmax、cv::dnn 特征模型、weighted_fusion。
+// 优化路径直接调用服务器的 process_classify（原生特征模型、CPU工作线程、NPU微批处理、
+// CPU溢出推理、近似重复等按参数生效）。
+// 两者类别一致且分数在允许误差内为通过，存在不一致时退出码为3。
+// 主机构建（HOST_BUILD=ON）下用 --backend=onnx --cpu-model=FILE 在CPU上运行。
+
+#define ATK_NO_MAIN
+#include "atk_mobilenet_object_classification.cpp"
+
+#include <fcntl.h>
+#include <algorithm>
+
+#include "manifest.h"
+
+struct Sample {
+    std::string name;
+    std::vector<unsigned char> jpeg;
+    std::vector<float> features;
+    std::string body;  // /api/classify 请求体
+};
+
+struct Outcome {
+    bool ok;
+    int class_id;
+    float probability;
+    float svm_score;
+    float rknn_score;
+    int backend;
+    bool near_duplicate;
+};
+
+struct GoldenOptions {
+    std::string manifest;
+    int threads = 4;
+    float tol = 0.001f;
+    float tol_cpu = 0.05f;
+    std::string record;
+    std::string golden;
+    bool verbose = false;
+};
+
+static GoldenOptions s_opt;
+
+// ---- 参考实现：保留优化前的写法，不随服务器代码变化 ----
+
+static const char kBase64Chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static std::vector<unsigned char> reference_base64_decode(const std::string &in) {
+    std::vector<unsigned char> out;
+    unsigned char quad[4];
+    int n = 0;
+    for (size_t i = 0; i < in.size() && in[i] != '='; i++) {
+        const char *p = strchr(kBase64Chars, in[i]);
+        if (!p || !*p) continue;  // 跳过无效字符
+        quad[n++] = (unsigned char)(p - kBase64Chars);
+        if (n == 4) {
+            out.push_back((quad[0] << 2) + ((quad[1] & 0x30) >> 4));
+            out.push_back(((quad[1] & 0xf) << 4) + ((quad[2] & 0x3c) >> 2));
+            out.push_back(((quad[2] & 0x3) << 6) + quad[3]);
+            n = 0;
+        }
+    }
+    if (n > 1) {
+        for (int k = n; k < 4; k++) quad[k] = 0;
+        unsigned char tail[3] = {
+            (unsigned char)((quad[0] << 2) + ((quad[1] & 0x30) >> 4)),
+            (unsigned char)(((quad[1] & 0xf) << 4) + ((quad[2] & 0x3c) >> 2)),
+            (unsigned char)(((quad[2] & 0x3) << 6) + quad[3])};
+        out.insert(out.end(), tail, tail + n - 1);
+    }
+    return out;
+}
+
+static std::string base64_encode(const std::vector<unsigned char> &in) {
+    std::string out;
+    size_t i = 0;
+    for (; i + 2 < in.size(); i += 3) {
+        uint32_t v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+        out += kBase64Chars[(v >> 18) & 63];
+        out += kBase64Chars[(v >> 12) & 63];
+        out += kBase64Chars[(v >> 6) & 63];
+        out += kBase64Chars[v & 63];
+    }
+    if (i < in.size()) {
+        uint32_t v = in[i] << 16;
+        if (i + 1 < in.size()) v |= in[i + 1] << 8;
+        out += kBase64Chars[(v >> 18) & 63];
+        out += kBase64Chars[(v >> 12) & 63];
+        out += i + 1 < in.size() ? kBase64Chars[(v >> 6) & 63] : '=';
+        out += '=';
+    }
+    return out;
+}
+
+// 与服务器原先的 softmax + 取最大值相同
+static int reference_argmax_softmax(float *p, int n) {
+    float max_val = p[0];
+    for (int i = 1; i < n; i++) max_val = std::max(max_val, p[i]);
+    float sum = 0.0f;
+    for (int i = 0; i < n; i++) {
+        p[i] = exp(p[i] - max_val);
+        sum += p[i];
+    }
+    int best = 0;
+    for (int i = 0; i < n; i++) {
+        p[i] /= sum;
+        if (p[i] > p[best]) best = i;
+    }
+    return best;
+}
+
+static bool reference_classify(const Sample &s, SVMModel *ref_svm, Outcome *out) {
+    *out = Outcome();
+    std::vector<unsigned char> bytes = reference_base64_decode(base64_encode(s.jpeg));
+    cv::Mat img = cv::imdecode(cv::Mat(1, (int)bytes.size(), CV_8U, bytes.data()),
+                               cv::IMREAD_COLOR);
+    if (img.empty()) {
+        return false;
+    }
+    cv::Mat resized;
+    cv::resize(img, resized, cv::Size(s_model_width, s_model_height));
+
+    // 单张推理：批大小>1的模型只填第一个位置，其余补零
+    size_t item_bytes = (size_t)s_model_width * s_model_height * 3;
+    std::vector<uint8_t> input(item_bytes * s_model_batch, 0);
+    memcpy(input.data(), resized.data, item_bytes);
+    float scores[3];
+    {
+        std::lock_guard<std::mutex> lock(s_npu_mutex);
+        const float *output;
+        size_t count;
+        if (!s_backend->set_input(input.data(), input.size()) || !s_backend->run() ||
+            !s_backend->get_outputs(&output, &count)) {
+            return false;
+        }
+        bool enough = count / s_model_batch >= 3;
+        if (enough) memcpy(scores, output, sizeof(scores));
+        s_backend->release_outputs();
+        if (!enough) return false;
+    }
+    int rknn_class = reference_argmax_softmax(scores, 3);
+
+    float logits[3], probs[3];
+    int svm_class = ref_svm->predict_class(s.features.data(), s.features.size(), logits, probs);
+    if (svm_class < 0) {
+        return false;
+    }
+    FusionResult res = weighted_fusion((float)svm_class, scores[rknn_class]);
+    out->ok = true;
+    out->class_id = res.class_id;
+    out->probability = res.probability;
+    out->svm_score = res.svm_score;
+    out->rknn_score = res.rknn_score;
+    out->backend = kBackendNpu;
+    return true;
+}
+
+// ---- 优化路径：服务器的请求处理流程 ----
+
+static bool json_number(const std::string &body, const char *key, float *value) {
+    size_t pos = body.find(key);
+    if (pos == std::string::npos) return false;
+    *value = (float)atof(body.c_str() + pos + strlen(key));
+    return true;
+}
+
+static bool optimized_classify(const Sample &s, Outcome *out) {
+    *out = Outcome();
+    std::shared_ptr<ClassifyJob> job(new ClassifyJob());
+    job->conn_id = 0;
+    job->body = s.body;
+    clock_gettime(CLOCK_MONOTONIC, &job->start);
+    job->received_us = now_us();
+    job->degraded = false;
+    job->admitted = false;
+    job->request_id = ++s_next_request_id;
+    job->input_hash = 0;
+    job->capture = false;
+    job->arrival_unix_us = 0;
+
+    ClassifyReply reply;
+    if (!process_classify(*job, &reply) || reply.status != 200) {
+        return false;
+    }
+    float class_id = 0;
+    if (!json_number(reply.body, "\"class\":", &class_id) ||
+        !json_number(reply.body, "\"probability\":", &out->probability) ||
+        !json_number(reply.body, "\"blood_score\":", &out->svm_score) ||
+        !json_number(reply.body, "\"rknn_score\":", &out->rknn_score)) {
+        return false;
+    }
+    out->ok = true;
+    out->class_id = (int)class_id;
+    out->backend = reply.body.find("\"backend\":\"cpu\"") != std::string::npos ? kBackendCpu
+                                                                              : kBackendNpu;
+    out->near_duplicate = reply.body.find("\"near_duplicate\":true") != std::string::npos;
+    return true;
+}
+
+// ---- 语料 ----
+
+static bool read_file(const std::string &path, std::vector<unsigned char> *out) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in) return false;
+    out->assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !out->empty();
+}
+
+static bool add_sample(std::vector<Sample> *corpus, const ManifestEntry &entry) {
+    Sample s;
+    s.name = entry.path;
+    s.features = entry.features;
+    if (s.features.empty()) {
+        s.features.assign(kProbeFeatures, kProbeFeatures + 34);
+    }
+    if (!read_file(entry.path, &s.jpeg)) {
+        fprintf(stderr, "无法读取 %s\n", entry.path.c_str());
+        return false;
+    }
+    s.body = "{\"image\":\"" + base64_encode(s.jpeg) + "\",\"features\":[";
+    char num[32];
+    for (size_t i = 0; i < s.features.size(); i++) {
+        snprintf(num, sizeof(num), i ? ",%.9g" : "%.9g", s.features[i]);  // float可原样还原
+        s.body += num;
+    }
+    s.body += "]}";
+    corpus->push_back(s);
+    return true;
+}
+
+// ---- 基准文件 ----
+
+static void write_golden(const std::string &path, const std::vector<Sample> &corpus,
+                         const std::vector<Outcome> &outcomes) {
+    FILE *fp = fopen(path.c_str(), "w");
+    if (!fp) {
+        fprintf(stderr, "无法写入 %s\n", path.c_str());
+        return;
+    }
+    fprintf(fp, "name,class,probability,blood_score,rknn_score\n");
+    for (size_t i = 0; i < corpus.size(); i++) {
+        const Outcome &o = outcomes[i];
+        if (!o.ok) continue;
+        fprintf(fp, "%s,%d,%.6f,%.6f,%.6f\n", corpus[i].name.c_str(), o.class_id,
+                o.probability, o.svm_score, o.rknn_score);
+    }
+    fclose(fp);
+}
+
+static bool read_golden(const std::string &path, std::map<std::string, Outcome> *golden) {
+    std::ifstream in(path.c_str());
+    if (!in) {
+        fprintf(stderr, "无法读取基准文件 %s\n", path.c_str());
+        return false;
+    }
+    std::string line;
+    std::getline(in, line);  // 表头
+    while (std::getline(in, line)) {
+        // 名称中可能有逗号，数值取最后四列
+        size_t cut = line.size();
+        for (int k = 0; k < 4 && cut != std::string::npos; k++) {
+            cut = line.rfind(',', cut - 1);
+        }
+        if (cut == std::string::npos) continue;
+        Outcome o = Outcome();
+        o.ok = sscanf(line.c_str() + cut + 1, "%d,%f,%f,%f", &o.class_id, &o.probability,
+                      &o.svm_score, &o.rknn_score) == 4;
+        if (o.ok) (*golden)[line.substr(0, cut)] = o;
+    }
+    return true;
+}
+
+// ---- 比较 ----
+
+// 返回不一致的描述，一致时为空
+static std::string compare(const Outcome &expect, const Outcome &got, float tol) {
+    if (!expect.ok || !got.ok) {
+        return !expect.ok && !got.ok ? "" : !got.ok ? "推理失败" : "参考推理失败";
+    }
+    char buf[160];
+    if (expect.class_id != got.class_id) {
+        snprintf(buf, sizeof(buf), "类别 %d -> %d", expect.class_id, got.class_id);
+        return buf;
+    }
+    if (expect.svm_score != got.svm_score) {
+        snprintf(buf, sizeof(buf), "特征模型类别 %.0f -> %.0f", expect.svm_score, got.svm_score);
+        return buf;
+    }
+    if (fabsf(expect.probability - got.probability) > tol ||
+        fabsf(expect.rknn_score - got.rknn_score) > tol) {
+        snprintf(buf, sizeof(buf), "概率 %.4f -> %.4f, RKNN分数 %.4f -> %.4f",
+                 expect.probability, got.probability, expect.rknn_score, got.rknn_score);
+        return buf;
+    }
+    return "";
+}
+
+// 服务器的逐请求日志输出到 stdout，运行期间重定向到 /dev/null
+struct QuietStdout {
+    int saved;
+    explicit QuietStdout(bool quiet) : saved(-1) {
+        if (!quiet) return;
+        fflush(stdout);
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd < 0) return;
+        saved = dup(STDOUT_FILENO);
+        dup2(null_fd, STDOUT_FILENO);
+        close(null_fd);
+    }
+    ~QuietStdout() {
+        if (saved < 0) return;
+        fflush(stdout);
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+};
+
+static void print_golden_usage(const char *prog) {
+    printf("用法: %s [选项] [服务器参数...] 图片或目录...\n", prog);
+    printf("  --manifest=FILE   CSV清单: 图片路径,34个特征值\n");
+    printf("  --threads=N       优化路径的并发请求数 (默认 4)\n");
+    printf("  --tol=X           概率允许误差 (默认 0.001)\n");
+    printf("  --tol-cpu=X       CPU溢出推理样本的概率允许误差 (默认 0.05)\n");
+    printf("  --record=FILE     把参考路径结果写成基准文件\n");
+    printf("  --golden=FILE     与基准文件比较\n");
+    printf("  --verbose         保留服务器日志\n");
+}
+
+int main(int argc, char *argv[]) {
+    // 本工具的参数与服务器参数分开，后者交给服务器的 parse_args
+    std::vector<char *> server_args(1, argv[0]);
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--manifest=", 11) == 0) {
+            s_opt.manifest = arg + 11;
+        } else if (strncmp(arg, "--threads=", 10) == 0) {
+            s_opt.threads = std::max(1, atoi(arg + 10));
+        } else if (strncmp(arg, "--tol=", 6) == 0) {
+            s_opt.tol = (float)atof(arg + 6);
+        } else if (strncmp(arg, "--tol-cpu=", 10) == 0) {
+            s_opt.tol_cpu = (float)atof(arg + 10);
+        } else if (strncmp(arg, "--record=", 9) == 0) {
+            s_opt.record = arg + 9;
+        } else if (strncmp(arg, "--golden=", 9) == 0) {
+            s_opt.golden = arg + 9;
+        } else if (strcmp(arg, "--verbose") == 0) {
+            s_opt.verbose = true;
+        } else if (strcmp(arg, "--help") == 0) {
+            print_golden_usage(argv[0]);
+            return 0;
+        } else if (strncmp(arg, "--", 2) == 0) {
+            server_args.push_back(argv[i]);
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    // 结果缓存与相同输入合并会跳过计算，不参与比较
+    g_config.cache_mb = 0;
+    g_config.coalesce = false;
+    if (!parse_args((int)server_args.size(), server_args.data(), &g_config)) {
+        print_golden_usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<ManifestEntry> entries;
+    std::string error;
+    if (!s_opt.manifest.empty() && !load_manifest(s_opt.manifest, &entries, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!add_image_path(paths[i], &entries, &error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+    std::vector<Sample> corpus;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (!add_sample(&corpus, entries[i])) return 1;
+    }
+    if (corpus.empty()) {
+        print_golden_usage(argv[0]);
+        return 1;
+    }
+
+    SVMModel *ref_svm;
+    {
+        QuietStdout quiet(!s_opt.verbose);
+        init_models();
+        init_cpu_workers();
+        npu_init();
+        bool native = g_config.svm_native;
+        g_config.svm_native = false;  // 参考路径的特征模型固定使用cv::dnn
+        ref_svm = new SVMModel("nn_model.onnx");
+        g_config.svm_native = native;
+    }
+    printf("语料: %zu 个样本, 图像后端: %s, 特征模型: %s, 输入 %dx%d 批大小 %d\n",
+           corpus.size(), s_backend->name(), svm_model->using_native() ? "native" : "dnn",
+           s_model_width, s_model_height, s_model_batch);
+
+    // 参考路径：逐个顺序执行
+    std::vector<Outcome> reference(corpus.size()), optimized(corpus.size());
+    double ref_us, opt_us;
+    {
+        QuietStdout quiet(!s_opt.verbose);
+        double t0 = now_us();
+        for (size_t i = 0; i < corpus.size(); i++) {
+            reference_classify(corpus[i], ref_svm, &reference[i]);
+        }
+        ref_us = now_us() - t0;
+
+        // 优化路径：threads 个线程并发提交
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> threads;
+        t0 = now_us();
+        for (int t = 0; t < s_opt.threads; t++) {
+            threads.push_back(std::thread([&]() {
+                for (size_t i; (i = next++) < corpus.size();) {
+                    optimized_classify(corpus[i], &optimized[i]);
+                }
+            }));
+        }
+        for (size_t t = 0; t < threads.size(); t++) threads[t].join();
+        opt_us = now_us() - t0;
+    }
+
+    std::map<std::string, Outcome> golden;
+    if (!s_opt.golden.empty() && !read_golden(s_opt.golden, &golden)) {
+        return 1;
+    }
+
+    int mismatches = 0, near_dup = 0, cpu = 0, failed = 0;
+    for (size_t i = 0; i < corpus.size(); i++) {
+        const Outcome &r = reference[i], &o = optimized[i];
+        if (!r.ok || !o.ok) failed++;
+        if (o.backend == kBackendCpu) cpu++;
+        std::string diff = compare(r, o, o.backend == kBackendCpu ? s_opt.tol_cpu : s_opt.tol);
+        if (o.near_duplicate) {
+            // 近似重复复用的是相似图像的结果，不一致属预期，只计数
+            near_dup++;
+            if (!diff.empty()) {
+                printf("ℹ️ %s: 近似重复 %s\n", corpus[i].name.c_str(), diff.c_str());
+            }
+            diff.clear();
+        }
+        if (!diff.empty()) {
+            mismatches++;
+            printf("❌ %s: %s%s\n", corpus[i].name.c_str(), diff.c_str(),
+                   o.backend == kBackendCpu ? " (CPU后端)" : "");
+        }
+        if (!s_opt.golden.empty()) {
+            std::map<std::string, Outcome>::const_iterator it = golden.find(corpus[i].name);
+            if (it == golden.end()) {
+                printf("ℹ️ %s: 基准文件中没有该样本\n", corpus[i].name.c_str());
+                continue;
+            }
+            // 基准文件的数值保留6位小数
+            std::string gdiff = compare(it->second, r, std::max(s_opt.tol, 1e-5f));
+            if (!gdiff.empty()) {
+                mismatches++;
+                printf("❌ %s: 与基准文件不一致 %s\n", corpus[i].name.c_str(), gdiff.c_str());
+            }
+        }
+    }
+
+    double n = (double)corpus.size();
+    printf("\n%-16s %12s %14s\n", "路径", "总耗时(ms)", "吞吐(张/秒)");
+    printf("%-16s %12.1f %14.1f\n", "参考(顺序)", ref_us / 1000, n * 1e6 / ref_us);
+    printf("%-16s %12.1f %14.1f\n", "优化", opt_us / 1000, n * 1e6 / opt_us);
+    printf("优化路径: %d 线程, 加速 %.2fx", s_opt.threads, ref_us / opt_us);
+    if (cpu) printf(", CPU溢出 %d 个", cpu);
+    if (near_dup) printf(", 近似重复 %d 个", near_dup);
+    printf("\n");
+    if (failed) printf("⚠️ 推理失败 %d 个\n", failed);
+
+    if (!s_opt.record.empty()) {
+        write_golden(s_opt.record, corpus, reference);
+        printf("参考结果已写入 %s\n", s_opt.record.c_str());
+    }
+    if (mismatches) {
+        printf("❌ %d 处不一致\n", mismatches);
+        return 3;
+    }
+    printf("✅ %zu 个样本结果一致\n", corpus.size());
+    return 0;
+}
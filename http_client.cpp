@@ -0,0 +1,132 @@
+#include "http_client.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <algorithm>
+
+bool http_parse_url(const std::string &url, HttpTarget *target) {
+    const char *prefix = "http://";
+    if (url.compare(0, strlen(prefix), prefix) != 0) return false;
+    std::string rest = url.substr(strlen(prefix));
+    size_t slash = rest.find('/');
+    std::string hostport = rest.substr(0, slash);
+    target->path = slash == std::string::npos ? "/" : rest.substr(slash);
+    size_t colon = hostport.find(':');
+    target->host = hostport.substr(0, colon);
+    target->port = colon == std::string::npos ? "80" : hostport.substr(colon + 1);
+    return !target->host.empty();
+}
+
+struct addrinfo *http_resolve(const HttpTarget &target) {
+    struct addrinfo hints, *addr = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(target.host.c_str(), target.port.c_str(), &hints, &addr) != 0) {
+        return NULL;
+    }
+    return addr;
+}
+
+int http_post(const HttpTarget &target, const struct addrinfo *addr, const std::string &body,
+              int timeout_ms, std::string *response_body) {
+    int fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+    if (fd < 0) return kErrConnect;
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, addr->ai_addr, addr->ai_addrlen) < 0) {
+        close(fd);
+        return kErrConnect;
+    }
+
+    char header[256];
+    int n = snprintf(header, sizeof(header),
+                     "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\n"
+                     "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+                     target.path.c_str(), target.host.c_str(), body.size());
+    std::string request(header, n);
+    request += body;
+    size_t sent = 0;
+    while (sent < request.size()) {
+        ssize_t w = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (w <= 0) {
+            int err = errno;
+            close(fd);
+            return err == EAGAIN || err == EWOULDBLOCK ? kErrTimeout : kErrSend;
+        }
+        sent += w;
+    }
+
+    // 读到 Content-Length 指定的长度或连接关闭为止
+    std::string response;
+    char buf[4096];
+    size_t header_end = std::string::npos;
+    size_t content_length = std::string::npos;
+    for (;;) {
+        ssize_t r = recv(fd, buf, sizeof(buf), 0);
+        if (r < 0) {
+            int err = errno;
+            close(fd);
+            return err == EAGAIN || err == EWOULDBLOCK ? kErrTimeout : kErrRecv;
+        }
+        if (r == 0) break;
+        response.append(buf, r);
+        if (header_end == std::string::npos) {
+            header_end = response.find("\r\n\r\n");
+            if (header_end != std::string::npos) {
+                std::string head = response.substr(0, header_end);
+                std::transform(head.begin(), head.end(), head.begin(), ::tolower);
+                size_t cl = head.find("content-length:");
+                if (cl != std::string::npos) {
+                    content_length = strtoul(head.c_str() + cl + 15, NULL, 10);
+                }
+            }
+        }
+        if (header_end != std::string::npos && content_length != std::string::npos &&
+            response.size() >= header_end + 4 + content_length) {
+            break;
+        }
+    }
+    close(fd);
+
+    int status = 0;
+    if (sscanf(response.c_str(), "HTTP/%*d.%*d %d", &status) != 1) {
+        return kErrBadResponse;
+    }
+    if (response_body) {
+        if (header_end == std::string::npos) {
+            response_body->clear();
+        } else {
+            size_t len = response.size() - header_end - 4;
+            if (content_length != std::string::npos) len = std::min(len, content_length);
+            response_body->assign(response, header_end + 4, len);
+        }
+    }
+    return status;
+}
+
+const char *http_status_name(int status, char *buf, size_t len) {
+    switch (status) {
+    case kErrConnect: return "connect_error";
+    case kErrSend: return "send_error";
+    case kErrRecv: return "recv_error";
+    case kErrTimeout: return "timeout";
+    case kErrBadResponse: return "bad_response";
+    default:
+        snprintf(buf, len, "%d", status);
+        return buf;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef _HTTP_CLIENT_H
+#define _HTTP_CLIENT_H
+
+#include <stddef.h>
+#include <netdb.h>
+#include <string>
+
+// loadgen / replay 共用的最小HTTP客户端：每个请求一个短连接，POST JSON
+
+// 状态码为负数表示未收到HTTP响应
+enum {
+    kErrConnect = -1,
+    kErrSend = -2,
+    kErrRecv = -3,
+    kErrTimeout = -4,
+    kErrBadResponse = -5
+};
+
+struct HttpTarget {
+    std::string host = "127.0.0.1";
+    std::string port = "8080";
+    std::string path = "/api/classify";
+};
+
+// 解析 http://host[:port]/path
+bool http_parse_url(const std::string &url, HttpTarget *target);
+
+// 解析目标地址，失败返回NULL；用 freeaddrinfo 释放
+struct addrinfo *http_resolve(const HttpTarget &target);
+
+// 发送一个请求并读取完整响应，返回HTTP状态码或负数错误码；
+// response_body 非空时返回响应体
+int http_post(const HttpTarget &target, const struct addrinfo *addr, const std::string &body,
+              int timeout_ms, std::string *response_body = NULL);
+
+// 状态码或错误码的可读名称
+const char *http_status_name(int status, char *buf, size_t len);
+
+#endif
@@ -0,0 +1,103 @@
+#include "image_codec.h"
+
+#include <stdlib.h>
+
+// stb_image 只编译用到的格式，不需要文件IO与浮点/HDR接口
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_NO_STDIO
+#define STBI_NO_LINEAR
+#define STBI_NO_HDR
+#define STBI_ONLY_JPEG
+#define STBI_ONLY_PNG
+#define STBI_ONLY_BMP
+#define STBI_ONLY_GIF
+#define STBI_ONLY_PNM
+#include "3rdparty/stb/stb_image.h"
+
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include "3rdparty/stb/stb_image_resize.h"
+
+// cv::imdecode + IMREAD_COLOR
+class OpenCvDecoder : public ImageDecoder {
+public:
+    const char *name() const { return "opencv"; }
+
+    bool decode(const void *data, size_t len, cv::Mat &out) const {
+        cv::imdecode(cv::Mat(1, (int)len, CV_8U, (void *)data), cv::IMREAD_COLOR, &out);
+        return !out.empty();
+    }
+
+    size_t decode_bytes(const ImageInfo &info) const {
+        return image_decode_bytes(info);
+    }
+};
+
+// stb_image 解码为RGB，再交换R/B通道写入 out（一次拷贝，输出缓冲仍取自缓冲池）
+// stb_image 不支持的格式（WebP、TIFF、JPEG 2000）交给 OpenCV
+class StbDecoder : public ImageDecoder {
+public:
+    const char *name() const { return "stb"; }
+
+    bool decode(const void *data, size_t len, cv::Mat &out) const {
+        ImageFormat format = sniff_image_format((const unsigned char *)data, len);
+        if (format == kImageWebp || format == kImageTiff || format == kImageJp2) {
+            return fallback_.decode(data, len, out);
+        }
+        int width, height, channels;
+        unsigned char *rgb = stbi_load_from_memory((const stbi_uc *)data, (int)len,
+                                                   &width, &height, &channels, 3);
+        if (!rgb) return false;
+        cv::cvtColor(cv::Mat(height, width, CV_8UC3, rgb), out, cv::COLOR_RGB2BGR);
+        stbi_image_free(rgb);
+        return !out.empty();
+    }
+
+    // 输出之外还有 stb 自己的RGB缓冲，以及各分量的中间平面（JPEG）或解压后的扫描行（PNG）
+    size_t decode_bytes(const ImageInfo &info) const {
+        size_t pixels = (size_t)info.width * info.height;
+        return image_decode_bytes(info) + pixels * 3 + pixels * info.components;
+    }
+
+private:
+    OpenCvDecoder fallback_;
+};
+
+// cv::resize，INTER_LINEAR
+class OpenCvResizer : public ImageResizer {
+public:
+    const char *name() const { return "opencv"; }
+
+    void resize(const cv::Mat &src, cv::Mat &dst) const {
+        cv::resize(src, dst, dst.size());
+    }
+};
+
+// stb_image_resize 三角形（双线性）滤波；缩小时按比例放宽滤波核，相当于带抗锯齿的双线性，
+// 与 cv::INTER_LINEAR 的结果不完全相同
+class StbResizer : public ImageResizer {
+public:
+    const char *name() const { return "stb"; }
+
+    void resize(const cv::Mat &src, cv::Mat &dst) const {
+        stbir_resize_uint8_generic(src.data, src.cols, src.rows, (int)src.step,
+                                   dst.data, dst.cols, dst.rows, (int)dst.step, 3,
+                                   STBIR_ALPHA_CHANNEL_NONE, 0, STBIR_EDGE_CLAMP,
+                                   STBIR_FILTER_TRIANGLE, STBIR_COLORSPACE_LINEAR, NULL);
+    }
+};
+
+const ImageDecoder *find_image_decoder(const std::string &name) {
+    static OpenCvDecoder opencv;
+    static StbDecoder stb;
+    if (name == "opencv") return &opencv;
+    if (name == "stb") return &stb;
+    return NULL;
+}
+
+const ImageResizer *find_image_resizer(const std::string &name) {
+    static OpenCvResizer opencv;
+    static StbResizer stb;
+    if (name == "opencv") return &opencv;
+    if (name == "stb") return &stb;
+    return NULL;
+}
@@ -0,0 +1,37 @@
+#ifndef _IMAGE_CODEC_H
+#define _IMAGE_CODEC_H
+
+#include <stddef.h>
+#include <string>
+
+#include "opencv2/opencv.hpp"
+#include "image_header.h"
+
+// 图像解码后端（--decoder）
+// 输出BGR 8位3通道，与 cv::imdecode(IMREAD_COLOR) 一致，模型输入的通道顺序不随后端变化
+// 实现无状态，可在多个线程中同时使用
+class ImageDecoder {
+public:
+    virtual ~ImageDecoder() {}
+    virtual const char *name() const = 0;
+
+    // out 可预先设置 allocator（缓冲池）；失败时返回 false
+    virtual bool decode(const void *data, size_t len, cv::Mat &out) const = 0;
+
+    // 按文件头预估解码过程的峰值内存，用于解码内存预算
+    virtual size_t decode_bytes(const ImageInfo &info) const = 0;
+};
+
+// 缩放后端（--resizer），dst 已按目标尺寸分配为 CV_8UC3
+class ImageResizer {
+public:
+    virtual ~ImageResizer() {}
+    virtual const char *name() const = 0;
+    virtual void resize(const cv::Mat &src, cv::Mat &dst) const = 0;
+};
+
+// 按名称取得后端："opencv" 或 "stb"；名称无效时返回 NULL
+const ImageDecoder *find_image_decoder(const std::string &name);
+const ImageResizer *find_image_resizer(const std::string &name);
+
+#endif // _IMAGE_CODEC_H
@@ -0,0 +1,160 @@
+#include "image_header.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// 前缀匹配；data 不足时只比较已有部分
+static bool has_prefix(const unsigned char *data, size_t len, const char *magic, size_t n,
+                       size_t offset = 0) {
+    if (len <= offset) return true;
+    size_t avail = len - offset < n ? len - offset : n;
+    return memcmp(data + offset, magic, avail) == 0;
+}
+
+ImageFormat sniff_image_format(const unsigned char *data, size_t len) {
+    if (len == 0) return kImageUnknown;
+    if (has_prefix(data, len, "\xFF\xD8\xFF", 3)) return kImageJpeg;
+    if (has_prefix(data, len, "\x89PNG\r\n\x1A\n", 8)) return kImagePng;
+    if (has_prefix(data, len, "BM", 2)) return kImageBmp;
+    if (has_prefix(data, len, "GIF8", 4)) return kImageGif;
+    if (has_prefix(data, len, "II*\0", 4) || has_prefix(data, len, "MM\0*", 4)) return kImageTiff;
+    if (has_prefix(data, len, "RIFF", 4) && has_prefix(data, len, "WEBP", 4, 8)) return kImageWebp;
+    if (data[0] == 'P' && (len < 2 || (data[1] >= '1' && data[1] <= '7'))) return kImagePnm;
+    if (has_prefix(data, len, "\0\0\0\x0CjP  ", 8) || has_prefix(data, len, "\xFF\x4F\xFF\x51", 4)) {
+        return kImageJp2;
+    }
+    return kImageUnknown;
+}
+
+const char *image_format_name(ImageFormat format) {
+    switch (format) {
+    case kImageJpeg: return "jpeg";
+    case kImagePng: return "png";
+    case kImageBmp: return "bmp";
+    case kImageGif: return "gif";
+    case kImageTiff: return "tiff";
+    case kImageWebp: return "webp";
+    case kImagePnm: return "pnm";
+    case kImageJp2: return "jp2";
+    default: return "unknown";
+    }
+}
+
+static uint32_t be16(const unsigned char *p) { return (uint32_t)p[0] << 8 | p[1]; }
+static uint32_t be32(const unsigned char *p) { return be16(p) << 16 | be16(p + 2); }
+static uint32_t le16(const unsigned char *p) { return (uint32_t)p[1] << 8 | p[0]; }
+static uint32_t le24(const unsigned char *p) { return (uint32_t)p[2] << 16 | le16(p); }
+static uint32_t le32(const unsigned char *p) { return le24(p + 1) << 8 | p[0]; }
+
+static ImageHeaderStatus set_info(ImageInfo *info, uint32_t width, uint32_t height,
+                                  int components, bool progressive = false) {
+    if (width == 0 || height == 0 || width > 0x7FFFFFFF || height > 0x7FFFFFFF) {
+        return kHeaderUnsupported;
+    }
+    info->width = (int)width;
+    info->height = (int)height;
+    info->components = components;
+    info->progressive = progressive;
+    return kHeaderParsed;
+}
+
+// 依次跳过各段，直到 SOFn（C0-CF 中除 DHT/JPG/DAC 外）
+static ImageHeaderStatus parse_jpeg(const unsigned char *data, size_t len, ImageInfo *info) {
+    size_t pos = 2;
+    for (;;) {
+        while (pos < len && data[pos] != 0xFF) pos++;  // 段之间不应有其他字节，容忍
+        while (pos < len && data[pos] == 0xFF) pos++;  // 填充字节
+        if (pos >= len) return kHeaderIncomplete;
+        unsigned char marker = data[pos++];
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) continue;  // 无长度字段
+        if (marker == 0xD9 || marker == 0xDA) return kHeaderUnsupported;     // 没有SOF就结束
+        if (pos + 2 > len) return kHeaderIncomplete;
+        size_t seg_len = be16(data + pos);
+        if (seg_len < 2) return kHeaderUnsupported;
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 &&
+            marker != 0xCC) {
+            if (pos + 8 > len) return kHeaderIncomplete;
+            if (seg_len < 8) return kHeaderUnsupported;
+            bool progressive = marker == 0xC2 || marker == 0xC6 || marker == 0xCA ||
+                               marker == 0xCE;
+            return set_info(info, be16(data + pos + 5), be16(data + pos + 3), data[pos + 7],
+                            progressive);
+        }
+        pos += seg_len;
+    }
+}
+
+// 签名后第一个块必须是 IHDR
+static ImageHeaderStatus parse_png(const unsigned char *data, size_t len, ImageInfo *info) {
+    if (len < 26) return kHeaderIncomplete;
+    if (memcmp(data + 12, "IHDR", 4) != 0) return kHeaderUnsupported;
+    static const int kChannels[7] = {1, 0, 3, 3, 2, 0, 4};  // 按颜色类型，调色板展开为RGB
+    unsigned char color_type = data[25];
+    if (color_type > 6 || kChannels[color_type] == 0) return kHeaderUnsupported;
+    return set_info(info, be32(data + 16), be32(data + 20), kChannels[color_type]);
+}
+
+static ImageHeaderStatus parse_bmp(const unsigned char *data, size_t len, ImageInfo *info) {
+    if (len < 30) return kHeaderIncomplete;
+    if (le32(data + 14) == 12) {  // OS/2 BITMAPCOREHEADER
+        return set_info(info, le16(data + 18), le16(data + 20), le16(data + 24) / 8);
+    }
+    int32_t height = (int32_t)le32(data + 22);  // 负数表示自上而下存储
+    int bits = (int)le16(data + 28);
+    return set_info(info, le32(data + 18), height < 0 ? -(int64_t)height : height,
+                    bits >= 24 ? bits / 8 : 3);
+}
+
+// 逻辑屏幕尺寸
+static ImageHeaderStatus parse_gif(const unsigned char *data, size_t len, ImageInfo *info) {
+    if (len < 10) return kHeaderIncomplete;
+    return set_info(info, le16(data + 6), le16(data + 8), 3);
+}
+
+// RIFF 中第一个块：有损 VP8、无损 VP8L 或扩展 VP8X
+static ImageHeaderStatus parse_webp(const unsigned char *data, size_t len, ImageInfo *info) {
+    if (len < 16) return kHeaderIncomplete;
+    if (memcmp(data + 12, "VP8X", 4) == 0) {
+        if (len < 30) return kHeaderIncomplete;
+        return set_info(info, le24(data + 24) + 1, le24(data + 27) + 1,
+                        (data[20] & 0x10) ? 4 : 3);
+    }
+    if (memcmp(data + 12, "VP8L", 4) == 0) {
+        if (len < 25) return kHeaderIncomplete;
+        if (data[20] != 0x2F) return kHeaderUnsupported;
+        uint32_t bits = le32(data + 21);
+        return set_info(info, (bits & 0x3FFF) + 1, ((bits >> 14) & 0x3FFF) + 1,
+                        (bits >> 28) & 1 ? 4 : 3);
+    }
+    if (memcmp(data + 12, "VP8 ", 4) == 0) {
+        if (len < 30) return kHeaderIncomplete;
+        if (data[23] != 0x9D || data[24] != 0x01 || data[25] != 0x2A) return kHeaderUnsupported;
+        return set_info(info, le16(data + 26) & 0x3FFF, le16(data + 28) & 0x3FFF, 3);
+    }
+    return kHeaderUnsupported;
+}
+
+ImageHeaderStatus parse_image_header(const unsigned char *data, size_t len, ImageInfo *info) {
+    if (len < kImageSniffBytes) return kHeaderIncomplete;
+    *info = ImageInfo();
+    info->format = sniff_image_format(data, len);
+    switch (info->format) {
+    case kImageJpeg: return parse_jpeg(data, len, info);
+    case kImagePng: return parse_png(data, len, info);
+    case kImageBmp: return parse_bmp(data, len, info);
+    case kImageGif: return parse_gif(data, len, info);
+    case kImageWebp: return parse_webp(data, len, info);
+    default: return kHeaderUnsupported;
+    }
+}
+
+size_t image_decode_bytes(const ImageInfo &info) {
+    uint64_t pixels = (uint64_t)info.width * info.height;
+    uint64_t bytes = pixels * 3;
+    if (info.progressive) {
+        // 系数按8x8块保存，尺寸向上取整
+        uint64_t blocks = (uint64_t)((info.width + 7) / 8) * ((info.height + 7) / 8);
+        bytes += blocks * 64 * 2 * info.components;
+    }
+    return bytes > SIZE_MAX ? SIZE_MAX : (size_t)bytes;
+}
@@ -0,0 +1,48 @@
+#ifndef _IMAGE_HEADER_H
+#define _IMAGE_HEADER_H
+
+#include <stddef.h>
+
+// 按文件头识别图像格式，不解码像素
+enum ImageFormat {
+    kImageUnknown = 0,
+    kImageJpeg,
+    kImagePng,
+    kImageBmp,
+    kImageGif,
+    kImageTiff,
+    kImageWebp,
+    kImagePnm,
+    kImageJp2
+};
+
+// 识别所需的字节数，数据少于此值时只按已有的字节判断
+static const size_t kImageSniffBytes = 12;
+
+ImageFormat sniff_image_format(const unsigned char *data, size_t len);
+const char *image_format_name(ImageFormat format);
+
+// 解码前从文件头读出的尺寸信息
+struct ImageInfo {
+    ImageFormat format;
+    int width;
+    int height;
+    int components;    // 文件中的通道数（灰度1、RGB 3、带透明通道 2/4）
+    bool progressive;  // 渐进式JPEG，解码时需保存整幅图像的DCT系数
+};
+
+enum ImageHeaderStatus {
+    kHeaderIncomplete = 0,  // 数据不足，尚未读到尺寸（流式接收时继续等待）
+    kHeaderParsed,
+    kHeaderUnsupported      // 格式不支持读取尺寸或文件头无效
+};
+
+// 读取 JPEG/PNG/BMP/GIF/WebP 的尺寸与通道数，不解码像素
+// JPEG 的尺寸在 SOFn 段，前面可能有较大的 EXIF/ICC 段，需要的字节数不固定
+ImageHeaderStatus parse_image_header(const unsigned char *data, size_t len, ImageInfo *info);
+
+// 以 IMREAD_COLOR 解码时预计占用的内存（字节）：3通道8位的输出，
+// 渐进式JPEG另加每个分量每像素2字节的系数缓冲
+size_t image_decode_bytes(const ImageInfo &info);
+
+#endif // _IMAGE_HEADER_H
@@ -0,0 +1,35 @@
+#ifndef _INFERENCE_BACKEND_H
+#define _INFERENCE_BACKEND_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// 图像模型输入张量信息
+struct BackendAttrs {
+    int width;
+    int height;
+    int batch;      // 每次 run 的输入张数，不足时由调用方补零
+    int n_outputs;
+};
+
+// 图像模型推理后端
+// 输入为 batch 张连续存放的 NHWC uint8 图像（解码得到的BGR顺序），
+// 输出取第一个输出张量，按批内顺序每张若干个 float 原始得分。
+// 同一实例同一时间只允许一个线程调用 set_input 到 release_outputs 这一组操作。
+class InferenceBackend {
+public:
+    virtual ~InferenceBackend() {}
+
+    virtual const char *name() const = 0;
+    // 加载模型文件，失败时返回 false 并给出原因
+    virtual bool load(const std::string &model_path, std::string *error) = 0;
+    virtual bool query(BackendAttrs *attrs) = 0;
+    virtual bool set_input(const uint8_t *data, size_t bytes) = 0;
+    virtual bool run() = 0;
+    // data 在 release_outputs() 之前有效
+    virtual bool get_outputs(const float **data, size_t *count) = 0;
+    virtual void release_outputs() = 0;
+};
+
+#endif // _INFERENCE_BACKEND_H
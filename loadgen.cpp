@@ -0,0 +1,381 @@
+// /api/classify 压测工具
+// 用法: loadgen [选项] 图片.jpg [图片2.jpg ...]
+//   --url=http://127.0.0.1:8080/api/classify
+//   --rate=R           开环：每秒发起 R 个请求（按计划时间发起，不等待上一个完成）
+//   --concurrency=N    闭环：N 个连接各自发完一个再发下一个（未指定 --rate 时使用，默认 1）
+//   --connections=N    开环时最多同时进行的请求数 (默认 256)
+//   --duration=S       压测时长（秒，默认 10）
+//   --features=FILE    特征文件，每行34个逗号分隔的数值；默认使用README中的示例特征
+//   --vary=0|1         每个请求微调特征值，使结果缓存与请求合并不生效 (默认 0)
+//   --timeout-ms=N     单个请求超时 (默认 10000)
+//   --json=FILE        额外把结果写成JSON，便于比较不同版本
+//
+// 开环模式下延迟从计划发起时间算起：服务器变慢导致请求积压时，积压等待也计入延迟，
+// 避免"协调遗漏"（coordinated omission）低估尾延迟。
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netdb.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "http_client.h"
+
+// README中的示例特征
+static const float kSampleFeatures[34] = {
+    5, 1, 0, 1, 10.27f, 4.59f, 131, 38.9f, 84.7f, 28.5f,
+    337, 0.01f, 0.1f, 394, 39.3f, 12.8f, 8.9f, 9, 16.9f, 0.36f,
+    7.09f, 2.5f, 0.59f, 0.05f, 0.04f, 69.1f, 24.3f, 5.7f, 0.5f, 0.4f,
+    0.07f, 0.7f, 68.4f, 7
+};
+
+struct Options {
+    HttpTarget target;
+    double rate = 0;
+    int concurrency = 1;
+    int connections = 256;
+    double duration_s = 10;
+    std::string features_file;
+    bool vary = false;
+    int timeout_ms = 10000;
+    std::string json_file;
+    std::vector<std::string> images;
+};
+
+struct Sample {
+    double latency_us;  // 开环时从计划发起时间算起
+    double service_us;  // 从实际发起算起
+    int status;
+};
+
+static double now_us() {
+    return std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string base64_encode(const std::vector<unsigned char> &in) {
+    static const char table[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((in.size() + 2) / 3 * 4);
+    size_t i = 0;
+    for (; i + 2 < in.size(); i += 3) {
+        uint32_t v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+        out += table[(v >> 18) & 63];
+        out += table[(v >> 12) & 63];
+        out += table[(v >> 6) & 63];
+        out += table[v & 63];
+    }
+    if (i < in.size()) {
+        uint32_t v = in[i] << 16;
+        if (i + 1 < in.size()) v |= in[i + 1] << 8;
+        out += table[(v >> 18) & 63];
+        out += table[(v >> 12) & 63];
+        out += i + 1 < in.size() ? table[(v >> 6) & 63] : '=';
+        out += '=';
+    }
+    return out;
+}
+
+// 请求体的组成部分：图片部分预先编码，特征部分在发送时拼接
+class Corpus {
+public:
+    bool load(const Options &opt) {
+        for (size_t i = 0; i < opt.images.size(); i++) {
+            std::ifstream in(opt.images[i].c_str(), std::ios::binary);
+            if (!in) {
+                fprintf(stderr, "无法读取图片 %s\n", opt.images[i].c_str());
+                return false;
+            }
+            std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)),
+                                             std::istreambuf_iterator<char>());
+            images_.push_back("{\"image\":\"" + base64_encode(bytes) + "\",\"features\":[");
+        }
+        if (opt.features_file.empty()) {
+            features_.push_back(std::vector<float>(kSampleFeatures, kSampleFeatures + 34));
+        } else {
+            std::ifstream in(opt.features_file.c_str());
+            std::string line;
+            while (std::getline(in, line)) {
+                std::vector<float> f;
+                const char *p = line.c_str();
+                char *end;
+                for (;;) {
+                    float v = strtof(p, &end);
+                    if (end == p) break;
+                    f.push_back(v);
+                    p = end;
+                    while (*p == ',' || *p == ' ' || *p == '\t') p++;
+                }
+                if (f.size() == 34) {
+                    features_.push_back(f);
+                } else if (!f.empty()) {
+                    fprintf(stderr, "忽略特征行（%zu 个数值）: %s\n", f.size(), line.c_str());
+                }
+            }
+            if (features_.empty()) {
+                fprintf(stderr, "特征文件 %s 中没有有效的行\n", opt.features_file.c_str());
+                return false;
+            }
+        }
+        return !images_.empty();
+    }
+
+    // 第 seq 个请求的请求体，图片与特征各自轮换
+    std::string body(uint64_t seq, bool vary) const {
+        std::string out = images_[seq % images_.size()];
+        const std::vector<float> &f = features_[seq % features_.size()];
+        char num[32];
+        for (size_t i = 0; i < f.size(); i++) {
+            float v = f[i];
+            // 在最后一个特征上叠加很小的偏移，每个请求的内容哈希都不同
+            if (vary && i + 1 == f.size()) v += (seq % 100000) * 1e-6f;
+            snprintf(num, sizeof(num), i ? ",%g" : "%g", v);
+            out += num;
+        }
+        out += "]}";
+        return out;
+    }
+
+private:
+    std::vector<std::string> images_;
+    std::vector<std::vector<float> > features_;
+};
+
+static double percentile(const std::vector<double> &sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t idx = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+static void print_usage(const char *prog) {
+    printf("用法: %s [选项] 图片.jpg [图片2.jpg ...]\n", prog);
+    printf("  --url=URL          目标地址 (默认 http://127.0.0.1:8080/api/classify)\n");
+    printf("  --rate=R           开环压测，每秒发起R个请求\n");
+    printf("  --concurrency=N    闭环压测，N个并发连接 (默认 1)\n");
+    printf("  --connections=N    开环时最多同时进行的请求数 (默认 256)\n");
+    printf("  --duration=S       压测时长秒数 (默认 10)\n");
+    printf("  --features=FILE    特征文件，每行34个逗号分隔的数值\n");
+    printf("  --vary=0|1         每个请求微调特征值，绕过结果缓存 (默认 0)\n");
+    printf("  --timeout-ms=N     单个请求超时 (默认 10000)\n");
+    printf("  --json=FILE        同时输出JSON结果\n");
+}
+
+static bool parse_args(int argc, char *argv[], Options *opt) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--url=", 6) == 0) {
+            if (!http_parse_url(arg + 6, &opt->target)) {
+                fprintf(stderr, "无效的URL: %s\n", arg + 6);
+                return false;
+            }
+        } else if (strncmp(arg, "--rate=", 7) == 0) {
+            opt->rate = atof(arg + 7);
+        } else if (strncmp(arg, "--concurrency=", 14) == 0) {
+            opt->concurrency = atoi(arg + 14);
+        } else if (strncmp(arg, "--connections=", 14) == 0) {
+            opt->connections = atoi(arg + 14);
+        } else if (strncmp(arg, "--duration=", 11) == 0) {
+            opt->duration_s = atof(arg + 11);
+        } else if (strncmp(arg, "--features=", 11) == 0) {
+            opt->features_file = arg + 11;
+        } else if (strncmp(arg, "--vary=", 7) == 0) {
+            opt->vary = atoi(arg + 7) != 0;
+        } else if (strncmp(arg, "--timeout-ms=", 13) == 0) {
+            opt->timeout_ms = atoi(arg + 13);
+        } else if (strncmp(arg, "--json=", 7) == 0) {
+            opt->json_file = arg + 7;
+        } else if (strncmp(arg, "--", 2) == 0) {
+            fprintf(stderr, "未知参数: %s\n", arg);
+            return false;
+        } else {
+            opt->images.push_back(arg);
+        }
+    }
+    if (opt->images.empty() || opt->concurrency < 1 || opt->connections < 1 ||
+        opt->duration_s <= 0 || opt->rate < 0) {
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    Options opt;
+    if (!parse_args(argc, argv, &opt)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    Corpus corpus;
+    if (!corpus.load(opt)) {
+        return 1;
+    }
+
+    struct addrinfo *addr = http_resolve(opt.target);
+    if (!addr) {
+        fprintf(stderr, "无法解析 %s:%s\n", opt.target.host.c_str(), opt.target.port.c_str());
+        return 1;
+    }
+
+    bool open_loop = opt.rate > 0;
+    int workers = open_loop ? opt.connections : opt.concurrency;
+    std::vector<std::vector<Sample> > samples(workers);
+    std::atomic<uint64_t> next_seq(0);
+    std::atomic<bool> stop(false);
+
+    // 开环：计划发起时间队列，由调度线程按速率放入
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque<double> planned;
+    bool dispatch_done = false;
+    uint64_t max_backlog = 0;
+
+    double start = now_us();
+    double end = start + opt.duration_s * 1e6;
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < workers; w++) {
+        threads.push_back(std::thread([&, w]() {
+            std::vector<Sample> &mine = samples[w];
+            for (;;) {
+                double intended;
+                if (open_loop) {
+                    std::unique_lock<std::mutex> lock(queue_mutex);
+                    queue_cv.wait(lock, [&]() { return dispatch_done || !planned.empty(); });
+                    if (planned.empty()) return;
+                    intended = planned.front();
+                    planned.pop_front();
+                } else {
+                    if (stop.load() || now_us() >= end) return;
+                    intended = now_us();
+                }
+                std::string body = corpus.body(next_seq++, opt.vary);
+                double sent = now_us();
+                int status = http_post(opt.target, addr, body, opt.timeout_ms);
+                double done = now_us();
+                Sample s;
+                s.latency_us = done - intended;
+                s.service_us = done - sent;
+                s.status = status;
+                mine.push_back(s);
+            }
+        }));
+    }
+
+    if (open_loop) {
+        double interval = 1e6 / opt.rate;
+        for (uint64_t i = 0;; i++) {
+            double t = start + i * interval;
+            if (t >= end) break;
+            double wait = t - now_us();
+            if (wait > 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds((int64_t)wait));
+            }
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            planned.push_back(t);
+            max_backlog = std::max<uint64_t>(max_backlog, planned.size());
+            queue_cv.notify_one();
+        }
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        dispatch_done = true;
+        queue_cv.notify_all();
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    double elapsed_s = (now_us() - start) / 1e6;
+    freeaddrinfo(addr);
+
+    // 汇总
+    std::vector<double> latency, service;
+    std::map<int, uint64_t> codes;
+    uint64_t ok = 0;
+    for (size_t w = 0; w < samples.size(); w++) {
+        for (size_t i = 0; i < samples[w].size(); i++) {
+            const Sample &s = samples[w][i];
+            codes[s.status]++;
+            if (s.status == 200) {
+                ok++;
+                latency.push_back(s.latency_us / 1000);
+                service.push_back(s.service_us / 1000);
+            }
+        }
+    }
+    std::sort(latency.begin(), latency.end());
+    std::sort(service.begin(), service.end());
+    uint64_t total = 0;
+    for (std::map<int, uint64_t>::const_iterator it = codes.begin(); it != codes.end(); ++it) {
+        total += it->second;
+    }
+    double mean = 0;
+    for (size_t i = 0; i < latency.size(); i++) mean += latency[i];
+    if (!latency.empty()) mean /= latency.size();
+
+    static const double kPercentiles[] = {50, 90, 99, 99.9};
+    static const char *const kPercentileNames[] = {"p50", "p90", "p99", "p99.9"};
+
+    printf("模式: %s, 时长 %.1f 秒, 图片 %zu 张\n",
+           open_loop ? "开环" : "闭环", elapsed_s, opt.images.size());
+    if (open_loop) {
+        printf("目标速率: %.1f 次/秒, 最大积压 %llu\n", opt.rate, (unsigned long long)max_backlog);
+    } else {
+        printf("并发连接: %d\n", opt.concurrency);
+    }
+    printf("请求: %llu, 成功: %llu, 吞吐: %.1f 次/秒\n", (unsigned long long)total,
+           (unsigned long long)ok, ok / elapsed_s);
+    printf("延迟(ms): 平均 %.2f", mean);
+    for (int i = 0; i < 4; i++) {
+        printf(", %s %.2f", kPercentileNames[i], percentile(latency, kPercentiles[i]));
+    }
+    printf(", 最大 %.2f\n", latency.empty() ? 0.0 : latency.back());
+    if (open_loop) {
+        printf("服务延迟(ms，从实际发起算起): p50 %.2f, p99 %.2f\n",
+               percentile(service, 50), percentile(service, 99));
+    }
+    printf("状态码:");
+    char name[16];
+    for (std::map<int, uint64_t>::const_iterator it = codes.begin(); it != codes.end(); ++it) {
+        printf(" %s=%llu", http_status_name(it->first, name, sizeof(name)),
+               (unsigned long long)it->second);
+    }
+    printf("\n");
+
+    if (!opt.json_file.empty()) {
+        FILE *fp = fopen(opt.json_file.c_str(), "w");
+        if (!fp) {
+            fprintf(stderr, "无法写入 %s\n", opt.json_file.c_str());
+            return 1;
+        }
+        fprintf(fp, "{\"mode\":\"%s\",\"rate\":%g,\"concurrency\":%d,\"duration_s\":%.3f,"
+                "\"requests\":%llu,\"ok\":%llu,\"throughput\":%.3f,",
+                open_loop ? "open" : "closed", opt.rate, open_loop ? opt.connections : opt.concurrency,
+                elapsed_s, (unsigned long long)total, (unsigned long long)ok, ok / elapsed_s);
+        fprintf(fp, "\"latency_ms\":{\"mean\":%.3f", mean);
+        for (int i = 0; i < 4; i++) {
+            fprintf(fp, ",\"%s\":%.3f", kPercentileNames[i], percentile(latency, kPercentiles[i]));
+        }
+        fprintf(fp, ",\"max\":%.3f},", latency.empty() ? 0.0 : latency.back());
+        fprintf(fp, "\"service_ms\":{\"p50\":%.3f,\"p99\":%.3f},\"max_backlog\":%llu,\"codes\":{",
+                percentile(service, 50), percentile(service, 99), (unsigned long long)max_backlog);
+        bool first = true;
+        for (std::map<int, uint64_t>::const_iterator it = codes.begin(); it != codes.end(); ++it) {
+            fprintf(fp, "%s\"%s\":%llu", first ? "" : ",", http_status_name(it->first, name, sizeof(name)),
+                    (unsigned long long)it->second);
+            first = false;
+        }
+        fprintf(fp, "}}\n");
+        fclose(fp);
+    }
+    return ok == total ? 0 : 2;
+}
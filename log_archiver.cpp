@@ -0,0 +1,239 @@
+#include "log_archiver.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include <zlib.h>
+
+// ioprio_set 在 glibc 中没有封装
+static const int kIoprioClassIdle = 3;
+static const int kIoprioClassShift = 13;
+static const int kIoprioWhoProcess = 1;
+
+static bool ends_with(const std::string &s, const char *suffix) {
+    size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+// 归档线程只在空闲时占用CPU和eMMC，不与请求线程争抢
+static void lower_thread_priority() {
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    setpriority(PRIO_PROCESS, tid, 19);
+#ifdef SYS_ioprio_set
+    syscall(SYS_ioprio_set, kIoprioWhoProcess, tid, kIoprioClassIdle << kIoprioClassShift);
+#endif
+}
+
+LogArchiver::LogArchiver()
+    : stop_(false), segments_(0), compressed_(0), raw_bytes_(0), gz_bytes_(0),
+      deleted_(0), archive_bytes_(0), errors_(0) {
+    opt_.compress = false;
+    opt_.retain_bytes = 0;
+}
+
+LogArchiver::~LogArchiver() {
+    stop();
+}
+
+void LogArchiver::start(const Options &opt) {
+    opt_ = opt;
+    size_t slash = opt_.path.rfind('/');
+    if (slash == std::string::npos) {
+        dir_ = ".";
+        prefix_ = opt_.path + ".";
+    } else {
+        dir_ = slash == 0 ? "/" : opt_.path.substr(0, slash);
+        prefix_ = opt_.path.substr(slash + 1) + ".";
+    }
+    thread_ = std::thread(&LogArchiver::run, this);
+}
+
+void LogArchiver::stop() {
+    if (!thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void LogArchiver::submit(const std::string &segment) {
+    segments_++;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(segment);
+    }
+    cv_.notify_one();
+}
+
+void LogArchiver::run() {
+    lower_thread_priority();
+    scan_leftovers();
+    enforce_retention();
+    for (;;) {
+        std::string segment;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return stop_ || !pending_.empty(); });
+            // 退出时未压缩的分段留在磁盘上，下次启动由 scan_leftovers() 接着处理
+            if (stop_) return;
+            segment = pending_.front();
+            pending_.pop_front();
+        }
+        if (opt_.compress) {
+            compress_segment(segment);
+        }
+        // 积压的分段都压缩完再清理，避免按未压缩的大小误删
+        bool idle;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            idle = pending_.empty();
+        }
+        if (idle) {
+            enforce_retention();
+        }
+    }
+}
+
+// 压缩到 .gz.tmp，完成后 rename 为 .gz 再删除原分段，中途退出不会留下残缺的 .gz
+void LogArchiver::compress_segment(const std::string &segment) {
+    int in = open(segment.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        if (errno != ENOENT) {  // 已被保留策略删除时静默跳过
+            errors_++;
+            printf("⚠️ 无法打开待压缩分段 %s: %s\n", segment.c_str(), strerror(errno));
+        }
+        return;
+    }
+
+    std::string gz = segment + ".gz";
+    std::string tmp = gz + ".tmp";
+    gzFile out = gzopen(tmp.c_str(), "wb6");
+    if (!out) {
+        errors_++;
+        printf("⚠️ 无法创建压缩文件 %s\n", tmp.c_str());
+        close(in);
+        return;
+    }
+
+    char buf[64 * 1024];
+    uint64_t raw = 0;
+    bool ok = true;
+    for (;;) {
+        ssize_t n = read(in, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            ok = false;
+            break;
+        }
+        if (n == 0) break;
+        if (gzwrite(out, buf, (unsigned)n) != (int)n) {
+            ok = false;
+            break;
+        }
+        raw += (uint64_t)n;
+    }
+    close(in);
+    if (gzclose(out) != Z_OK) ok = false;
+
+    struct stat st;
+    if (!ok || stat(tmp.c_str(), &st) != 0 || rename(tmp.c_str(), gz.c_str()) != 0) {
+        errors_++;
+        printf("⚠️ 压缩分段 %s 失败，保留原文件\n", segment.c_str());
+        unlink(tmp.c_str());
+        return;
+    }
+    unlink(segment.c_str());
+    compressed_++;
+    raw_bytes_ += raw;
+    gz_bytes_ += (uint64_t)st.st_size;
+}
+
+// 分段名中的时间戳可直接按字典序比较新旧
+void LogArchiver::enforce_retention() {
+    DIR *dir = opendir(dir_.c_str());
+    if (!dir) return;
+
+    struct Segment {
+        std::string key;   // 去掉 .gz 后的文件名
+        std::string path;
+        uint64_t bytes;
+    };
+    std::vector<Segment> segments;
+    uint64_t total = 0;
+    while (struct dirent *ent = readdir(dir)) {
+        std::string name = ent->d_name;
+        if (name.compare(0, prefix_.size(), prefix_) != 0 || ends_with(name, ".tmp")) {
+            continue;
+        }
+        Segment seg;
+        seg.path = dir_ + "/" + name;
+        struct stat st;
+        if (stat(seg.path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        seg.key = ends_with(name, ".gz") ? name.substr(0, name.size() - 3) : name;
+        seg.bytes = (uint64_t)st.st_size;
+        total += seg.bytes;
+        segments.push_back(seg);
+    }
+    closedir(dir);
+
+    if (opt_.retain_bytes > 0 && total > opt_.retain_bytes) {
+        std::sort(segments.begin(), segments.end(),
+                  [](const Segment &a, const Segment &b) { return a.key < b.key; });
+        for (size_t i = 0; i < segments.size() && total > opt_.retain_bytes; i++) {
+            if (unlink(segments[i].path.c_str()) == 0) {
+                total -= segments[i].bytes;
+                deleted_++;
+                printf("🗑️ 删除旧结果分段 %s\n", segments[i].path.c_str());
+            }
+        }
+    }
+    archive_bytes_ = total;
+}
+
+// 清理中断的 .tmp，并把未压缩的分段重新排队
+void LogArchiver::scan_leftovers() {
+    DIR *dir = opendir(dir_.c_str());
+    if (!dir) return;
+    std::vector<std::string> leftovers;
+    while (struct dirent *ent = readdir(dir)) {
+        std::string name = ent->d_name;
+        if (name.compare(0, prefix_.size(), prefix_) != 0) continue;
+        std::string path = dir_ + "/" + name;
+        if (ends_with(name, ".tmp")) {
+            unlink(path.c_str());
+        } else if (!ends_with(name, ".gz")) {
+            leftovers.push_back(path);
+        }
+    }
+    closedir(dir);
+
+    if (!opt_.compress) return;
+    std::sort(leftovers.begin(), leftovers.end());
+    for (size_t i = 0; i < leftovers.size(); i++) {
+        compress_segment(leftovers[i]);
+    }
+}
+
+void LogArchiver::write_metrics(JsonWriter &w) const {
+    w.begin_object("archive");
+    w.field("compress", opt_.compress);
+    w.field("retain_bytes", (uint64_t)opt_.retain_bytes);
+    w.field("archive_bytes", (uint64_t)archive_bytes_.load());
+    w.field("segments", (uint64_t)segments_.load());
+    w.field("compressed", (uint64_t)compressed_.load());
+    w.field("raw_bytes", (uint64_t)raw_bytes_.load());
+    w.field("gz_bytes", (uint64_t)gz_bytes_.load());
+    w.field("deleted", (uint64_t)deleted_.load());
+    w.field("errors", (uint64_t)errors_.load());
+    w.end_object();
+}
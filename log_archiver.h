@@ -0,0 +1,63 @@
+#ifndef _LOG_ARCHIVER_H
+#define _LOG_ARCHIVER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "metrics.h"
+
+// 已轮转结果文件的后台归档
+// 独立的低优先级线程（nice 19 + IO idle）把轮转出的分段gzip压缩，
+// 再按总字节数删除最旧的分段；轮转本身只做 rename，不等待压缩。
+class LogArchiver {
+public:
+    struct Options {
+        std::string path;     // 当前结果文件，分段命名为 path.YYYYmmdd-HHMMSS[.gz]
+        bool compress;        // 是否gzip压缩分段
+        uint64_t retain_bytes;  // 所有分段合计上限，0 表示不限制
+    };
+
+    LogArchiver();
+    ~LogArchiver();
+
+    // 启动时顺带处理上次退出前未压缩完的分段
+    void start(const Options &opt);
+    void stop();
+
+    // 写入线程在 rename 之后调用，立即返回
+    void submit(const std::string &segment);
+
+    void write_metrics(JsonWriter &w) const;
+
+private:
+    void run();
+    void compress_segment(const std::string &segment);
+    void enforce_retention();
+    void scan_leftovers();
+
+    Options opt_;
+    std::string dir_;
+    std::string prefix_;  // 分段文件名前缀 "basename."
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::string> pending_;
+    bool stop_;
+
+    std::atomic<uint64_t> segments_;
+    std::atomic<uint64_t> compressed_;
+    std::atomic<uint64_t> raw_bytes_;
+    std::atomic<uint64_t> gz_bytes_;
+    std::atomic<uint64_t> deleted_;
+    std::atomic<uint64_t> archive_bytes_;
+    std::atomic<uint64_t> errors_;
+};
+
+#endif // _LOG_ARCHIVER_H
@@ -0,0 +1,87 @@
+#include "manifest.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+static bool has_image_ext(const std::string &name) {
+    size_t dot = name.rfind('.');
+    if (dot == std::string::npos) return false;
+    std::string ext = name.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == "jpg" || ext == "jpeg" || ext == "png" || ext == "bmp";
+}
+
+bool load_manifest(const std::string &manifest, std::vector<ManifestEntry> *entries,
+                   std::string *error) {
+    std::ifstream in(manifest.c_str());
+    if (!in) {
+        *error = "无法读取清单 " + manifest;
+        return false;
+    }
+    size_t slash = manifest.rfind('/');
+    std::string base = slash == std::string::npos ? "" : manifest.substr(0, slash + 1);
+    std::string line;
+    int line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+        if (line.empty() || line[0] == '#') continue;
+        std::stringstream ss(line);
+        ManifestEntry e;
+        std::string field;
+        std::getline(ss, e.path, ',');
+        bool numeric = true;
+        while (numeric && std::getline(ss, field, ',')) {
+            char *end = NULL;
+            e.features.push_back(strtof(field.c_str(), &end));
+            numeric = end != field.c_str();
+        }
+        if (!numeric || e.features.size() != kManifestFeatures || e.path.empty()) {
+            if (line_no == 1) continue;  // 表头
+            char buf[64];
+            snprintf(buf, sizeof(buf), ":%d: 需要图片路径与%zu个特征值", line_no, kManifestFeatures);
+            *error = manifest + buf;
+            return false;
+        }
+        if (e.path[0] != '/') e.path = base + e.path;
+        entries->push_back(e);
+    }
+    return true;
+}
+
+bool add_image_path(const std::string &path, std::vector<ManifestEntry> *entries,
+                    std::string *error) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        *error = "无法访问 " + path;
+        return false;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        ManifestEntry e;
+        e.path = path;
+        entries->push_back(e);
+        return true;
+    }
+    DIR *dir = opendir(path.c_str());
+    if (!dir) {
+        *error = "无法打开目录 " + path;
+        return false;
+    }
+    std::vector<std::string> names;
+    while (struct dirent *d = readdir(dir)) {
+        if (d->d_name[0] != '.' && has_image_ext(d->d_name)) names.push_back(d->d_name);
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());  // 每次顺序相同
+    for (size_t i = 0; i < names.size(); i++) {
+        ManifestEntry e;
+        e.path = path + "/" + names[i];
+        entries->push_back(e);
+    }
+    return true;
+}
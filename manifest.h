@@ -0,0 +1,24 @@
+#ifndef _MANIFEST_H
+#define _MANIFEST_H
+
+#include <string>
+#include <vector>
+
+// 离线工具（golden、batch_classify）的输入清单
+// CSV每行为 图片路径,34个特征值；路径相对清单所在目录，首行可为表头，# 开头的行忽略
+struct ManifestEntry {
+    std::string path;
+    std::vector<float> features;  // 目录输入时为空
+};
+
+static const size_t kManifestFeatures = 34;
+
+// 失败时 error 中给出文件与行号
+bool load_manifest(const std::string &manifest, std::vector<ManifestEntry> *entries,
+                   std::string *error);
+
+// path 为目录时按文件名顺序加入其中的图片（jpg/jpeg/png/bmp），否则加入该文件
+bool add_image_path(const std::string &path, std::vector<ManifestEntry> *entries,
+                    std::string *error);
+
+#endif // _MANIFEST_H
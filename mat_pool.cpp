@@ -0,0 +1,181 @@
+#include "mat_pool.h"
+
+#include <stdlib.h>
+#include <malloc.h>
+#include <algorithm>
+#include <chrono>
+
+static uint64_t steady_ms() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+PooledMatAllocator::PooledMatAllocator()
+    : max_retained_(0), idle_ms_(0), retained_bytes_(0), last_alloc_ms_(0),
+      allocations_(0), hits_(0), misses_(0), unpooled_(0), discarded_(0), in_use_bytes_(0),
+      trims_(0), trimmed_bytes_(0) {
+    // 16KB, 20KB, 24KB, 28KB, 32KB, 40KB ... 128MB
+    for (size_t base = kMinPooledBytes; base < kMaxPooledBytes; base *= 2) {
+        for (int j = 0; j < 4; j++) {
+            class_bytes_.push_back(base + base / 4 * j);
+        }
+    }
+    class_bytes_.push_back((size_t)kMaxPooledBytes);
+    free_.resize(class_bytes_.size());
+}
+
+PooledMatAllocator::~PooledMatAllocator() {
+    trim();
+}
+
+void PooledMatAllocator::configure(size_t max_retained, uint64_t idle_ms) {
+    max_retained_ = max_retained;
+    idle_ms_ = idle_ms;
+}
+
+int PooledMatAllocator::size_class(size_t bytes) const {
+    if (bytes < kMinPooledBytes || bytes > kMaxPooledBytes) return -1;
+    return (int)(std::lower_bound(class_bytes_.begin(), class_bytes_.end(), bytes) -
+                 class_bytes_.begin());
+}
+
+void *PooledMatAllocator::acquire(size_t bytes) const {
+    allocations_++;
+    int cls = size_class(bytes);
+    if (cls < 0) {
+        unpooled_++;
+        return cv::fastMalloc(bytes);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        last_alloc_ms_ = steady_ms();
+        std::vector<void *> &list = free_[cls];
+        if (!list.empty()) {
+            void *p = list.back();
+            list.pop_back();
+            retained_bytes_ -= class_bytes_[cls];
+            hits_++;
+            in_use_bytes_ += (int64_t)class_bytes_[cls];
+            return p;
+        }
+    }
+    misses_++;
+    in_use_bytes_ += (int64_t)class_bytes_[cls];
+    return cv::fastMalloc(class_bytes_[cls]);
+}
+
+void PooledMatAllocator::release(void *p, size_t bytes) const {
+    int cls = size_class(bytes);
+    if (cls < 0) {
+        cv::fastFree(p);
+        return;
+    }
+    in_use_bytes_ -= (int64_t)class_bytes_[cls];
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (retained_bytes_ + class_bytes_[cls] <= max_retained_) {
+            free_[cls].push_back(p);
+            retained_bytes_ += class_bytes_[cls];
+            return;
+        }
+    }
+    discarded_++;
+    cv::fastFree(p);
+}
+
+// 与OpenCV的 StdMatAllocator 相同，只是数据缓冲来自分级空闲链表
+cv::UMatData *PooledMatAllocator::allocate(int dims, const int *sizes, int type, void *data0,
+                                           size_t *step, MatAccessFlag flags,
+                                           cv::UMatUsageFlags usage) const {
+    (void)flags;
+    (void)usage;
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; i--) {
+        if (step) {
+            if (data0 && step[i] != CV_AUTOSTEP) {
+                total = step[i];
+            } else {
+                step[i] = total;
+            }
+        }
+        total *= sizes[i];
+    }
+    unsigned char *data = data0 ? (unsigned char *)data0 : (unsigned char *)acquire(total);
+    cv::UMatData *u = new cv::UMatData(this);
+    u->data = u->origdata = data;
+    u->size = total;
+    if (data0) u->flags |= cv::UMatData::USER_ALLOCATED;
+    return u;
+}
+
+bool PooledMatAllocator::allocate(cv::UMatData *u, MatAccessFlag flags,
+                                  cv::UMatUsageFlags usage) const {
+    (void)flags;
+    (void)usage;
+    return u != NULL;
+}
+
+void PooledMatAllocator::deallocate(cv::UMatData *u) const {
+    if (!u) return;
+    if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+        release(u->origdata, u->size);
+        u->origdata = 0;
+    }
+    delete u;
+}
+
+size_t PooledMatAllocator::trim_if_idle() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (retained_bytes_ == 0 || idle_ms_ == 0 || steady_ms() - last_alloc_ms_ < idle_ms_) {
+            return 0;
+        }
+    }
+    return trim();
+}
+
+size_t PooledMatAllocator::trim() {
+    std::vector<void *> victims;
+    size_t bytes;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < free_.size(); i++) {
+            victims.insert(victims.end(), free_[i].begin(), free_[i].end());
+            free_[i].clear();
+        }
+        bytes = retained_bytes_;
+        retained_bytes_ = 0;
+    }
+    if (victims.empty()) return 0;
+    for (size_t i = 0; i < victims.size(); i++) {
+        cv::fastFree(victims[i]);
+    }
+    malloc_trim(0);
+    trims_++;
+    trimmed_bytes_ += bytes;
+    return bytes;
+}
+
+void PooledMatAllocator::write_metrics(JsonWriter &w) const {
+    uint64_t pooled = hits_.load() + misses_.load();
+    size_t retained;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        retained = retained_bytes_;
+    }
+    w.begin_object("mat_pool");
+    w.field("enabled", enabled());
+    w.field("max_retained_bytes", (uint64_t)max_retained_);
+    w.field("idle_ms", idle_ms_);
+    w.field("allocations", allocations_.load());
+    w.field("hits", hits_.load());
+    w.field("misses", misses_.load());
+    w.field("hit_rate", pooled ? (double)hits_.load() / pooled : 0.0);
+    w.field("unpooled", unpooled_.load());
+    w.field("discarded", discarded_.load());
+    w.field("retained_bytes", (uint64_t)retained);
+    w.field("in_use_bytes", (uint64_t)std::max<int64_t>(0, in_use_bytes_.load()));
+    w.field("trims", trims_.load());
+    w.field("trimmed_bytes", trimmed_bytes_.load());
+    w.end_object();
+}
@@ -0,0 +1,79 @@
+#ifndef _MAT_POOL_H
+#define _MAT_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+#include "metrics.h"
+
+#if CV_VERSION_MAJOR >= 4
+typedef cv::AccessFlag MatAccessFlag;
+#else
+typedef int MatAccessFlag;
+#endif
+
+// 图像解码/缩放缓冲的 cv::MatAllocator：按大小分级的空闲链表
+// 每级之间相差约19%（每个2的幂分4级），请求向上取整到所在级别，
+// 释放时放回该级别的空闲链表，稳定状态下相同尺寸的图像反复复用同一批缓冲，
+// 不再每次经 malloc/free 申请数MB的内存，长期运行时glibc堆不会因尺寸不一而碎片化。
+// 小于 kMinPooledBytes 或大于 kMaxPooledBytes 的请求直接走 malloc。
+// 空闲缓冲总量超过 max_retained 时多余的直接释放；超过 idle_ms 没有分配时
+// trim_if_idle() 释放全部空闲缓冲并 malloc_trim 归还系统。
+// 只设置在需要的 cv::Mat 上（mat.allocator = &pool），不替换OpenCV的默认分配器。
+class PooledMatAllocator : public cv::MatAllocator {
+public:
+    static const size_t kMinPooledBytes = 16 << 10;
+    static const size_t kMaxPooledBytes = 128 << 20;
+
+    PooledMatAllocator();
+    ~PooledMatAllocator();
+
+    // max_retained 为0时关闭（全部直接 malloc/free）
+    void configure(size_t max_retained, uint64_t idle_ms);
+    bool enabled() const { return max_retained_ > 0; }
+
+    // 让 mat 之后的 create() 使用本分配器；关闭时不改动
+    void attach(cv::Mat &mat) {
+        if (enabled()) mat.allocator = this;
+    }
+
+    cv::UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step,
+                           MatAccessFlag flags, cv::UMatUsageFlags usage) const;
+    bool allocate(cv::UMatData *data, MatAccessFlag flags, cv::UMatUsageFlags usage) const;
+    void deallocate(cv::UMatData *data) const;
+
+    // 由定时器周期调用；返回释放的字节数
+    size_t trim_if_idle();
+    size_t trim();
+
+    void write_metrics(JsonWriter &w) const;
+
+private:
+    int size_class(size_t bytes) const;
+    void *acquire(size_t bytes) const;
+    void release(void *p, size_t bytes) const;
+
+    size_t max_retained_;
+    uint64_t idle_ms_;
+    std::vector<size_t> class_bytes_;  // 各级别的缓冲大小，升序
+
+    mutable std::mutex mutex_;
+    mutable std::vector<std::vector<void *> > free_;  // 各级别的空闲缓冲
+    mutable size_t retained_bytes_;
+    mutable uint64_t last_alloc_ms_;
+
+    mutable std::atomic<uint64_t> allocations_;
+    mutable std::atomic<uint64_t> hits_;
+    mutable std::atomic<uint64_t> misses_;
+    mutable std::atomic<uint64_t> unpooled_;
+    mutable std::atomic<uint64_t> discarded_;  // 超过空闲上限而直接释放
+    mutable std::atomic<int64_t> in_use_bytes_;
+    std::atomic<uint64_t> trims_;
+    std::atomic<uint64_t> trimmed_bytes_;
+};
+
+#endif // _MAT_POOL_H
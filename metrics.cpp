@@ -0,0 +1,92 @@
+#include "metrics.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+void LatencyStat::record(double us) {
+    uint64_t v = us > 0 ? (uint64_t)us : 0;
+    count.fetch_add(1, std::memory_order_relaxed);
+    total_us.fetch_add(v, std::memory_order_relaxed);
+    uint64_t prev = max_us.load(std::memory_order_relaxed);
+    while (v > prev && !max_us.compare_exchange_weak(prev, v, std::memory_order_relaxed)) {
+    }
+}
+
+double LatencyStat::avg_us() const {
+    uint64_t n = count.load(std::memory_order_relaxed);
+    return n ? (double)total_us.load(std::memory_order_relaxed) / n : 0.0;
+}
+
+void JsonWriter::key(const char* key) {
+    if (!out_.empty() && out_[out_.size() - 1] != '{' && out_[out_.size() - 1] != '[') {
+        out_ += ',';
+    }
+    if (key) {
+        out_ += '"';
+        out_ += key;
+        out_ += "\":";
+    }
+}
+
+void JsonWriter::begin_object(const char* k) {
+    key(k);
+    out_ += '{';
+}
+
+void JsonWriter::end_object() {
+    out_ += '}';
+}
+
+void JsonWriter::begin_array(const char* k) {
+    key(k);
+    out_ += '[';
+}
+
+void JsonWriter::end_array() {
+    out_ += ']';
+}
+
+void JsonWriter::field(const char* k, double value) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.3f", value);
+    key(k);
+    out_ += buf;
+}
+
+void JsonWriter::field(const char* k, uint64_t value) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%llu", (unsigned long long)value);
+    key(k);
+    out_ += buf;
+}
+
+void JsonWriter::field(const char* k, const char* value) {
+    key(k);
+    out_ += '"';
+    out_ += value;
+    out_ += '"';
+}
+
+void JsonWriter::field(const char* k, bool value) {
+    key(k);
+    out_ += value ? "true" : "false";
+}
+
+void JsonWriter::latency(const char* k, const LatencyStat& stat) {
+    begin_object(k);
+    field("count", (uint64_t)stat.count.load(std::memory_order_relaxed));
+    field("avg_us", stat.avg_us());
+    field("max_us", (uint64_t)stat.max_us.load(std::memory_order_relaxed));
+    end_object();
+}
+
+size_t process_rss_bytes() {
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (!fp) return 0;
+    unsigned long size = 0, resident = 0;
+    if (fscanf(fp, "%lu %lu", &size, &resident) != 2) {
+        resident = 0;
+    }
+    fclose(fp);
+    return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+}
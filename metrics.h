@@ -0,0 +1,46 @@
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <string>
+
+// 累计耗时统计（微秒），多线程并发 record() 安全
+struct LatencyStat {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> total_us;
+    std::atomic<uint64_t> max_us;
+
+    LatencyStat() : count(0), total_us(0), max_us(0) {}
+
+    void record(double us);
+    double avg_us() const;
+};
+
+// 拼接 /api/metrics 的JSON输出
+class JsonWriter {
+public:
+    void begin_object(const char* key = nullptr);
+    void end_object();
+    void begin_array(const char* key = nullptr);
+    void end_array();
+    void field(const char* key, double value);
+    void field(const char* key, uint64_t value);
+    void field(const char* key, const char* value);
+    void field(const char* key, bool value);
+    // 输出 {"count":..,"avg_us":..,"max_us":..}
+    void latency(const char* key, const LatencyStat& stat);
+
+    const std::string& str() const { return out_; }
+
+private:
+    void key(const char* key);
+
+    std::string out_;
+};
+
+// 当前进程常驻内存（字节），读取 /proc/self/statm
+size_t process_rss_bytes();
+
+#endif // _METRICS_H
@@ -0,0 +1,426 @@
+// CPU侧热点函数的微基准测试
+// 用法: microbench [选项]
+//   --filter=STR       只运行名称包含 STR 的项目
+//   --image=FILE       额外以该JPEG测试解码相关项目
+//   --reps=N           每个项目重复测量的轮数，取中位数 (默认 7)
+//   --min-ms=N         每轮至少运行的毫秒数 (默认 50)
+//   --json=FILE        结果写成JSON
+//   --baseline=FILE    与之前 --json 的结果比较，变慢超过阈值或分配次数增加时标出并以退出码3结束
+//   --threshold=PCT    回归阈值百分比 (默认 10)
+//   --cpu=N            绑定到第N个CPU核心，减少调度带来的波动
+//
+// 服务器的函数大多是 static，这里直接包含服务器源文件（不编译其中的 main）。
+// 特征模型项目需要当前目录下的 nn_model.onnx，缺少时跳过。
+
+#define ATK_NO_MAIN
+#include "atk_mobilenet_object_classification.cpp"
+
+#include <sched.h>
+#include <stdarg.h>
+#include <algorithm>
+#include <functional>
+
+// ---- 分配计数 ----
+// glibc 下包装 malloc 系列（operator new 也经由 malloc），其他C库只统计 operator new。
+// 只统计开启计数的线程，后台线程（如结果写入线程）的分配不计入。
+static __thread bool t_counting = false;
+static __thread uint64_t t_allocs = 0;
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+
+void *malloc(size_t size) {
+    if (t_counting) t_allocs++;
+    return __libc_malloc(size);
+}
+void *calloc(size_t n, size_t size) {
+    if (t_counting) t_allocs++;
+    return __libc_calloc(n, size);
+}
+void *realloc(void *ptr, size_t size) {
+    if (t_counting) t_allocs++;
+    return __libc_realloc(ptr, size);
+}
+int posix_memalign(void **out, size_t alignment, size_t size) {
+    if (t_counting) t_allocs++;
+    void *p = __libc_memalign(alignment, size);
+    if (!p) return ENOMEM;
+    *out = p;
+    return 0;
+}
+void *memalign(size_t alignment, size_t size) {
+    if (t_counting) t_allocs++;
+    return __libc_memalign(alignment, size);
+}
+void *aligned_alloc(size_t alignment, size_t size) {
+    if (t_counting) t_allocs++;
+    return __libc_memalign(alignment, size);
+}
+}
+#else
+void *operator new(size_t size) {
+    if (t_counting) t_allocs++;
+    void *p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+#endif
+
+// 防止被测结果被编译器优化掉
+static volatile uint64_t s_sink;
+
+struct BenchResult {
+    std::string name;
+    double ns_per_op;     // 各轮中位数
+    double min_ns;
+    double spread;        // (最慢轮 - 最快轮) / 中位数
+    double allocs_per_op;
+    uint64_t iterations;  // 每轮次数
+};
+
+struct BenchOptions {
+    std::string filter;
+    std::string image;
+    int reps = 7;
+    double min_ms = 50;
+    std::string json_file;
+    std::string baseline;
+    double threshold = 10;
+    int cpu = -1;
+};
+
+static BenchOptions s_opt;
+static std::vector<BenchResult> s_results;
+
+// 先估计单次耗时，再定每轮次数使一轮不少于 min_ms；分配次数取单独一轮的平均
+static void bench(const std::string &name, const std::function<void()> &fn) {
+    if (!s_opt.filter.empty() && name.find(s_opt.filter) == std::string::npos) {
+        return;
+    }
+    fn();  // 预热
+    uint64_t iters = 1;
+    for (;;) {
+        double t0 = now_us();
+        for (uint64_t i = 0; i < iters; i++) fn();
+        double us = now_us() - t0;
+        if (us >= s_opt.min_ms * 1000 / 4 || iters >= (1ULL << 30)) {
+            iters = std::max<uint64_t>(1, (uint64_t)(iters * s_opt.min_ms * 1000 / std::max(us, 1.0)));
+            break;
+        }
+        iters *= 4;
+    }
+
+    std::vector<double> per_op;
+    for (int r = 0; r < s_opt.reps; r++) {
+        double t0 = now_us();
+        for (uint64_t i = 0; i < iters; i++) fn();
+        per_op.push_back((now_us() - t0) * 1000 / iters);
+    }
+    std::sort(per_op.begin(), per_op.end());
+
+    t_allocs = 0;
+    t_counting = true;
+    for (uint64_t i = 0; i < iters; i++) fn();
+    t_counting = false;
+
+    BenchResult res;
+    res.name = name;
+    res.ns_per_op = per_op[per_op.size() / 2];
+    res.min_ns = per_op.front();
+    res.spread = (per_op.back() - per_op.front()) / res.ns_per_op;
+    res.allocs_per_op = (double)t_allocs / iters;
+    res.iterations = iters;
+    s_results.push_back(res);
+    printf("%-36s %14.1f %14.1f %8.1f%% %10.2f\n", name.c_str(), res.ns_per_op, res.min_ns,
+           res.spread * 100, res.allocs_per_op);
+    fflush(stdout);
+}
+
+static std::string base64_encode(const std::vector<unsigned char> &in) {
+    static const char table[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    size_t i = 0;
+    for (; i + 2 < in.size(); i += 3) {
+        uint32_t v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+        out += table[(v >> 18) & 63];
+        out += table[(v >> 12) & 63];
+        out += table[(v >> 6) & 63];
+        out += table[v & 63];
+    }
+    if (i < in.size()) {
+        uint32_t v = in[i] << 16;
+        if (i + 1 < in.size()) v |= in[i + 1] << 8;
+        out += table[(v >> 18) & 63];
+        out += table[(v >> 12) & 63];
+        out += i + 1 < in.size() ? table[(v >> 6) & 63] : '=';
+        out += '=';
+    }
+    return out;
+}
+
+// 固定种子的合成图像：渐变叠加噪声，JPEG压缩率接近真实照片
+static std::vector<unsigned char> synthetic_jpeg(int width, int height) {
+    cv::Mat img(height, width, CV_8UC3);
+    uint32_t seed = 12345;
+    for (int y = 0; y < height; y++) {
+        unsigned char *row = img.ptr(y);
+        for (int x = 0; x < width; x++) {
+            seed = seed * 1103515245u + 12345u;
+            int noise = (int)((seed >> 16) & 31) - 16;
+            row[x * 3 + 0] = (unsigned char)std::min(255, std::max(0, x * 255 / width + noise));
+            row[x * 3 + 1] = (unsigned char)std::min(255, std::max(0, y * 255 / height + noise));
+            row[x * 3 + 2] = (unsigned char)std::min(255, std::max(0, 128 + noise));
+        }
+    }
+    std::vector<unsigned char> jpeg;
+    cv::imencode(".jpg", img, jpeg);
+    return jpeg;
+}
+
+static std::string request_body(const std::string &b64) {
+    std::string body = "{\"image\":\"" + b64 + "\",\"features\":[";
+    char num[32];
+    for (int i = 0; i < 34; i++) {
+        snprintf(num, sizeof(num), i ? ",%g" : "%g", kProbeFeatures[i]);
+        body += num;
+    }
+    return body + "]}";
+}
+
+// 与上次结果比较，返回回归项数
+static int compare_baseline(const std::string &path) {
+    std::ifstream in(path.c_str());
+    if (!in) {
+        fprintf(stderr, "无法读取基线 %s\n", path.c_str());
+        return 0;
+    }
+    std::map<std::string, std::pair<double, double> > base;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t p = line.find("\"name\":\"");
+        if (p == std::string::npos) continue;
+        size_t q = line.find('"', p + 8);
+        std::string name = line.substr(p + 8, q - p - 8);
+        size_t ns = line.find("\"ns_per_op\":");
+        size_t al = line.find("\"allocs_per_op\":");
+        if (ns == std::string::npos || al == std::string::npos) continue;
+        base[name] = std::make_pair(atof(line.c_str() + ns + 12), atof(line.c_str() + al + 16));
+    }
+
+    int regressions = 0;
+    printf("\n与基线 %s 比较（阈值 %.0f%%）:\n", path.c_str(), s_opt.threshold);
+    printf("%-36s %12s %12s %9s %s\n", "项目", "基线(ns)", "当前(ns)", "变化", "");
+    for (size_t i = 0; i < s_results.size(); i++) {
+        const BenchResult &r = s_results[i];
+        std::map<std::string, std::pair<double, double> >::const_iterator it = base.find(r.name);
+        if (it == base.end()) {
+            printf("%-36s %12s %12.1f %9s 新增\n", r.name.c_str(), "-", r.ns_per_op, "-");
+            continue;
+        }
+        double change = (r.ns_per_op / it->second.first - 1) * 100;
+        bool slower = change > s_opt.threshold;
+        bool more_allocs = r.allocs_per_op > it->second.second + 0.5;
+        const char *flag = slower && more_allocs ? "⚠️ 变慢且分配增加" :
+                           slower ? "⚠️ 变慢" : more_allocs ? "⚠️ 分配增加" :
+                           change < -s_opt.threshold ? "✅ 变快" : "";
+        if (slower || more_allocs) regressions++;
+        printf("%-36s %12.1f %12.1f %+8.1f%% %s\n", r.name.c_str(), it->second.first,
+               r.ns_per_op, change, flag);
+    }
+    return regressions;
+}
+
+static void write_json(const std::string &path) {
+    FILE *fp = fopen(path.c_str(), "w");
+    if (!fp) {
+        fprintf(stderr, "无法写入 %s\n", path.c_str());
+        return;
+    }
+    // 每项一行，--baseline 按行读取
+    fprintf(fp, "{\"benchmarks\":[\n");
+    for (size_t i = 0; i < s_results.size(); i++) {
+        const BenchResult &r = s_results[i];
+        fprintf(fp, "{\"name\":\"%s\",\"ns_per_op\":%.3f,\"min_ns\":%.3f,\"spread\":%.4f,"
+                "\"allocs_per_op\":%.3f,\"iterations\":%llu}%s\n",
+                r.name.c_str(), r.ns_per_op, r.min_ns, r.spread, r.allocs_per_op,
+                (unsigned long long)r.iterations, i + 1 < s_results.size() ? "," : "");
+    }
+    fprintf(fp, "]}\n");
+    fclose(fp);
+}
+
+static bool parse_bench_args(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--filter=", 9) == 0) {
+            s_opt.filter = arg + 9;
+        } else if (strncmp(arg, "--image=", 8) == 0) {
+            s_opt.image = arg + 8;
+        } else if (strncmp(arg, "--reps=", 7) == 0) {
+            s_opt.reps = std::max(1, atoi(arg + 7));
+        } else if (strncmp(arg, "--min-ms=", 9) == 0) {
+            s_opt.min_ms = std::max(1.0, atof(arg + 9));
+        } else if (strncmp(arg, "--json=", 7) == 0) {
+            s_opt.json_file = arg + 7;
+        } else if (strncmp(arg, "--baseline=", 11) == 0) {
+            s_opt.baseline = arg + 11;
+        } else if (strncmp(arg, "--threshold=", 12) == 0) {
+            s_opt.threshold = atof(arg + 12);
+        } else if (strncmp(arg, "--cpu=", 6) == 0) {
+            s_opt.cpu = atoi(arg + 6);
+        } else {
+            fprintf(stderr, "未知参数: %s\n", arg);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (!parse_bench_args(argc, argv)) {
+        return 1;
+    }
+    if (s_opt.cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(s_opt.cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            fprintf(stderr, "无法绑定到CPU %d\n", s_opt.cpu);
+        }
+    }
+
+    // 各尺寸的输入：合成JPEG及可选的真实图片
+    std::vector<std::pair<std::string, std::vector<unsigned char> > > jpegs;
+    static const int kSizes[][2] = {{224, 224}, {640, 480}, {1280, 960}};
+    for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "%dx%d", kSizes[i][0], kSizes[i][1]);
+        jpegs.push_back(std::make_pair(std::string(name), synthetic_jpeg(kSizes[i][0], kSizes[i][1])));
+    }
+    if (!s_opt.image.empty()) {
+        std::ifstream in(s_opt.image.c_str(), std::ios::binary);
+        std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)),
+                                 std::istreambuf_iterator<char>());
+        if (bytes.empty()) {
+            fprintf(stderr, "无法读取 %s\n", s_opt.image.c_str());
+            return 1;
+        }
+        jpegs.push_back(std::make_pair(std::string("file"), bytes));
+    }
+
+    printf("%-36s %14s %14s %9s %10s\n", "项目", "中位数(ns)", "最快(ns)", "波动", "分配/次");
+
+    for (size_t i = 0; i < jpegs.size(); i++) {
+        const std::string &size = jpegs[i].first;
+        const std::vector<unsigned char> &jpeg = jpegs[i].second;
+        std::string b64 = base64_encode(jpeg);
+        std::string body = request_body(b64);
+
+        bench("base64_decode/" + size, [&]() {
+            std::vector<unsigned char> out = base64_decode(b64);
+            s_sink += out.size();
+        });
+        // fn() 中的请求解析：定位 image 字段、解析特征、计算输入哈希
+        bench("parse_request/" + size, [&]() {
+            size_t start = 0, len = 0;
+            find_image_field(body, &start, &len);
+            float features[kFeatureCount];
+            parse_features(body, features);
+            s_sink += len + content_hash64(features, sizeof(features),
+                                           content_hash64(body.data() + start, len));
+        });
+        // --stream-body：请求体按16KB分段到达，边接收边解码（对应 parse_request + base64_decode）
+        bench("stream_body/" + size, [&]() {
+            StreamingBody sb(body.size(), false);
+            for (size_t off = 0; off < body.size(); off += 16 * 1024) {
+                sb.feed(body.data() + off, std::min(body.size() - off, (size_t)16 * 1024));
+            }
+            float features[kFeatureCount];
+            parse_features(sb.text(), features);
+            s_sink += sb.image_size() + content_hash64(features, sizeof(features), sb.image_hash());
+        });
+        bench("imdecode_resize/" + size, [&]() {
+            cv::Mat img = cv::imdecode(cv::Mat(1, (int)jpeg.size(), CV_8U, (void *)jpeg.data()),
+                                       cv::IMREAD_COLOR);
+            cv::Mat resized;
+            cv::resize(img, resized, cv::Size(224, 224));
+            s_sink += resized.rows;
+        });
+    }
+
+    float logits[3] = {1.2f, -0.3f, 0.7f};
+    bench("softmax/3", [&]() {
+        float p[3] = {logits[0], logits[1], logits[2]};
+        softmax(p, 3);
+        s_sink += (uint64_t)(p[0] * 1000);
+    });
+    bench("rknn_GetResult", [&]() {
+        float p[3] = {logits[0], logits[1], logits[2]};
+        ClassificationResult r;
+        rknn_GetResult(p, &r);
+        s_sink += r.class_id;
+    });
+    bench("weighted_fusion", [&]() {
+        FusionResult r = weighted_fusion(1.0f, 0.8f);
+        s_sink += r.class_id;
+    });
+
+    // 特征模型：predict() 带调试打印，这里测量其中的推理部分 predict_class()
+    if (access("nn_model.onnx", R_OK) == 0) {
+        svm_model = new SVMModel("nn_model.onnx");
+        float out_logits[3], probs[3];
+        bench(std::string("svm_predict/") + (svm_model->using_native() ? "native" : "dnn"), [&]() {
+            s_sink += svm_model->predict_class(kProbeFeatures, 34, out_logits, probs);
+        });
+    } else {
+        printf("%-36s 跳过：当前目录下没有 nn_model.onnx\n", "svm_predict");
+    }
+
+    // 结果入队：写入线程写到临时目录
+    char dir[] = "/tmp/microbench-XXXXXX";
+    if (mkdtemp(dir)) {
+        ResultWriter::Options writer_opt;
+        writer_opt.path = std::string(dir) + "/results.csv";
+        writer_opt.flush_rows = 64;
+        writer_opt.fsync = false;
+        writer_opt.queue_capacity = 65536;
+        writer_opt.rotate_bytes = 0;
+        writer_opt.rotate_period_s = 0;
+        writer_opt.compress = false;
+        writer_opt.retain_bytes = 0;
+        writer_opt.store_dir = std::string(dir) + "/store";
+        writer_opt.store_segment_bytes = 8 << 20;
+        writer_opt.store_retain_bytes = 64 << 20;
+        if (s_result_writer.start(writer_opt)) {
+            FusionResult res = weighted_fusion(1.0f, 0.8f);
+            RequestTiming timing = {};
+            timing.total_us = 15000;
+            uint64_t id = 0;
+            bench("save_inference_result", [&]() {
+                id++;
+                save_inference_result(res, timing, id, id * 2654435761u);
+            });
+            s_result_writer.stop();
+        }
+        std::string cmd = std::string("rm -rf ") + dir;
+        if (system(cmd.c_str()) != 0) {
+            fprintf(stderr, "未能删除临时目录 %s\n", dir);
+        }
+    }
+
+    if (!s_opt.json_file.empty()) {
+        write_json(s_opt.json_file);
+    }
+    if (!s_opt.baseline.empty() && compare_baseline(s_opt.baseline) > 0) {
+        return 3;
+    }
+    return 0;
+}
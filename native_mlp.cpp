@@ -0,0 +1,672 @@
+#include "native_mlp.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <map>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// ONNX（protobuf线格式）最小解析，只读取求值所需的字段
+// ---------------------------------------------------------------------------
+
+namespace {
+
+struct PbReader {
+    const unsigned char* p;
+    const unsigned char* end;
+    bool ok;
+
+    PbReader(const unsigned char* buf, size_t len) : p(buf), end(buf + len), ok(true) {}
+
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p >= end) break;
+            unsigned char b = *p++;
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        ok = false;
+        return 0;
+    }
+
+    // 读取下一个字段的编号和类型，读完或出错时返回false
+    bool next(uint32_t* field, uint32_t* wire) {
+        if (!ok || p >= end) return false;
+        uint64_t tag = varint();
+        *field = (uint32_t)(tag >> 3);
+        *wire = (uint32_t)(tag & 7);
+        return ok;
+    }
+
+    float f32() {
+        float f = 0.0f;
+        if (end - p < 4) {
+            ok = false;
+            return f;
+        }
+        memcpy(&f, p, 4);  // 板端与主机均为小端
+        p += 4;
+        return f;
+    }
+
+    PbReader bytes() {
+        uint64_t len = varint();
+        if (!ok || len > (uint64_t)(end - p)) {
+            ok = false;
+            return PbReader(end, 0);
+        }
+        PbReader sub(p, (size_t)len);
+        p += len;
+        return sub;
+    }
+
+    std::string str() {
+        PbReader sub = bytes();
+        return std::string((const char*)sub.p, sub.end - sub.p);
+    }
+
+    void skip(uint32_t wire) {
+        switch (wire) {
+        case 0: varint(); break;
+        case 1: if (end - p < 8) ok = false; else p += 8; break;
+        case 2: bytes(); break;
+        case 5: if (end - p < 4) ok = false; else p += 4; break;
+        default: ok = false; break;
+        }
+    }
+};
+
+// ONNX TensorProto.DataType
+const int kOnnxFloat = 1;
+
+} // namespace
+
+struct NativeMLP::Tensor {
+    std::vector<int64_t> dims;
+    std::vector<float> data;  // 仅 FLOAT 类型
+    int data_type = 0;
+    bool external = false;
+
+    size_t numel() const {
+        size_t n = 1;
+        for (size_t i = 0; i < dims.size(); i++) n *= (size_t)dims[i];
+        return n;
+    }
+};
+
+struct NativeMLP::Node {
+    std::string op_type;
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+    std::map<std::string, float> f_attrs;
+    std::map<std::string, int64_t> i_attrs;
+    std::map<std::string, Tensor> t_attrs;
+
+    float attr_f(const char* name, float def) const {
+        std::map<std::string, float>::const_iterator it = f_attrs.find(name);
+        return it == f_attrs.end() ? def : it->second;
+    }
+    int64_t attr_i(const char* name, int64_t def) const {
+        std::map<std::string, int64_t>::const_iterator it = i_attrs.find(name);
+        return it == i_attrs.end() ? def : it->second;
+    }
+};
+
+struct NativeMLP::Graph {
+    std::vector<Node> nodes;
+    std::map<std::string, Tensor> initializers;
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+};
+
+namespace {
+
+bool parse_tensor(PbReader r, NativeMLP::Tensor* t, std::string* name);
+
+// 重复的数值字段既可能是packed（wire=2）也可能逐个出现
+void read_int64s(PbReader* r, uint32_t wire, std::vector<int64_t>* out) {
+    if (wire == 2) {
+        PbReader sub = r->bytes();
+        while (sub.ok && sub.p < sub.end) out->push_back((int64_t)sub.varint());
+        if (!sub.ok) r->ok = false;
+    } else if (wire == 0) {
+        out->push_back((int64_t)r->varint());
+    } else {
+        r->ok = false;
+    }
+}
+
+void read_floats(PbReader* r, uint32_t wire, std::vector<float>* out) {
+    if (wire == 2) {
+        PbReader sub = r->bytes();
+        while (sub.ok && sub.p < sub.end) out->push_back(sub.f32());
+        if (!sub.ok) r->ok = false;
+    } else if (wire == 5) {
+        out->push_back(r->f32());
+    } else {
+        r->ok = false;
+    }
+}
+
+bool parse_tensor(PbReader r, NativeMLP::Tensor* t, std::string* name) {
+    std::string raw;
+    uint32_t field, wire;
+    while (r.next(&field, &wire)) {
+        switch (field) {
+        case 1: read_int64s(&r, wire, &t->dims); break;
+        case 2: t->data_type = (int)r.varint(); break;
+        case 4: read_floats(&r, wire, &t->data); break;
+        case 8: *name = r.str(); break;
+        case 9: raw = r.str(); break;
+        case 14: t->external = r.varint() == 1; break;
+        default: r.skip(wire); break;
+        }
+    }
+    if (!r.ok) return false;
+    if (t->data_type == kOnnxFloat && t->data.empty() && !raw.empty()) {
+        t->data.resize(raw.size() / sizeof(float));
+        memcpy(&t->data[0], raw.data(), t->data.size() * sizeof(float));
+    }
+    return true;
+}
+
+bool parse_attribute(PbReader r, NativeMLP::Node* node) {
+    std::string name;
+    bool has_f = false, has_i = false, has_t = false;
+    float f = 0.0f;
+    int64_t i = 0;
+    NativeMLP::Tensor t;
+    std::string t_name;
+    uint32_t field, wire;
+    while (r.next(&field, &wire)) {
+        switch (field) {
+        case 1: name = r.str(); break;
+        case 2: f = r.f32(); has_f = true; break;
+        case 3: i = (int64_t)r.varint(); has_i = true; break;
+        case 5: has_t = parse_tensor(r.bytes(), &t, &t_name); break;
+        default: r.skip(wire); break;
+        }
+    }
+    if (!r.ok) return false;
+    if (has_f) node->f_attrs[name] = f;
+    if (has_i) node->i_attrs[name] = i;
+    if (has_t) node->t_attrs[name] = t;
+    return true;
+}
+
+bool parse_node(PbReader r, NativeMLP::Node* node) {
+    uint32_t field, wire;
+    while (r.next(&field, &wire)) {
+        switch (field) {
+        case 1: node->inputs.push_back(r.str()); break;
+        case 2: node->outputs.push_back(r.str()); break;
+        case 4: node->op_type = r.str(); break;
+        case 5: if (!parse_attribute(r.bytes(), node)) return false; break;
+        default: r.skip(wire); break;
+        }
+    }
+    return r.ok;
+}
+
+// ValueInfoProto 只需要名字
+std::string parse_value_info_name(PbReader r) {
+    std::string name;
+    uint32_t field, wire;
+    while (r.next(&field, &wire)) {
+        if (field == 1) name = r.str();
+        else r.skip(wire);
+    }
+    return name;
+}
+
+bool parse_graph(PbReader r, NativeMLP::Graph* g) {
+    uint32_t field, wire;
+    while (r.next(&field, &wire)) {
+        switch (field) {
+        case 1: {
+            g->nodes.push_back(NativeMLP::Node());
+            if (!parse_node(r.bytes(), &g->nodes.back())) return false;
+            break;
+        }
+        case 5: {
+            NativeMLP::Tensor t;
+            std::string name;
+            if (!parse_tensor(r.bytes(), &t, &name)) return false;
+            g->initializers[name] = t;
+            break;
+        }
+        case 11: g->inputs.push_back(parse_value_info_name(r.bytes())); break;
+        case 12: g->outputs.push_back(parse_value_info_name(r.bytes())); break;
+        default: r.skip(wire); break;
+        }
+    }
+    return r.ok;
+}
+
+bool fail(std::string* error, const std::string& msg) {
+    if (error) *error = msg;
+    return false;
+}
+
+inline int round4(int n) { return (n + 3) & ~3; }
+
+// ---------------------------------------------------------------------------
+// 计算内核
+// ---------------------------------------------------------------------------
+
+// y[n] = b[n] + W[n,:]·x，W 每行 k_pad 个元素，x 末尾已补零
+void dense_kernel(const float* W, const float* b, const float* x, float* y,
+                  int n_out, int k_pad) {
+    int n = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    // 一次计算4个输出，x 的每次加载被4行复用
+    for (; n + 4 <= n_out; n += 4) {
+        const float* w0 = W + (size_t)n * k_pad;
+        const float* w1 = w0 + k_pad;
+        const float* w2 = w1 + k_pad;
+        const float* w3 = w2 + k_pad;
+        float32x4_t a0 = vdupq_n_f32(0.0f), a1 = a0, a2 = a0, a3 = a0;
+        for (int k = 0; k < k_pad; k += 4) {
+            float32x4_t xv = vld1q_f32(x + k);
+            a0 = vmlaq_f32(a0, vld1q_f32(w0 + k), xv);
+            a1 = vmlaq_f32(a1, vld1q_f32(w1 + k), xv);
+            a2 = vmlaq_f32(a2, vld1q_f32(w2 + k), xv);
+            a3 = vmlaq_f32(a3, vld1q_f32(w3 + k), xv);
+        }
+        float32x2_t s0 = vpadd_f32(vget_low_f32(a0), vget_high_f32(a0));
+        float32x2_t s1 = vpadd_f32(vget_low_f32(a1), vget_high_f32(a1));
+        float32x2_t s2 = vpadd_f32(vget_low_f32(a2), vget_high_f32(a2));
+        float32x2_t s3 = vpadd_f32(vget_low_f32(a3), vget_high_f32(a3));
+        float32x4_t sum = vcombine_f32(vpadd_f32(s0, s1), vpadd_f32(s2, s3));
+        vst1q_f32(y + n, vaddq_f32(sum, vld1q_f32(b + n)));
+    }
+#elif defined(__SSE__)
+    for (; n + 4 <= n_out; n += 4) {
+        const float* w0 = W + (size_t)n * k_pad;
+        const float* w1 = w0 + k_pad;
+        const float* w2 = w1 + k_pad;
+        const float* w3 = w2 + k_pad;
+        __m128 a0 = _mm_setzero_ps(), a1 = a0, a2 = a0, a3 = a0;
+        for (int k = 0; k < k_pad; k += 4) {
+            __m128 xv = _mm_loadu_ps(x + k);
+            a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(w0 + k), xv));
+            a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_loadu_ps(w1 + k), xv));
+            a2 = _mm_add_ps(a2, _mm_mul_ps(_mm_loadu_ps(w2 + k), xv));
+            a3 = _mm_add_ps(a3, _mm_mul_ps(_mm_loadu_ps(w3 + k), xv));
+        }
+        // 4x4转置后逐列相加即为4个行和
+        _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+        __m128 sum = _mm_add_ps(_mm_add_ps(a0, a1), _mm_add_ps(a2, a3));
+        _mm_storeu_ps(y + n, _mm_add_ps(sum, _mm_loadu_ps(b + n)));
+    }
+#endif
+    for (; n < n_out; n++) {
+        const float* w = W + (size_t)n * k_pad;
+        float acc = 0.0f;
+        for (int k = 0; k < k_pad; k++) acc += w[k] * x[k];
+        y[n] = b[n] + acc;
+    }
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// NativeMLP
+// ---------------------------------------------------------------------------
+
+size_t NativeMLP::push_weights(const float* data, size_t n) {
+    size_t off = weights_.size();
+    weights_.insert(weights_.end(), data, data + n);
+    return off;
+}
+
+bool NativeMLP::load(const std::string& path, std::string* error) {
+    layers_.clear();
+    weights_.clear();
+    input_size_ = output_size_ = 0;
+
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) return fail(error, "无法打开 " + path);
+    std::vector<unsigned char> buf;
+    unsigned char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        buf.insert(buf.end(), chunk, chunk + n);
+    }
+    fclose(fp);
+    if (buf.empty()) return fail(error, "模型文件为空");
+
+    // ModelProto.graph = 7
+    Graph graph;
+    bool has_graph = false;
+    PbReader r(&buf[0], buf.size());
+    uint32_t field, wire;
+    while (r.next(&field, &wire)) {
+        if (field == 7) {
+            if (!parse_graph(r.bytes(), &graph)) return fail(error, "GraphProto 解析失败");
+            has_graph = true;
+        } else {
+            r.skip(wire);
+        }
+    }
+    if (!r.ok || !has_graph) return fail(error, "ModelProto 解析失败");
+
+    if (!compile(graph, error)) {
+        layers_.clear();
+        weights_.clear();
+        return false;
+    }
+    return true;
+}
+
+// 把链式计算图编译为层序列；相邻的逐通道仿射会折叠进前一层
+bool NativeMLP::compile(const Graph& g, std::string* error) {
+    std::map<std::string, const Tensor*> consts;
+    for (std::map<std::string, Tensor>::const_iterator it = g.initializers.begin();
+         it != g.initializers.end(); ++it) {
+        if (it->second.external) return fail(error, "不支持外部存储的权重: " + it->first);
+        consts[it->first] = &it->second;
+    }
+
+    // 激活输入是第一个不属于initializer的图输入
+    std::string cur;
+    for (size_t i = 0; i < g.inputs.size(); i++) {
+        if (!consts.count(g.inputs[i])) {
+            cur = g.inputs[i];
+            break;
+        }
+    }
+    if (cur.empty() || g.outputs.size() != 1) return fail(error, "模型须为单输入单输出");
+
+    int width = -1;
+    for (size_t ni = 0; ni < g.nodes.size(); ni++) {
+        const Node& node = g.nodes[ni];
+        const std::string& op = node.op_type;
+
+        if (op == "Constant") {
+            std::map<std::string, Tensor>::const_iterator it = node.t_attrs.find("value");
+            if (it == node.t_attrs.end() || node.outputs.empty()) {
+                return fail(error, "不支持的 Constant 节点");
+            }
+            consts[node.outputs[0]] = &it->second;
+            continue;
+        }
+
+        // 只支持链式结构：每个节点恰好有一个来自上一节点的激活输入
+        int act = -1;
+        std::vector<const Tensor*> params(node.inputs.size(), (const Tensor*)NULL);
+        for (size_t i = 0; i < node.inputs.size(); i++) {
+            if (node.inputs[i].empty()) continue;
+            std::map<std::string, const Tensor*>::const_iterator it = consts.find(node.inputs[i]);
+            if (it != consts.end()) {
+                params[i] = it->second;
+                continue;
+            }
+            if (node.inputs[i] != cur || act >= 0) return fail(error, "非链式结构: " + op);
+            act = (int)i;
+        }
+        if (act < 0 || node.outputs.empty()) return fail(error, "节点缺少激活输入: " + op);
+        for (size_t i = 0; i < params.size(); i++) {
+            if (params[i] && op != "Reshape" &&
+                (params[i]->data_type != kOnnxFloat || params[i]->data.size() != params[i]->numel())) {
+                return fail(error, "仅支持FLOAT权重: " + op);
+            }
+        }
+
+        Layer layer;
+        memset(&layer, 0, sizeof(layer));
+        layer.in = layer.out = width;
+
+        if (op == "Gemm" || op == "MatMul") {
+            bool gemm = op == "Gemm";
+            const Tensor* B = params.size() > 1 ? params[1] : NULL;
+            if (act != 0 || !B || B->dims.size() != 2) return fail(error, op + " 的权重须为常量矩阵");
+            if (gemm && node.attr_i("transA", 0)) return fail(error, "不支持 Gemm transA");
+            bool transB = gemm && node.attr_i("transB", 0);
+            float alpha = gemm ? node.attr_f("alpha", 1.0f) : 1.0f;
+            float beta = gemm ? node.attr_f("beta", 1.0f) : 1.0f;
+            int K = (int)(transB ? B->dims[1] : B->dims[0]);
+            int N = (int)(transB ? B->dims[0] : B->dims[1]);
+            if (width >= 0 && width != K) return fail(error, op + " 输入宽度不匹配");
+            if (N > kMaxWidth || K > kMaxWidth) return fail(error, op + " 超出最大宽度");
+
+            layer.kind = kDense;
+            layer.in = K;
+            layer.out = N;
+            layer.k_pad = round4(K);
+            layer.w_off = weights_.size();
+            weights_.resize(weights_.size() + (size_t)N * layer.k_pad, 0.0f);
+            float* W = &weights_[layer.w_off];
+            for (int n = 0; n < N; n++) {
+                for (int k = 0; k < K; k++) {
+                    float w = transB ? B->data[(size_t)n * K + k] : B->data[(size_t)k * N + n];
+                    W[(size_t)n * layer.k_pad + k] = alpha * w;
+                }
+            }
+            layer.b_off = weights_.size();
+            weights_.resize(weights_.size() + N, 0.0f);
+            const Tensor* C = gemm && params.size() > 2 ? params[2] : NULL;
+            if (C) {
+                size_t cn = C->numel();
+                if (cn != 1 && cn != (size_t)N) return fail(error, "Gemm 偏置形状不支持");
+                for (int n = 0; n < N; n++) {
+                    weights_[layer.b_off + n] = beta * C->data[cn == 1 ? 0 : n];
+                }
+            }
+            layers_.push_back(layer);
+            width = N;
+        } else if (op == "Add" || op == "Sub" || op == "Mul" || op == "Div" ||
+                   op == "BatchNormalization") {
+            std::vector<float> a, b;
+            if (op == "BatchNormalization") {
+                if (act != 0 || params.size() < 5 || !params[1] || !params[2] || !params[3] || !params[4]) {
+                    return fail(error, "BatchNormalization 参数不完整");
+                }
+                size_t cn = params[1]->numel();
+                if (width >= 0 && (size_t)width != cn) return fail(error, "BatchNormalization 通道数不匹配");
+                width = (int)cn;
+                float eps = node.attr_f("epsilon", 1e-5f);
+                a.resize(cn);
+                b.resize(cn);
+                for (size_t i = 0; i < cn; i++) {
+                    a[i] = params[1]->data[i] / sqrtf(params[4]->data[i] + eps);
+                    b[i] = params[2]->data[i] - params[3]->data[i] * a[i];
+                }
+            } else {
+                const Tensor* c = params[act == 0 ? 1 : 0];
+                if (node.inputs.size() != 2 || !c) return fail(error, op + " 须有一个常量操作数");
+                size_t cn = c->numel();
+                if (cn != 1) {
+                    if (width >= 0 && (size_t)width != cn) return fail(error, op + " 广播形状不支持");
+                    width = (int)cn;
+                }
+                if (width < 0) return fail(error, op + " 无法确定输入宽度");
+                a.assign(width, 1.0f);
+                b.assign(width, 0.0f);
+                for (int i = 0; i < width; i++) {
+                    float v = c->data[cn == 1 ? 0 : i];
+                    if (op == "Add") {
+                        b[i] = v;
+                    } else if (op == "Sub") {
+                        if (act == 0) b[i] = -v;
+                        else { a[i] = -1.0f; b[i] = v; }
+                    } else if (op == "Mul") {
+                        a[i] = v;
+                    } else {
+                        if (act != 0) return fail(error, "不支持常量除以激活值");
+                        a[i] = 1.0f / v;
+                    }
+                }
+            }
+            if (width > kMaxWidth) return fail(error, op + " 超出最大宽度");
+
+            // 折叠进前一个 Dense/ScaleShift 层
+            Layer* prev = layers_.empty() ? NULL : &layers_.back();
+            if (prev && prev->kind == kDense && prev->out == width) {
+                for (int n = 0; n < width; n++) {
+                    float* row = &weights_[prev->w_off + (size_t)n * prev->k_pad];
+                    for (int k = 0; k < prev->in; k++) row[k] *= a[n];
+                    float& bias = weights_[prev->b_off + n];
+                    bias = bias * a[n] + b[n];
+                }
+            } else if (prev && prev->kind == kScaleShift && prev->out == width) {
+                for (int n = 0; n < width; n++) {
+                    float& pa = weights_[prev->w_off + n];
+                    float& pb = weights_[prev->b_off + n];
+                    pa *= a[n];
+                    pb = pb * a[n] + b[n];
+                }
+            } else {
+                layer.kind = kScaleShift;
+                layer.in = layer.out = width;
+                layer.w_off = push_weights(&a[0], a.size());
+                layer.b_off = push_weights(&b[0], b.size());
+                layers_.push_back(layer);
+            }
+        } else if (op == "Relu" || op == "LeakyRelu" || op == "Sigmoid" || op == "Tanh" ||
+                   op == "Clip" || op == "Softmax") {
+            if (width < 0) return fail(error, op + " 无法确定输入宽度");
+            if (op == "Relu") {
+                layer.kind = kRelu;
+            } else if (op == "LeakyRelu") {
+                layer.kind = kLeakyRelu;
+                layer.alpha = node.attr_f("alpha", 0.01f);
+            } else if (op == "Sigmoid") {
+                layer.kind = kSigmoid;
+            } else if (op == "Tanh") {
+                layer.kind = kTanh;
+            } else if (op == "Clip") {
+                // opset 11 起 min/max 作为常量输入，之前为属性
+                layer.kind = kClip;
+                layer.alpha = node.attr_f("min", -INFINITY);
+                layer.beta = node.attr_f("max", INFINITY);
+                if (params.size() > 1 && params[1]) layer.alpha = params[1]->data[0];
+                if (params.size() > 2 && params[2]) layer.beta = params[2]->data[0];
+            } else {
+                int64_t axis = node.attr_i("axis", -1);
+                if (axis != 1 && axis != -1) return fail(error, "Softmax 仅支持最后一维");
+                layer.kind = kSoftmax;
+            }
+            layers_.push_back(layer);
+        } else if (op == "Identity" || op == "Dropout" || op == "Flatten" || op == "Reshape" ||
+                   op == "Squeeze" || op == "Unsqueeze") {
+            // 对 1xN 向量不改变数据
+            if (act != 0) return fail(error, op + " 输入顺序不支持");
+        } else {
+            return fail(error, "不支持的算子: " + op);
+        }
+
+        cur = node.outputs[0];
+    }
+
+    if (cur != g.outputs[0]) return fail(error, "输出节点不在计算链上");
+    if (layers_.empty()) return fail(error, "模型不含可计算的层");
+    input_size_ = layers_.front().in;
+    output_size_ = layers_.back().out;
+    return true;
+}
+
+// 计算一层：Dense 输出到 y 后交换 x/y，逐元素层在 x 上原地计算
+void NativeMLP::step(const Layer& L, float*& x, float*& y) const {
+    const float* w = weights_.empty() ? NULL : &weights_[0];
+    int width = L.out;
+    switch (L.kind) {
+    case kDense: {
+        dense_kernel(w + L.w_off, w + L.b_off, x, y, L.out, L.k_pad);
+        float* t = x;
+        x = y;
+        y = t;
+        break;
+    }
+    case kScaleShift: {
+        const float* a = w + L.w_off;
+        const float* b = w + L.b_off;
+        for (int i = 0; i < width; i++) x[i] = x[i] * a[i] + b[i];
+        break;
+    }
+    case kRelu:
+        for (int i = 0; i < width; i++) x[i] = x[i] > 0.0f ? x[i] : 0.0f;
+        break;
+    case kLeakyRelu:
+        for (int i = 0; i < width; i++) x[i] = x[i] > 0.0f ? x[i] : x[i] * L.alpha;
+        break;
+    case kSigmoid:
+        for (int i = 0; i < width; i++) x[i] = 1.0f / (1.0f + expf(-x[i]));
+        break;
+    case kTanh:
+        for (int i = 0; i < width; i++) x[i] = tanhf(x[i]);
+        break;
+    case kClip:
+        for (int i = 0; i < width; i++) {
+            x[i] = x[i] < L.alpha ? L.alpha : (x[i] > L.beta ? L.beta : x[i]);
+        }
+        break;
+    case kSoftmax: {
+        float max_val = x[0];
+        for (int i = 1; i < width; i++) if (x[i] > max_val) max_val = x[i];
+        float sum = 0.0f;
+        for (int i = 0; i < width; i++) {
+            x[i] = expf(x[i] - max_val);
+            sum += x[i];
+        }
+        for (int i = 0; i < width; i++) x[i] /= sum;
+        break;
+    }
+    }
+    // 下一个 Dense 按4对齐读取，补零
+    for (int i = width; i < round4(width); i++) x[i] = 0.0f;
+}
+
+bool NativeMLP::run(const float* in, size_t n, float* out) const {
+    if (layers_.empty() || n != (size_t)input_size_) return false;
+
+    // 两块乒乓缓冲区，Dense 输出到另一块，逐元素层原地计算
+    float buf[2][kMaxWidth];
+    float* x = buf[0];
+    float* y = buf[1];
+    memcpy(x, in, n * sizeof(float));
+    for (int i = (int)n; i < round4((int)n); i++) x[i] = 0.0f;
+
+    for (size_t li = 0; li < layers_.size(); li++) {
+        step(layers_[li], x, y);
+    }
+
+    memcpy(out, x, output_size_ * sizeof(float));
+    return true;
+}
+
+bool NativeMLP::run_batch(const float* in, size_t rows, size_t n, float* out) const {
+    if (layers_.empty() || n != (size_t)input_size_) return false;
+
+    // 每次取 kBatchTile 个样本按层推进，一层的权重在处理这组样本期间留在缓存中
+    float buf[kBatchTile][2][kMaxWidth];
+    float* x[kBatchTile];
+    float* y[kBatchTile];
+    for (size_t base = 0; base < rows; base += kBatchTile) {
+        int tile = (int)std::min(rows - base, (size_t)kBatchTile);
+        for (int r = 0; r < tile; r++) {
+            x[r] = buf[r][0];
+            y[r] = buf[r][1];
+            memcpy(x[r], in + (base + r) * n, n * sizeof(float));
+            for (int i = (int)n; i < round4((int)n); i++) x[r][i] = 0.0f;
+        }
+        for (size_t li = 0; li < layers_.size(); li++) {
+            for (int r = 0; r < tile; r++) {
+                step(layers_[li], x[r], y[r]);
+            }
+        }
+        for (int r = 0; r < tile; r++) {
+            memcpy(out + (base + r) * output_size_, x[r], output_size_ * sizeof(float));
+        }
+    }
+    return true;
+}
@@ -0,0 +1,75 @@
+#ifndef _NATIVE_MLP_H
+#define _NATIVE_MLP_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// 血常规特征模型（nn_model.onnx）的原生求值器
+// 直接解析ONNX中的 Gemm/MatMul/Add/Relu 等节点，权重存放在一块连续内存中，
+// run()/run_batch() 只使用栈上缓冲区，不分配堆内存；遇到不支持的算子时 load() 失败，
+// 由调用方回退到 cv::dnn。
+class NativeMLP {
+public:
+    // 单层最大宽度，超过则视为不支持（run() 的栈缓冲区按此分配）
+    static const int kMaxWidth = 1024;
+    // run_batch() 每次按层推进的样本数
+    static const int kBatchTile = 8;
+
+    NativeMLP() : input_size_(0), output_size_(0) {}
+
+    // 加载ONNX模型，失败时 error 中给出原因
+    bool load(const std::string& path, std::string* error);
+
+    bool loaded() const { return !layers_.empty(); }
+    int input_size() const { return input_size_; }
+    int output_size() const { return output_size_; }
+    size_t layer_count() const { return layers_.size(); }
+    size_t weight_bytes() const { return weights_.size() * sizeof(float); }
+
+    // in 含 input_size() 个元素，out 至少 output_size() 个元素
+    bool run(const float* in, size_t n, float* out) const;
+
+    // rows 个样本连续存放（每个 n 个元素），out 依次写入各样本的 output_size() 个输出；
+    // 结果与逐个 run() 相同
+    bool run_batch(const float* in, size_t rows, size_t n, float* out) const;
+
+    // ONNX解析用的中间结构，仅在实现文件中定义
+    struct Tensor;
+    struct Node;
+    struct Graph;
+
+private:
+    enum LayerKind {
+        kDense,       // y = W·x + b，W按输出行连续存放，行长度补齐到4的倍数
+        kScaleShift,  // y = x * a + b（逐通道）
+        kRelu,
+        kLeakyRelu,
+        kSigmoid,
+        kTanh,
+        kClip,
+        kSoftmax
+    };
+
+    struct Layer {
+        LayerKind kind;
+        int in;        // 输入宽度
+        int out;       // 输出宽度
+        int k_pad;     // kDense: 补齐后的行长度
+        size_t w_off;  // kDense: W / kScaleShift: a
+        size_t b_off;  // kDense/kScaleShift: b
+        float alpha;   // kLeakyRelu 斜率 / kClip 下限
+        float beta;    // kClip 上限
+    };
+
+    bool compile(const Graph& graph, std::string* error);
+    void step(const Layer& L, float*& x, float*& y) const;
+    size_t push_weights(const float* data, size_t n);
+
+    std::vector<Layer> layers_;
+    std::vector<float> weights_;  // 所有层参数的连续存储
+    int input_size_;
+    int output_size_;
+};
+
+#endif // _NATIVE_MLP_H
@@ -0,0 +1,175 @@
+#include "near_dup_cache.h"
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+static uint64_t steady_ms() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t perceptual_hash(const cv::Mat &img) {
+    cv::Mat gray, small, pixels, coeffs;
+    if (img.channels() == 3) {
+        cv::cvtColor(img, gray, cv::COLOR_BGR2GRAY);
+    } else {
+        gray = img;
+    }
+    cv::resize(gray, small, cv::Size(32, 32), 0, 0, cv::INTER_AREA);
+    small.convertTo(pixels, CV_32F);
+    cv::dct(pixels, coeffs);
+
+    float low[64];
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            low[y * 8 + x] = coeffs.at<float>(y, x);
+        }
+    }
+    // 中位数不含直流分量（整体亮度）
+    float sorted[63];
+    std::copy(low + 1, low + 64, sorted);
+    std::nth_element(sorted, sorted + 31, sorted + 63);
+    float median = sorted[31];
+
+    uint64_t hash = 0;
+    for (int i = 1; i < 64; i++) {
+        if (low[i] > median) hash |= 1ULL << i;
+    }
+    return hash;
+}
+
+NearDupCache::NearDupCache()
+    : next_(0), max_distance_(0), chunks_(1), ttl_ms_(0), version_(0),
+      lookups_(0), hits_(0), candidates_(0) {
+    for (int i = 0; i <= kMaxDistance; i++) {
+        chunk_bits_[i] = 0;
+        chunk_shift_[i] = 0;
+        hit_distance_[i] = 0;
+    }
+}
+
+void NearDupCache::configure(size_t capacity, int max_distance, uint64_t ttl_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_distance_ = std::max(0, std::min(max_distance, (int)kMaxDistance));
+    chunks_ = max_distance_ + 1;
+    // 64位尽量均分到各段
+    int shift = 0;
+    for (int i = 0; i < chunks_; i++) {
+        chunk_bits_[i] = 64 / chunks_ + (i < 64 % chunks_ ? 1 : 0);
+        chunk_shift_[i] = shift;
+        shift += chunk_bits_[i];
+    }
+    ttl_ms_ = ttl_ms;
+    slots_.assign(capacity, Slot());
+    for (size_t i = 0; i < slots_.size(); i++) slots_[i].used = false;
+    next_ = 0;
+    tables_.assign(chunks_, std::unordered_map<uint64_t, std::vector<uint32_t> >());
+}
+
+uint64_t NearDupCache::chunk(uint64_t hash, int i) const {
+    int bits = chunk_bits_[i];
+    uint64_t mask = bits >= 64 ? ~0ULL : ((1ULL << bits) - 1);
+    return (hash >> chunk_shift_[i]) & mask;
+}
+
+void NearDupCache::set_model_version(uint64_t version) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    version_ = version;  // 旧版本条目在 lookup 中跳过，随写入逐步覆盖
+}
+
+void NearDupCache::unlink_slot(uint32_t slot) {
+    const Slot &s = slots_[slot];
+    for (int i = 0; i < chunks_; i++) {
+        auto it = tables_[i].find(chunk(s.hash, i));
+        if (it == tables_[i].end()) continue;
+        std::vector<uint32_t> &ids = it->second;
+        ids.erase(std::remove(ids.begin(), ids.end(), slot), ids.end());
+        if (ids.empty()) tables_[i].erase(it);
+    }
+}
+
+bool NearDupCache::lookup(uint64_t hash, int *class_id, float *probability, float *probs,
+                          int *distance) {
+    if (!enabled()) return false;
+    lookups_++;
+    uint64_t now = ttl_ms_ > 0 ? steady_ms() : 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    int best = -1;
+    int best_distance = max_distance_ + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < chunks_ && best_distance > 0; i++) {
+        auto it = tables_[i].find(chunk(hash, i));
+        if (it == tables_[i].end()) continue;
+        const std::vector<uint32_t> &ids = it->second;
+        for (size_t k = 0; k < ids.size(); k++) {
+            const Slot &s = slots_[ids[k]];
+            seen++;
+            if (s.version != version_ || (ttl_ms_ > 0 && now - s.inserted_ms > ttl_ms_)) {
+                continue;
+            }
+            int d = __builtin_popcountll(s.hash ^ hash);
+            if (d < best_distance) {
+                best_distance = d;
+                best = (int)ids[k];
+            }
+        }
+    }
+    candidates_ += seen;
+    if (best < 0) return false;
+    hits_++;
+    hit_distance_[best_distance]++;
+    *class_id = slots_[best].class_id;
+    *probability = slots_[best].probability;
+    memcpy(probs, slots_[best].probs, sizeof(slots_[best].probs));
+    *distance = best_distance;
+    return true;
+}
+
+void NearDupCache::insert(uint64_t hash, int class_id, float probability, const float *probs) {
+    if (!enabled()) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t slot = (uint32_t)next_;
+    next_ = (next_ + 1) % slots_.size();
+    if (slots_[slot].used) {
+        unlink_slot(slot);
+    }
+    Slot &s = slots_[slot];
+    s.hash = hash;
+    s.version = version_;
+    s.inserted_ms = steady_ms();
+    s.class_id = class_id;
+    s.probability = probability;
+    memcpy(s.probs, probs, sizeof(s.probs));
+    s.used = true;
+    for (int i = 0; i < chunks_; i++) {
+        tables_[i][chunk(hash, i)].push_back(slot);
+    }
+}
+
+void NearDupCache::write_metrics(JsonWriter &w) const {
+    uint64_t lookups = lookups_.load();
+    uint64_t hits = hits_.load();
+    size_t used = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < slots_.size(); i++) {
+            if (slots_[i].used) used++;
+        }
+    }
+    w.begin_object("near_dup");
+    w.field("enabled", enabled());
+    w.field("entries", (uint64_t)used);
+    w.field("capacity", (uint64_t)slots_.size());
+    w.field("max_distance", (uint64_t)max_distance_);
+    w.field("lookups", lookups);
+    w.field("hits", hits);
+    w.field("hit_ratio", lookups ? (double)hits / lookups : 0.0);
+    w.field("avg_candidates", lookups ? (double)candidates_.load() / lookups : 0.0);
+    w.begin_array("hits_by_distance");
+    for (int i = 0; i <= max_distance_; i++) {
+        w.field(nullptr, (uint64_t)hit_distance_[i].load());
+    }
+    w.end_array();
+    w.end_object();
+}
@@ -0,0 +1,75 @@
+#ifndef _NEAR_DUP_CACHE_H
+#define _NEAR_DUP_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+#include "metrics.h"
+#include "result_store.h"
+
+// 64位感知哈希（pHash）：灰度缩放到32x32后做DCT，取左上8x8低频系数（去掉直流分量）
+// 与中位数比较得到各位。同一图像以不同JPEG质量或尺寸重新编码后汉明距离很小。
+uint64_t perceptual_hash(const cv::Mat &img);
+
+// 近似重复图像的RKNN结果缓存
+// 按多索引哈希（multi-index hashing）组织：64位哈希切成 max_distance+1 段，
+// 由抽屉原理，距离不超过 max_distance 的两个哈希至少有一段完全相同，
+// 因此只需在各段的桶中找候选再计算完整汉明距离。
+// 条目放在定长环形数组中，写满后覆盖最早的条目。多个线程可并发访问。
+class NearDupCache {
+public:
+    static const int kMaxDistance = 15;
+
+    NearDupCache();
+
+    // capacity 为0时关闭；ttl_ms 为0表示不过期
+    void configure(size_t capacity, int max_distance, uint64_t ttl_ms);
+    bool enabled() const { return !slots_.empty(); }
+
+    // 模型版本变化时已有条目全部失效
+    void set_model_version(uint64_t version);
+
+    // 找到距离最近且不超过 max_distance 的条目时返回 true；probs 为 kResultClasses 个类别概率
+    bool lookup(uint64_t hash, int *class_id, float *probability, float *probs, int *distance);
+    void insert(uint64_t hash, int class_id, float probability, const float *probs);
+
+    void write_metrics(JsonWriter &w) const;
+
+private:
+    struct Slot {
+        uint64_t hash;
+        uint64_t version;
+        uint64_t inserted_ms;
+        int class_id;
+        float probability;
+        float probs[kResultClasses];
+        bool used;
+    };
+
+    uint64_t chunk(uint64_t hash, int i) const;
+    void unlink_slot(uint32_t slot);
+
+    mutable std::mutex mutex_;
+    std::vector<Slot> slots_;
+    size_t next_;  // 下一个写入位置
+    int max_distance_;
+    int chunks_;
+    int chunk_bits_[kMaxDistance + 1];
+    int chunk_shift_[kMaxDistance + 1];
+    uint64_t ttl_ms_;
+    uint64_t version_;
+    // 每段一张表：段值 -> 槽位列表
+    std::vector<std::unordered_map<uint64_t, std::vector<uint32_t> > > tables_;
+
+    std::atomic<uint64_t> lookups_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> candidates_;
+    std::atomic<uint64_t> hit_distance_[kMaxDistance + 1];
+};
+
+#endif // _NEAR_DUP_CACHE_H
@@ -0,0 +1,143 @@
+#include "npu_batcher.h"
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+static double steady_us() {
+    return std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+NpuBatcher::NpuBatcher(int max_batch, int window_us, size_t input_bytes, RunBatch run)
+    : max_batch_(std::max(1, std::min(max_batch, (int)kMaxBatch))),
+      window_us_(std::max(0, window_us)),
+      input_bytes_(input_bytes),
+      run_batch_(run),
+      stop_(false),
+      failures_(0) {
+    batch_buf_.assign(input_bytes_ * max_batch_, 0);
+    thread_ = std::thread(&NpuBatcher::run, this);
+}
+
+NpuBatcher::~NpuBatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    queue_cv_.notify_all();
+    thread_.join();
+}
+
+NpuBatchOutput NpuBatcher::submit(const uint8_t *input, double *wait_us, double *run_us,
+                                  int *fill) {
+    Pending p;
+    p.input = input;
+    p.enqueued_us = steady_us();
+    p.out.class_id = 0;
+    p.out.probability = 0.0f;
+    memset(p.out.probs, 0, sizeof(p.out.probs));
+    p.out.ok = false;
+    p.wait_us = 0;
+    p.run_us = 0;
+    p.fill = 0;
+    p.done = false;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    queue_.push_back(&p);
+    if (queue_.size() == 1 || (int)queue_.size() >= max_batch_) {
+        queue_cv_.notify_one();
+    }
+    done_cv_.wait(lock, [&p]() { return p.done; });
+    *wait_us = p.wait_us;
+    *run_us = p.run_us;
+    *fill = p.fill;
+    return p.out;
+}
+
+void NpuBatcher::run() {
+    std::vector<Pending *> batch;
+    std::vector<NpuBatchOutput> outputs(max_batch_);
+    for (;;) {
+        batch.clear();
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) return;  // stop_
+
+            // 从第一个输入入队起最多等 window_us，凑满一批立即执行
+            auto deadline = std::chrono::steady_clock::now() +
+                std::chrono::microseconds((int64_t)std::max(
+                    0.0, window_us_ - (steady_us() - queue_.front()->enqueued_us)));
+            while ((int)queue_.size() < max_batch_ && !stop_) {
+                if (queue_cv_.wait_until(lock, deadline) == std::cv_status::timeout) break;
+            }
+            int n = std::min((int)queue_.size(), max_batch_);
+            batch.assign(queue_.begin(), queue_.begin() + n);
+            queue_.erase(queue_.begin(), queue_.begin() + n);
+        }
+
+        int n = (int)batch.size();
+        double start = steady_us();
+        for (int i = 0; i < n; i++) {
+            memcpy(&batch_buf_[i * input_bytes_], batch[i]->input, input_bytes_);
+        }
+        if (n < max_batch_) {
+            // 补零，避免上一批的残留数据参与计算
+            memset(&batch_buf_[n * input_bytes_], 0, (max_batch_ - n) * input_bytes_);
+        }
+        for (int i = 0; i < n; i++) {
+            outputs[i].ok = false;
+        }
+        if (!run_batch_(batch_buf_.data(), n, outputs.data())) {
+            failures_++;
+        }
+        double end = steady_us();
+
+        by_size_[n].run.record(end - start);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int i = 0; i < n; i++) {
+                Pending *p = batch[i];
+                p->out = outputs[i];
+                p->wait_us = start - p->enqueued_us;
+                p->run_us = end - start;
+                p->fill = n;
+                p->done = true;
+                by_size_[n].wait.record(p->wait_us);
+            }
+        }
+        done_cv_.notify_all();
+    }
+}
+
+void NpuBatcher::write_metrics(JsonWriter &w) const {
+    uint64_t batches = 0, items = 0;
+    for (int n = 1; n <= max_batch_; n++) {
+        uint64_t b = by_size_[n].run.count.load();
+        batches += b;
+        items += b * n;
+    }
+    w.begin_object("npu_batch");
+    w.field("max_batch", (uint64_t)max_batch_);
+    w.field("window_us", (uint64_t)window_us_);
+    w.field("batches", batches);
+    w.field("items", items);
+    w.field("avg_fill", batches ? (double)items / batches : 0.0);
+    w.field("failures", (uint64_t)failures_.load());
+    // 各批次大小：批次推理耗时、组批等待耗时与摊到每个输入的推理耗时
+    w.begin_array("by_size");
+    for (int n = 1; n <= max_batch_; n++) {
+        const SizeStat &s = by_size_[n];
+        if (s.run.count.load() == 0) continue;
+        w.begin_object();
+        w.field("size", (uint64_t)n);
+        w.field("batches", (uint64_t)s.run.count.load());
+        w.field("avg_run_us", s.run.avg_us());
+        w.field("avg_wait_us", s.wait.avg_us());
+        w.field("per_item_us", s.run.avg_us() / n);
+        w.end_object();
+    }
+    w.end_array();
+    w.end_object();
+}
@@ -0,0 +1,83 @@
+#ifndef _NPU_BATCHER_H
+#define _NPU_BATCHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "metrics.h"
+#include "result_store.h"
+
+// 批内单个输入的分类结果
+struct NpuBatchOutput {
+    int class_id;
+    float probability;
+    float probs[kResultClasses];  // 各类别概率
+    bool ok;
+};
+
+// NPU动态微批处理
+// 请求线程提交预处理后的输入并阻塞等待；批处理线程攒够 max_batch 个输入、
+// 或第一个输入已等待 window_us 后，把它们拼成一个批次（不足部分补零）调用一次 run，
+// 再把各自的结果交回对应的请求线程。
+class NpuBatcher {
+public:
+    // input 为 max_batch 个输入连续存放，前 count 个有效；结果写入 results[0..count)
+    typedef std::function<bool(const uint8_t *input, int count, NpuBatchOutput *results)> RunBatch;
+
+    static const int kMaxBatch = 32;
+
+    NpuBatcher(int max_batch, int window_us, size_t input_bytes, RunBatch run);
+    ~NpuBatcher();
+
+    int max_batch() const { return max_batch_; }
+
+    // 阻塞到所在批次完成；wait_us 为排队等待组批的时间，run_us 为批次推理时间，
+    // fill 为批次中的有效输入数
+    NpuBatchOutput submit(const uint8_t *input, double *wait_us, double *run_us, int *fill);
+
+    void write_metrics(JsonWriter &w) const;
+
+private:
+    struct Pending {
+        const uint8_t *input;
+        double enqueued_us;
+        NpuBatchOutput out;
+        double wait_us;
+        double run_us;
+        int fill;
+        bool done;
+    };
+
+    // 按批次有效个数分别统计，用于观察延迟与吞吐的取舍
+    struct SizeStat {
+        LatencyStat run;   // 批次推理时间
+        LatencyStat wait;  // 批内各请求的组批等待时间
+    };
+
+    void run();
+
+    int max_batch_;
+    int window_us_;
+    size_t input_bytes_;
+    RunBatch run_batch_;
+    std::vector<uint8_t> batch_buf_;  // 仅批处理线程访问
+
+    std::mutex mutex_;
+    std::condition_variable queue_cv_;  // 有新输入
+    std::condition_variable done_cv_;   // 有批次完成
+    std::deque<Pending *> queue_;
+    bool stop_;
+    std::thread thread_;
+
+    SizeStat by_size_[kMaxBatch + 1];
+    std::atomic<uint64_t> failures_;
+};
+
+#endif // _NPU_BATCHER_H
@@ -0,0 +1,68 @@
+#include "onnx_backend.h"
+
+#include <stdio.h>
+
+OnnxBackend::OnnxBackend(const Options &opt) : opt_(opt) {}
+
+bool OnnxBackend::load(const std::string &model_path, std::string *error) {
+    try {
+        net_ = cv::dnn::readNetFromONNX(model_path);
+        net_.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+        net_.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+    } catch (const cv::Exception &e) {
+        *error = e.what();
+        return false;
+    }
+    if (net_.empty()) {
+        *error = "无法加载 " + model_path;
+        return false;
+    }
+    return true;
+}
+
+bool OnnxBackend::query(BackendAttrs *attrs) {
+    attrs->width = opt_.width;
+    attrs->height = opt_.height;
+    attrs->batch = 1;
+    attrs->n_outputs = 1;
+    return true;
+}
+
+bool OnnxBackend::set_input(const uint8_t *data, size_t bytes) {
+    if (bytes != (size_t)opt_.width * opt_.height * 3) {
+        fprintf(stderr, "ONNX输入大小 %zu 与模型尺寸 %dx%d 不符\n", bytes, opt_.width, opt_.height);
+        return false;
+    }
+    cv::Mat img(opt_.height, opt_.width, CV_8UC3, (void *)data);
+    cv::Mat rgb, input;
+    if (opt_.swap_rb) {
+        cv::cvtColor(img, rgb, cv::COLOR_BGR2RGB);
+    } else {
+        rgb = img;
+    }
+    rgb.convertTo(input, CV_32FC3);
+    input -= cv::Scalar(opt_.mean[0], opt_.mean[1], opt_.mean[2]);
+    cv::divide(input, cv::Scalar(opt_.std[0], opt_.std[1], opt_.std[2]), input);
+    blob_ = cv::dnn::blobFromImage(input);
+    return true;
+}
+
+bool OnnxBackend::run() {
+    try {
+        net_.setInput(blob_);
+        output_ = net_.forward();
+    } catch (const cv::Exception &e) {
+        fprintf(stderr, "CPU推理失败: %s\n", e.what());
+        return false;
+    }
+    return true;
+}
+
+bool OnnxBackend::get_outputs(const float **data, size_t *count) {
+    if (output_.empty()) {
+        return false;
+    }
+    *data = output_.ptr<float>();
+    *count = output_.total();
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef _ONNX_BACKEND_H
+#define _ONNX_BACKEND_H
+
+#include "opencv2/opencv.hpp"
+#include <opencv2/dnn.hpp>
+
+#include "inference_backend.h"
+
+// CPU后端：用cv::dnn运行图像模型的ONNX导出，每次推理一张
+// RKNN把归一化等预处理固化在 model.rknn 中，这里需按转换参数显式给出。
+class OnnxBackend : public InferenceBackend {
+public:
+    struct Options {
+        int width;        // 模型输入尺寸
+        int height;
+        float mean[3];    // 与RKNN转换时的 mean_values / std_values 一致（按模型输入通道顺序）
+        float std[3];
+        bool swap_rb;     // 模型输入为RGB时为 true
+    };
+
+    explicit OnnxBackend(const Options &opt);
+
+    const char *name() const { return "onnx"; }
+    bool load(const std::string &model_path, std::string *error);
+    bool query(BackendAttrs *attrs);
+    bool set_input(const uint8_t *data, size_t bytes);
+    bool run();
+    bool get_outputs(const float **data, size_t *count);
+    void release_outputs() {}
+
+private:
+    Options opt_;
+    cv::dnn::Net net_;
+    cv::Mat blob_;    // 预处理后的输入
+    cv::Mat output_;
+};
+
+#endif // _ONNX_BACKEND_H
@@ -0,0 +1,69 @@
+#include "overflow_scheduler.h"
+
+// EWMA 平滑系数
+static const double kEwmaAlpha = 0.2;
+
+static void ewma(double *avg, double sample) {
+    *avg = *avg == 0 ? sample : *avg + kEwmaAlpha * (sample - *avg);
+}
+
+OverflowScheduler::OverflowScheduler()
+    : cpu_slots_(0), cpu_busy_(0), npu_pending_(0), npu_ewma_us_(0), cpu_ewma_us_(0),
+      npu_requests_(0), cpu_requests_(0), cpu_failures_(0) {}
+
+void OverflowScheduler::configure(int cpu_slots, double cpu_seed_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cpu_slots_ = cpu_slots > 0 ? cpu_slots : 0;
+    cpu_ewma_us_ = cpu_seed_us;
+}
+
+bool OverflowScheduler::try_cpu() {
+    if (!enabled()) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 还没有NPU耗时样本时无法估计排队，先走NPU
+    if (cpu_busy_ >= cpu_slots_ || npu_ewma_us_ == 0) return false;
+    double npu_wait_us = npu_pending_ * npu_ewma_us_;
+    if (npu_wait_us <= cpu_ewma_us_) return false;
+    cpu_busy_++;
+    cpu_requests_++;
+    return true;
+}
+
+void OverflowScheduler::cpu_done(double cpu_us, bool ok) {
+    cpu_latency_.record(cpu_us);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (cpu_busy_ > 0) cpu_busy_--;
+    if (ok) {
+        ewma(&cpu_ewma_us_, cpu_us);
+    } else {
+        cpu_failures_++;
+    }
+}
+
+void OverflowScheduler::npu_enter() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    npu_pending_++;
+    npu_requests_++;
+}
+
+void OverflowScheduler::npu_leave(double npu_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (npu_pending_ > 0) npu_pending_--;
+    if (npu_us > 0) ewma(&npu_ewma_us_, npu_us);
+}
+
+void OverflowScheduler::write_metrics(JsonWriter &w) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    w.begin_object("overflow");
+    w.field("enabled", enabled());
+    w.field("cpu_slots", (uint64_t)cpu_slots_);
+    w.field("cpu_busy", (uint64_t)cpu_busy_);
+    w.field("npu_pending", (uint64_t)npu_pending_);
+    w.field("npu_ewma_us", npu_ewma_us_);
+    w.field("cpu_ewma_us", cpu_ewma_us_);
+    w.field("npu_requests", npu_requests_);
+    w.field("cpu_requests", cpu_requests_);
+    w.field("cpu_failures", cpu_failures_);
+    w.latency("cpu_latency", cpu_latency_);
+    w.end_object();
+}
@@ -0,0 +1,45 @@
+#ifndef _OVERFLOW_SCHEDULER_H
+#define _OVERFLOW_SCHEDULER_H
+
+#include <stdint.h>
+#include <mutex>
+
+#include "metrics.h"
+
+// NPU排队过长时把图像推理溢出到CPU后端
+// 预计NPU排队时间 = 排在前面尚未完成NPU推理的请求数 × 每张NPU耗时(EWMA)；
+// 超过CPU单次推理耗时(EWMA)且CPU还有空闲实例时，本次请求改由CPU推理。
+// 两个估计都取自实际完成的推理，随负载与温度变化自动调整。
+class OverflowScheduler {
+public:
+    OverflowScheduler();
+
+    // cpu_slots 为0时关闭；cpu_seed_us 为CPU耗时初始估计（预热测得）
+    void configure(int cpu_slots, double cpu_seed_us);
+    bool enabled() const { return cpu_slots_ > 0; }
+
+    // 返回 true 时调用方改用CPU推理，完成后调用 cpu_done()
+    bool try_cpu();
+    void cpu_done(double cpu_us, bool ok);
+
+    // 请求开始/结束等待NPU（含推理），npu_us 为摊到每张图像的NPU耗时，失败时为0
+    void npu_enter();
+    void npu_leave(double npu_us);
+
+    void write_metrics(JsonWriter &w);
+
+private:
+    std::mutex mutex_;
+    int cpu_slots_;
+    int cpu_busy_;
+    int npu_pending_;
+    double npu_ewma_us_;
+    double cpu_ewma_us_;
+
+    uint64_t npu_requests_;
+    uint64_t cpu_requests_;
+    uint64_t cpu_failures_;
+    LatencyStat cpu_latency_;
+};
+
+#endif // _OVERFLOW_SCHEDULER_H
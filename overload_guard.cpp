@@ -0,0 +1,99 @@
+#include "overload_guard.h"
+
+#include <stdio.h>
+#include <chrono>
+
+// EWMA 平滑系数
+static const double kEwmaAlpha = 0.2;
+
+static uint64_t steady_ms() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+OverloadGuard::OverloadGuard()
+    : enabled_(false), slo_ms_(200), exit_ms_(100), hold_ms_(1000),
+      backlog_(0), npu_ewma_us_(0), wait_ewma_us_(0),
+      degraded_(false), since_ms_(0), total_degraded_ms_(0),
+      transitions_(0), degraded_requests_(0) {}
+
+void OverloadGuard::configure(bool enabled, double slo_ms, double exit_ms, double hold_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    enabled_ = enabled;
+    slo_ms_ = slo_ms;
+    exit_ms_ = exit_ms;
+    hold_ms_ = hold_ms;
+}
+
+void OverloadGuard::admit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    backlog_++;
+}
+
+void OverloadGuard::leave() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (backlog_ > 0) backlog_--;
+}
+
+void OverloadGuard::observe(double npu_us, double wait_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    npu_ewma_us_ = npu_ewma_us_ == 0 ? npu_us : npu_ewma_us_ + kEwmaAlpha * (npu_us - npu_ewma_us_);
+    wait_ewma_us_ = wait_ewma_us_ + kEwmaAlpha * (wait_us - wait_ewma_us_);
+}
+
+double OverloadGuard::estimated_wait_ms() const {
+    return backlog_ * npu_ewma_us_ / 1000.0;
+}
+
+double OverloadGuard::degraded_ms(uint64_t now_ms) const {
+    return (double)(total_degraded_ms_ + (degraded_ ? now_ms - since_ms_ : 0));
+}
+
+void OverloadGuard::update(uint64_t now) {
+    double wait = estimated_wait_ms();
+    if (!degraded_ && wait > slo_ms_) {
+        degraded_ = true;
+        since_ms_ = now;
+        transitions_++;
+        printf("⚠️ 进入过载降级: 预计NPU排队 %.1f ms > %.1f ms\n", wait, slo_ms_);
+    } else if (degraded_ && wait < exit_ms_ && now - since_ms_ >= hold_ms_) {
+        degraded_ = false;
+        total_degraded_ms_ += now - since_ms_;
+        printf("✅ 退出过载降级: 预计NPU排队 %.1f ms，持续 %llu ms\n",
+               wait, (unsigned long long)(now - since_ms_));
+    }
+}
+
+bool OverloadGuard::should_degrade() {
+    if (!enabled_) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    update(steady_ms());
+    if (degraded_) degraded_requests_++;
+    return degraded_;
+}
+
+void OverloadGuard::tick() {
+    if (!enabled_) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    update(steady_ms());
+}
+
+void OverloadGuard::write_metrics(JsonWriter &w) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t now = steady_ms();
+    if (enabled_) update(now);
+    w.begin_object("overload");
+    w.field("enabled", enabled_);
+    w.field("degraded", degraded_);
+    w.field("slo_ms", slo_ms_);
+    w.field("exit_ms", exit_ms_);
+    w.field("hold_ms", hold_ms_);
+    w.field("backlog", (uint64_t)backlog_);
+    w.field("npu_service_ms", npu_ewma_us_ / 1000.0);
+    w.field("estimated_wait_ms", estimated_wait_ms());
+    w.field("observed_wait_ms", wait_ewma_us_ / 1000.0);
+    w.field("transitions", transitions_);
+    w.field("degraded_time_s", degraded_ms(now) / 1000.0);
+    w.field("degraded_requests", degraded_requests_);
+    w.end_object();
+}
@@ -0,0 +1,57 @@
+#ifndef _OVERLOAD_GUARD_H
+#define _OVERLOAD_GUARD_H
+
+#include <stdint.h>
+#include <mutex>
+
+#include "metrics.h"
+
+// 过载降级策略
+// 预计NPU排队时间 = 尚未完成NPU推理的请求数 × NPU单次占用时间(EWMA)。
+// 超过 slo_ms 时进入降级，新请求只用特征模型应答；降到 exit_ms 以下且
+// 已保持至少 hold_ms 后恢复完整融合（滞回，避免在阈值附近来回切换）。
+class OverloadGuard {
+public:
+    OverloadGuard();
+
+    void configure(bool enabled, double slo_ms, double exit_ms, double hold_ms);
+    bool enabled() const { return enabled_; }
+
+    // 请求进入/离开NPU路径（排队中的请求也计入）
+    void admit();
+    void leave();
+
+    // 记录一次NPU占用时间与该请求实际等待时间
+    void observe(double npu_us, double wait_us);
+
+    // 新请求到达时调用，更新状态并返回是否应降级应答
+    bool should_degrade();
+
+    // 由定时器周期调用：没有新请求时也能按积压退出降级，降级时长不会一直累加
+    void tick();
+
+    void write_metrics(JsonWriter &w);
+
+private:
+    double estimated_wait_ms() const;  // 调用方持有 mutex_
+    double degraded_ms(uint64_t now_ms) const;
+    void update(uint64_t now_ms);  // 调用方持有 mutex_
+
+    std::mutex mutex_;
+    bool enabled_;
+    double slo_ms_;
+    double exit_ms_;
+    double hold_ms_;
+
+    int backlog_;
+    double npu_ewma_us_;
+    double wait_ewma_us_;
+
+    bool degraded_;
+    uint64_t since_ms_;          // 进入降级的时刻
+    uint64_t total_degraded_ms_; // 已结束的降级区间累计
+    uint64_t transitions_;       // 进入降级的次数
+    uint64_t degraded_requests_;
+};
+
+#endif // _OVERLOAD_GUARD_H
@@ -0,0 +1,380 @@
+// 流量存档重放工具：把 --capture-dir 采集的请求重新发给服务器，比较延迟与结果
+// 用法: replay [选项] traffic-xxx.atkcap.gz [更多存档 ...]
+//   --url=http://127.0.0.1:8080/api/classify
+//   --speed=X          按原始到达间隔的 1/X 发起请求 (默认 1 即原始节奏，2 为两倍速，0 为尽快发送)
+//   --concurrency=N    --speed=0 时的并发连接数 (默认 4)
+//   --connections=N    按节奏重放时最多同时进行的请求数 (默认 256)
+//   --limit=N          最多重放N条记录
+//   --tol=X            置信度允许的最大差异 (默认 1e-3)
+//   --show=N           打印前N条结果不一致的记录 (默认 5)
+//   --timeout-ms=N     单个请求超时 (默认 10000)
+//   --json=FILE        额外把结果写成JSON
+//
+// 多个存档按命令行顺序首尾相接重放。按节奏重放时延迟从计划发起时间算起（与 loadgen 开环一致）；
+// 存档中的原始耗时是服务端处理耗时，不含网络与排队，比较时应关注相对变化。
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <netdb.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "http_client.h"
+#include "traffic_capture.h"
+
+struct Options {
+    HttpTarget target;
+    double speed = 1;
+    int concurrency = 4;
+    int connections = 256;
+    uint64_t limit = 0;
+    double tol = 1e-3;
+    int show = 5;
+    int timeout_ms = 10000;
+    std::string json_file;
+    std::vector<std::string> archives;
+};
+
+struct Item {
+    uint64_t seq;
+    double intended_us;  // 计划发起时间，尽快发送时为入队时间
+    TrafficRecord rec;
+};
+
+// 比较结果
+enum {
+    kMatch = 0,
+    kStatusMismatch,
+    kClassMismatch,
+    kProbabilityMismatch,
+    kFailed  // 未收到HTTP响应
+};
+
+struct Outcome {
+    uint64_t seq;
+    double original_us;
+    double latency_us;
+    double service_us;
+    int original_status;
+    int status;
+    int verdict;
+    std::string detail;
+};
+
+static double now_us() {
+    return std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 从响应JSON中取出类别与置信度
+static bool parse_result(const std::string &json, int *cls, double *prob) {
+    const char *c = strstr(json.c_str(), "\"class\":");
+    const char *p = strstr(json.c_str(), "\"probability\":");
+    if (!c || !p) return false;
+    *cls = atoi(c + 8);
+    *prob = strtod(p + 14, NULL);
+    return true;
+}
+
+static int compare(const TrafficRecord &rec, int status, const std::string &response,
+                   double tol, std::string *detail) {
+    char buf[160];
+    if (status < 0) {
+        char name[16];
+        *detail = http_status_name(status, name, sizeof(name));
+        return kFailed;
+    }
+    if (status != rec.status) {
+        snprintf(buf, sizeof(buf), "状态码 %d -> %d", rec.status, status);
+        *detail = buf;
+        return kStatusMismatch;
+    }
+    if (status != 200) return kMatch;
+    int c0 = 0, c1 = 0;
+    double p0 = 0, p1 = 0;
+    bool ok0 = parse_result(rec.response, &c0, &p0);
+    bool ok1 = parse_result(response, &c1, &p1);
+    if (!ok0 || !ok1) {
+        // 只有一边能解析出结果，视为类别不一致
+        if (ok0 != ok1) {
+            *detail = ok0 ? "重放响应中没有结果" : "原始响应中没有结果";
+            return kClassMismatch;
+        }
+        return kMatch;
+    }
+    if (c0 != c1) {
+        snprintf(buf, sizeof(buf), "类别 %d -> %d", c0, c1);
+        *detail = buf;
+        return kClassMismatch;
+    }
+    if (fabs(p0 - p1) > tol) {
+        snprintf(buf, sizeof(buf), "置信度 %.4f -> %.4f", p0, p1);
+        *detail = buf;
+        return kProbabilityMismatch;
+    }
+    return kMatch;
+}
+
+static double percentile(const std::vector<double> &sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t idx = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+static void print_usage(const char *prog) {
+    printf("用法: %s [选项] 存档.atkcap.gz [更多存档 ...]\n", prog);
+    printf("  --url=URL          目标地址 (默认 http://127.0.0.1:8080/api/classify)\n");
+    printf("  --speed=X          重放速度倍数，1为原始节奏，0为尽快发送 (默认 1)\n");
+    printf("  --concurrency=N    尽快发送时的并发连接数 (默认 4)\n");
+    printf("  --connections=N    按节奏重放时最多同时进行的请求数 (默认 256)\n");
+    printf("  --limit=N          最多重放N条记录\n");
+    printf("  --tol=X            置信度允许的最大差异 (默认 1e-3)\n");
+    printf("  --show=N           打印前N条结果不一致的记录 (默认 5)\n");
+    printf("  --timeout-ms=N     单个请求超时 (默认 10000)\n");
+    printf("  --json=FILE        同时输出JSON结果\n");
+}
+
+static bool parse_args(int argc, char *argv[], Options *opt) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--url=", 6) == 0) {
+            if (!http_parse_url(arg + 6, &opt->target)) {
+                fprintf(stderr, "无效的URL: %s\n", arg + 6);
+                return false;
+            }
+        } else if (strncmp(arg, "--speed=", 8) == 0) {
+            opt->speed = atof(arg + 8);
+        } else if (strncmp(arg, "--concurrency=", 14) == 0) {
+            opt->concurrency = atoi(arg + 14);
+        } else if (strncmp(arg, "--connections=", 14) == 0) {
+            opt->connections = atoi(arg + 14);
+        } else if (strncmp(arg, "--limit=", 8) == 0) {
+            opt->limit = strtoull(arg + 8, NULL, 10);
+        } else if (strncmp(arg, "--tol=", 6) == 0) {
+            opt->tol = atof(arg + 6);
+        } else if (strncmp(arg, "--show=", 7) == 0) {
+            opt->show = atoi(arg + 7);
+        } else if (strncmp(arg, "--timeout-ms=", 13) == 0) {
+            opt->timeout_ms = atoi(arg + 13);
+        } else if (strncmp(arg, "--json=", 7) == 0) {
+            opt->json_file = arg + 7;
+        } else if (strncmp(arg, "--", 2) == 0) {
+            fprintf(stderr, "未知参数: %s\n", arg);
+            return false;
+        } else {
+            opt->archives.push_back(arg);
+        }
+    }
+    if (opt->archives.empty() || opt->speed < 0 || opt->concurrency < 1 ||
+        opt->connections < 1 || opt->tol < 0) {
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    Options opt;
+    if (!parse_args(argc, argv, &opt)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    struct addrinfo *addr = http_resolve(opt.target);
+    if (!addr) {
+        fprintf(stderr, "无法解析 %s:%s\n", opt.target.host.c_str(), opt.target.port.c_str());
+        return 1;
+    }
+
+    bool paced = opt.speed > 0;
+    int workers = paced ? opt.connections : opt.concurrency;
+    std::vector<std::vector<Outcome> > outcomes(workers);
+
+    // 读取线程（主线程）按计划时间放入队列；尽快发送时队列长度限制为工作线程数，
+    // 避免把整个存档读进内存
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv, space_cv;
+    std::deque<Item> queue;
+    bool dispatch_done = false;
+    uint64_t max_backlog = 0;
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < workers; w++) {
+        threads.push_back(std::thread([&, w]() {
+            std::vector<Outcome> &mine = outcomes[w];
+            std::string response;
+            for (;;) {
+                Item item;
+                {
+                    std::unique_lock<std::mutex> lock(queue_mutex);
+                    queue_cv.wait(lock, [&]() { return dispatch_done || !queue.empty(); });
+                    if (queue.empty()) return;
+                    item = std::move(queue.front());
+                    queue.pop_front();
+                }
+                space_cv.notify_one();
+                double sent = now_us();
+                int status = http_post(opt.target, addr, item.rec.body, opt.timeout_ms, &response);
+                double done = now_us();
+                Outcome o;
+                o.seq = item.seq;
+                o.original_us = item.rec.latency_us;
+                o.latency_us = done - item.intended_us;
+                o.service_us = done - sent;
+                o.original_status = item.rec.status;
+                o.status = status;
+                o.verdict = compare(item.rec, status, response, opt.tol, &o.detail);
+                mine.push_back(o);
+            }
+        }));
+    }
+
+    double start = now_us();
+    double file_origin = start;  // 当前存档第一条记录的计划发起时间
+    double last_planned = start;
+    uint64_t seq = 0;
+    double original_span_us = 0;  // 各存档原始时间跨度之和
+    int status = 0;
+    for (size_t f = 0; f < opt.archives.size() && (!opt.limit || seq < opt.limit); f++) {
+        TrafficReader reader;
+        std::string error;
+        if (!reader.open(opt.archives[f], &error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            status = 1;
+            break;
+        }
+        bool first = true;
+        uint64_t first_arrival = 0, last_arrival = 0;
+        file_origin = last_planned;
+        Item item;
+        while ((!opt.limit || seq < opt.limit) && reader.next(&item.rec)) {
+            if (first) {
+                first_arrival = item.rec.arrival_us;
+                first = false;
+            }
+            // 时钟回拨时按不早于上一条处理
+            last_arrival = std::max(last_arrival, (uint64_t)item.rec.arrival_us);
+            item.seq = seq++;
+            if (paced) {
+                double t = file_origin + (last_arrival - first_arrival) / opt.speed;
+                double wait = t - now_us();
+                if (wait > 0) {
+                    std::this_thread::sleep_for(std::chrono::microseconds((int64_t)wait));
+                }
+                item.intended_us = t;
+                last_planned = t;
+            }
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            if (!paced) {
+                space_cv.wait(lock, [&]() { return queue.size() < (size_t)workers; });
+                item.intended_us = now_us();
+            }
+            queue.push_back(std::move(item));
+            max_backlog = std::max<uint64_t>(max_backlog, queue.size());
+            queue_cv.notify_one();
+        }
+        original_span_us += last_arrival - first_arrival;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        dispatch_done = true;
+        queue_cv.notify_all();
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    double elapsed_s = (now_us() - start) / 1e6;
+    freeaddrinfo(addr);
+    if (status != 0) return status;
+
+    // 汇总
+    std::vector<Outcome> all;
+    for (size_t i = 0; i < outcomes.size(); i++) {
+        all.insert(all.end(), outcomes[i].begin(), outcomes[i].end());
+    }
+    std::sort(all.begin(), all.end(),
+              [](const Outcome &a, const Outcome &b) { return a.seq < b.seq; });
+    std::vector<double> original, latency, service;
+    uint64_t counts[5] = {0, 0, 0, 0, 0};
+    for (size_t i = 0; i < all.size(); i++) {
+        const Outcome &o = all[i];
+        counts[o.verdict]++;
+        // 只比较两次都成功的请求的延迟
+        if (o.original_status == 200 && o.status == 200) {
+            original.push_back(o.original_us / 1000.0);
+            latency.push_back(o.latency_us / 1000.0);
+            service.push_back(o.service_us / 1000.0);
+        }
+    }
+    std::sort(original.begin(), original.end());
+    std::sort(latency.begin(), latency.end());
+    std::sort(service.begin(), service.end());
+
+    uint64_t total = all.size();
+    uint64_t mismatched = total - counts[kMatch];
+    static const double kPercentiles[] = {50, 90, 99};
+    static const char *const kPercentileNames[] = {"p50", "p90", "p99"};
+
+    if (paced) {
+        printf("重放速度: %gx, 原始时长 %.1f 秒, 最大积压 %llu\n", opt.speed,
+               original_span_us / 1e6, (unsigned long long)max_backlog);
+    } else {
+        printf("重放速度: 尽快发送, 并发连接 %d\n", opt.concurrency);
+    }
+    printf("记录: %llu, 用时 %.1f 秒, 吞吐: %.1f 次/秒\n", (unsigned long long)total, elapsed_s,
+           elapsed_s > 0 ? total / elapsed_s : 0.0);
+    printf("延迟(ms)        ");
+    for (int i = 0; i < 3; i++) printf("%10s", kPercentileNames[i]);
+    printf("%10s\n", "最大");
+    const std::vector<double> *rows[] = {&original, &latency, &service};
+    const char *row_names[] = {"原始(服务端)    ", "重放            ", "重放(从实际发起)"};
+    for (int r = 0; r < (paced ? 3 : 2); r++) {
+        printf("%s", row_names[r]);
+        for (int i = 0; i < 3; i++) printf("%10.2f", percentile(*rows[r], kPercentiles[i]));
+        printf("%10.2f\n", rows[r]->empty() ? 0.0 : rows[r]->back());
+    }
+    printf("结果: 一致 %llu, 状态码不同 %llu, 类别不同 %llu, 置信度超差 %llu, 请求失败 %llu\n",
+           (unsigned long long)counts[kMatch], (unsigned long long)counts[kStatusMismatch],
+           (unsigned long long)counts[kClassMismatch], (unsigned long long)counts[kProbabilityMismatch],
+           (unsigned long long)counts[kFailed]);
+    int shown = 0;
+    for (size_t i = 0; i < all.size() && shown < opt.show; i++) {
+        if (all[i].verdict == kMatch) continue;
+        printf("  #%llu: %s\n", (unsigned long long)all[i].seq, all[i].detail.c_str());
+        shown++;
+    }
+
+    if (!opt.json_file.empty()) {
+        FILE *fp = fopen(opt.json_file.c_str(), "w");
+        if (!fp) {
+            fprintf(stderr, "无法写入 %s\n", opt.json_file.c_str());
+            return 1;
+        }
+        fprintf(fp, "{\"speed\":%g,\"records\":%llu,\"duration_s\":%.3f,\"original_span_s\":%.3f,"
+                "\"throughput\":%.3f,\"max_backlog\":%llu,",
+                opt.speed, (unsigned long long)total, elapsed_s, original_span_us / 1e6,
+                elapsed_s > 0 ? total / elapsed_s : 0.0, (unsigned long long)max_backlog);
+        const char *json_names[] = {"original_ms", "replay_ms", "service_ms"};
+        for (int r = 0; r < 3; r++) {
+            fprintf(fp, "\"%s\":{", json_names[r]);
+            for (int i = 0; i < 3; i++) {
+                fprintf(fp, "\"%s\":%.3f,", kPercentileNames[i], percentile(*rows[r], kPercentiles[i]));
+            }
+            fprintf(fp, "\"max\":%.3f},", rows[r]->empty() ? 0.0 : rows[r]->back());
+        }
+        fprintf(fp, "\"match\":%llu,\"status_mismatch\":%llu,\"class_mismatch\":%llu,"
+                "\"probability_mismatch\":%llu,\"failed\":%llu}\n",
+                (unsigned long long)counts[kMatch], (unsigned long long)counts[kStatusMismatch],
+                (unsigned long long)counts[kClassMismatch],
+                (unsigned long long)counts[kProbabilityMismatch], (unsigned long long)counts[kFailed]);
+        fclose(fp);
+    }
+    return mismatched == 0 ? 0 : 2;
+}
@@ -0,0 +1,110 @@
+#include "request_arena.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <new>
+
+ArenaStats g_arena_stats;
+
+static thread_local int s_scope_depth = 0;
+
+static void update_max(std::atomic<uint64_t> &target, uint64_t value) {
+    uint64_t prev = target.load();
+    while (value > prev && !target.compare_exchange_weak(prev, value)) {
+    }
+}
+
+RequestArena::RequestArena() : offset_(0), used_before_(0), allocations_(0) {}
+
+RequestArena::~RequestArena() {
+    for (size_t i = 0; i < blocks_.size(); i++) {
+        g_arena_stats.retained_bytes -= (int64_t)blocks_[i].size;
+        free(blocks_[i].data);
+    }
+}
+
+RequestArena &RequestArena::current() {
+    static thread_local RequestArena arena;
+    return arena;
+}
+
+void RequestArena::add_block(size_t min_bytes) {
+    size_t size = blocks_.empty() ? kInitialBytes : blocks_.back().size * 2;
+    size = std::max(size, min_bytes);
+    Block b;
+    b.data = (char *)malloc(size);
+    if (!b.data) throw std::bad_alloc();
+    b.size = size;
+    if (!blocks_.empty()) used_before_ += offset_;
+    blocks_.push_back(b);
+    offset_ = 0;
+    g_arena_stats.block_mallocs++;
+    g_arena_stats.retained_bytes += (int64_t)size;
+}
+
+void *RequestArena::allocate(size_t bytes, size_t align) {
+    allocations_++;
+    if (!blocks_.empty()) {
+        Block &b = blocks_.back();
+        size_t pos = (offset_ + align - 1) & ~(align - 1);
+        if (pos + bytes <= b.size) {
+            offset_ = pos + bytes;
+            return b.data + pos;
+        }
+    }
+    // malloc 至少按16字节对齐，新块从头开始
+    add_block(bytes);
+    offset_ = bytes;
+    return blocks_.back().data;
+}
+
+void RequestArena::reset() {
+    size_t used = used_bytes();
+    if (blocks_.size() > 1) {
+        for (size_t i = 0; i < blocks_.size(); i++) {
+            g_arena_stats.retained_bytes -= (int64_t)blocks_[i].size;
+            free(blocks_[i].data);
+        }
+        blocks_.clear();
+        // 合并为一块，按本次用量向上取整到初始块大小的倍数
+        size_t size = (used + kInitialBytes - 1) / kInitialBytes * kInitialBytes;
+        if (size <= kMaxRetainBytes) add_block(size);
+    } else if (!blocks_.empty() && blocks_[0].size > kMaxRetainBytes) {
+        g_arena_stats.retained_bytes -= (int64_t)blocks_[0].size;
+        free(blocks_[0].data);
+        blocks_.clear();
+    }
+    offset_ = 0;
+    used_before_ = 0;
+    allocations_ = 0;
+}
+
+ArenaScope::ArenaScope() {
+    s_scope_depth++;
+}
+
+ArenaScope::~ArenaScope() {
+    if (--s_scope_depth > 0) return;
+    RequestArena &arena = RequestArena::current();
+    uint64_t allocs = arena.allocations();
+    uint64_t peak = arena.used_bytes();
+    g_arena_stats.requests++;
+    g_arena_stats.allocations += allocs;
+    g_arena_stats.peak_bytes += peak;
+    update_max(g_arena_stats.max_allocations, allocs);
+    update_max(g_arena_stats.max_peak_bytes, peak);
+    arena.reset();
+}
+
+void ArenaStats::write_metrics(JsonWriter &w) const {
+    uint64_t n = requests.load();
+    w.begin_object("arena");
+    w.field("requests", n);
+    w.field("allocs_avg", n ? (double)allocations.load() / n : 0.0);
+    w.field("allocs_max", max_allocations.load());
+    w.field("peak_bytes_avg", n ? (double)peak_bytes.load() / n : 0.0);
+    w.field("peak_bytes_max", max_peak_bytes.load());
+    w.field("block_mallocs", block_mallocs.load());
+    w.field("retained_bytes", (uint64_t)std::max<int64_t>(0, retained_bytes.load()));
+    w.end_object();
+}
@@ -0,0 +1,80 @@
+#ifndef _REQUEST_ARENA_H
+#define _REQUEST_ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+#include "metrics.h"
+
+// 请求内的临时内存：每个处理线程一个单调分配器（只向前移动指针，不单独释放），
+// 最外层 ArenaScope 结束时整体复位。Base64解码结果、缩放后的模型输入等随请求
+// 结束即丢弃的缓冲从这里取，稳定状态下一个请求不调用 malloc。
+// 复位时若本次用了多个内存块，合并成一块足够大的，下个同样大小的请求只用一块；
+// 超过 kMaxRetainBytes 的部分不保留，避免偶发的超大请求长期占用内存。
+class RequestArena {
+public:
+    static const size_t kInitialBytes = 256 << 10;
+    static const size_t kMaxRetainBytes = 16 << 20;
+
+    RequestArena();
+    ~RequestArena();
+
+    // 返回的内存按 align 对齐，未初始化，在复位前有效
+    void *allocate(size_t bytes, size_t align = 16);
+    template <class T>
+    T *alloc_array(size_t n) { return static_cast<T *>(allocate(n * sizeof(T), 16)); }
+
+    void reset();
+
+    size_t allocations() const { return allocations_; }
+    size_t used_bytes() const { return used_before_ + offset_; }
+
+    // 当前线程的分配器
+    static RequestArena &current();
+
+private:
+    struct Block {
+        char *data;
+        size_t size;
+    };
+
+    void add_block(size_t min_bytes);
+
+    std::vector<Block> blocks_;
+    size_t offset_;       // 当前块（最后一块）内已用字节
+    size_t used_before_;  // 之前各块已用字节之和
+    size_t allocations_;
+
+    RequestArena(const RequestArena &);
+    RequestArena &operator=(const RequestArena &);
+};
+
+// 请求处理范围，可嵌套；最外层结束时记录本次分配次数与峰值并复位当前线程的分配器
+class ArenaScope {
+public:
+    ArenaScope();
+    ~ArenaScope();
+};
+
+// 所有线程合计
+struct ArenaStats {
+    std::atomic<uint64_t> requests;
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> max_allocations;
+    std::atomic<uint64_t> peak_bytes;      // 各请求峰值之和
+    std::atomic<uint64_t> max_peak_bytes;
+    std::atomic<uint64_t> block_mallocs;   // 向系统申请内存块的次数，稳定后不再增长
+    std::atomic<int64_t> retained_bytes;   // 各线程持有的内存块总大小
+
+    ArenaStats()
+        : requests(0), allocations(0), max_allocations(0), peak_bytes(0),
+          max_peak_bytes(0), block_mallocs(0), retained_bytes(0) {}
+
+    void write_metrics(JsonWriter &w) const;
+};
+
+extern ArenaStats g_arena_stats;
+
+#endif // _REQUEST_ARENA_H
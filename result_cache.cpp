@@ -0,0 +1,135 @@
+#include "result_cache.h"
+
+#include <string.h>
+#include <chrono>
+
+static uint64_t steady_ms() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ResultCache::ResultCache()
+    : max_entries_(0), max_bytes_(0), ttl_ms_(0), version_(0),
+      hits_(0), misses_(0), collisions_(0), inserts_(0), evictions_(0), expirations_(0),
+      invalidations_(0), saved_us_(0) {}
+
+// 条目本身加上链表节点与哈希表节点的大致开销
+size_t ResultCache::entry_bytes() {
+    return sizeof(Entry) + 2 * sizeof(void *) +
+           sizeof(std::pair<const uint64_t, LruList::iterator>) + 2 * sizeof(void *);
+}
+
+void ResultCache::configure(size_t max_bytes, uint64_t ttl_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_bytes_ = max_bytes;
+    max_entries_ = max_bytes / entry_bytes();
+    ttl_ms_ = ttl_ms;
+    while (lru_.size() > max_entries_) {
+        erase(--lru_.end());
+    }
+}
+
+void ResultCache::set_model_version(uint64_t version) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (version == version_) return;
+    version_ = version;
+    if (!lru_.empty()) {
+        invalidations_++;
+        lru_.clear();
+        index_.clear();
+    }
+}
+
+void ResultCache::erase(LruList::iterator it) {
+    index_.erase(it->key);
+    lru_.erase(it);
+}
+
+bool ResultCache::lookup(uint64_t key, const float *features, size_t n, size_t image_len,
+                         uint64_t image_check, CachedResult *out, double *saved_us) {
+    if (!enabled()) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = index_.find(key);
+    if (found == index_.end()) {
+        misses_++;
+        return false;
+    }
+    LruList::iterator it = found->second;
+    if (it->version != version_ || (ttl_ms_ > 0 && steady_ms() - it->inserted_ms > ttl_ms_)) {
+        expirations_++;
+        misses_++;
+        erase(it);
+        return false;
+    }
+    if (it->image_len != image_len || it->image_check != image_check ||
+        it->feature_count != n || memcmp(it->features, features, n * sizeof(float)) != 0) {
+        collisions_++;  // 哈希冲突
+        misses_++;
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, it);
+    hits_++;
+    *out = it->result;
+    *saved_us = it->cost_us;
+    return true;
+}
+
+void ResultCache::insert(uint64_t key, const float *features, size_t n, size_t image_len,
+                         uint64_t image_check, const CachedResult &res, double cost_us) {
+    if (!enabled() || n > kMaxFeatures) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = index_.find(key);
+    if (found != index_.end()) {
+        erase(found->second);  // 同一输入并发计算，保留最新结果
+    }
+    while (lru_.size() >= max_entries_) {
+        erase(--lru_.end());
+        evictions_++;
+    }
+    lru_.push_front(Entry());
+    Entry &e = lru_.front();
+    e.key = key;
+    e.version = version_;
+    e.inserted_ms = steady_ms();
+    e.image_check = image_check;
+    e.image_len = (uint32_t)image_len;
+    e.feature_count = (uint32_t)n;
+    memcpy(e.features, features, n * sizeof(float));
+    e.result = res;
+    e.cost_us = cost_us;
+    index_[key] = lru_.begin();
+    inserts_++;
+}
+
+void ResultCache::record_hit_cost(double saved_us, double hit_us) {
+    if (saved_us > hit_us) {
+        saved_us_ += (uint64_t)(saved_us - hit_us);
+    }
+}
+
+void ResultCache::write_metrics(JsonWriter &w) const {
+    uint64_t hits = hits_.load();
+    uint64_t lookups = hits + misses_.load();
+    size_t entries;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries = lru_.size();
+    }
+    w.begin_object("cache");
+    w.field("enabled", enabled());
+    w.field("entries", (uint64_t)entries);
+    w.field("max_entries", (uint64_t)max_entries_);
+    w.field("bytes", (uint64_t)(entries * entry_bytes()));
+    w.field("max_bytes", (uint64_t)max_bytes_);
+    w.field("ttl_ms", (uint64_t)ttl_ms_);
+    w.field("hits", hits);
+    w.field("misses", (uint64_t)misses_.load());
+    w.field("collisions", (uint64_t)collisions_.load());
+    w.field("hit_ratio", lookups ? (double)hits / lookups : 0.0);
+    w.field("saved_ms", saved_us_.load() / 1000.0);
+    w.field("inserts", (uint64_t)inserts_.load());
+    w.field("evictions", (uint64_t)evictions_.load());
+    w.field("expirations", (uint64_t)expirations_.load());
+    w.field("invalidations", (uint64_t)invalidations_.load());
+    w.end_object();
+}
@@ -0,0 +1,90 @@
+#ifndef _RESULT_CACHE_H
+#define _RESULT_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "metrics.h"
+#include "result_store.h"
+
+// 缓存的融合结果（与 FusionResult 对应，避免依赖主头文件）
+struct CachedResult {
+    int class_id;
+    float probability;
+    float svm_score;
+    float rknn_score;
+    float svm_probs[kResultClasses];
+    float rknn_probs[kResultClasses];
+    bool feature_only;
+    int backend;  // InferBackend
+};
+
+// 按输入内容哈希缓存最终结果的LRU缓存，多个请求线程可并发访问
+// 条目同时保存特征值、图像长度与图像的校验哈希（另一种子），键相同但任一项不同时
+// 视为哈希冲突、按未命中处理；
+// 条目记录写入时的模型版本，模型版本变化后旧条目自动失效。
+class ResultCache {
+public:
+    ResultCache();
+
+    // max_bytes 为0时关闭缓存；ttl_ms 为0表示不过期
+    void configure(size_t max_bytes, uint64_t ttl_ms);
+    bool enabled() const { return max_entries_ > 0; }
+
+    // 模型版本（两个模型文件哈希），变化时清空并使旧条目失效
+    void set_model_version(uint64_t version);
+
+    // 命中时返回 true，saved_us 为命中条目首次计算的耗时
+    // image_check 为image字段文本以 kContentCheckSeed 计算的 content_hash64
+    bool lookup(uint64_t key, const float *features, size_t n, size_t image_len,
+                uint64_t image_check, CachedResult *out, double *saved_us);
+    // cost_us 为本次计算耗时，命中时计入节省时间
+    void insert(uint64_t key, const float *features, size_t n, size_t image_len,
+                uint64_t image_check, const CachedResult &res, double cost_us);
+    // 记录命中请求的实际耗时，节省时间 = 原耗时 - 命中耗时
+    void record_hit_cost(double saved_us, double hit_us);
+
+    void write_metrics(JsonWriter &w) const;
+
+    static const size_t kMaxFeatures = 34;
+
+private:
+    struct Entry {
+        uint64_t key;
+        uint64_t version;
+        uint64_t inserted_ms;
+        uint64_t image_check;
+        uint32_t image_len;
+        uint32_t feature_count;
+        float features[kMaxFeatures];
+        CachedResult result;
+        double cost_us;
+    };
+    typedef std::list<Entry> LruList;
+
+    static size_t entry_bytes();
+    void erase(LruList::iterator it);
+
+    mutable std::mutex mutex_;
+    LruList lru_;  // 头部为最近使用
+    std::unordered_map<uint64_t, LruList::iterator> index_;
+    size_t max_entries_;
+    size_t max_bytes_;
+    uint64_t ttl_ms_;
+    uint64_t version_;
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> collisions_;  // 计入 misses_
+    std::atomic<uint64_t> inserts_;
+    std::atomic<uint64_t> evictions_;
+    std::atomic<uint64_t> expirations_;
+    std::atomic<uint64_t> invalidations_;
+    std::atomic<uint64_t> saved_us_;
+};
+
+#endif // _RESULT_CACHE_H
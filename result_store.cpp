@@ -0,0 +1,386 @@
+#include "result_store.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+static_assert(sizeof(ResultRecord) == 128, "ResultRecord must stay 128 bytes");
+
+const char *const kResultStageNames[kStageCount] = {
+    "dispatch", "parse", "base64", "queue", "decode", "preprocess",
+    "npu", "svm", "join_wait", "parallel", "fusion", "total"
+};
+
+static const char kMagic[8] = {'A', 'T', 'K', 'R', 'E', 'S', '1', '\0'};
+// 版本2：保留字段改为两个模型的各类别概率，记录大小不变，版本1的数据段仍可查询
+static const uint32_t kFormatVersion = 2;
+
+// 数据段文件头，记录从 sizeof(SegmentHeader) 处开始
+struct SegmentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t created_us;
+    uint8_t reserved[40];
+};
+static_assert(sizeof(SegmentHeader) == 64, "SegmentHeader must stay 64 bytes");
+
+static bool write_all(int fd, const void *data, size_t len) {
+    const char *p = (const char *)data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static std::string index_path(const std::string &segment) {
+    return segment.substr(0, segment.size() - 4) + ".idx";
+}
+
+// 目录下所有数据段，按文件名（即创建时间）排序
+static std::vector<std::string> list_segments(const std::string &dir) {
+    std::vector<std::string> out;
+    DIR *d = opendir(dir.c_str());
+    if (!d) return out;
+    while (struct dirent *ent = readdir(d)) {
+        size_t len = strlen(ent->d_name);
+        if (len > 12 && strncmp(ent->d_name, "results-", 8) == 0 &&
+            strcmp(ent->d_name + len - 4, ".bin") == 0) {
+            out.push_back(dir + "/" + ent->d_name);
+        }
+    }
+    closedir(d);
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+ResultStore::ResultStore()
+    : fd_(-1), idx_fd_(-1), records_(0),
+      appended_(0), segments_created_(0), segments_deleted_(0), errors_(0) {
+    memset(&block_, 0, sizeof(block_));
+    opt_.segment_bytes = 0;
+    opt_.retain_bytes = 0;
+}
+
+ResultStore::~ResultStore() {
+    close();
+}
+
+bool ResultStore::open(const Options &opt) {
+    opt_ = opt;
+    if (mkdir(opt_.dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        printf("⚠️ 无法创建结果存储目录 %s: %s\n", opt_.dir.c_str(), strerror(errno));
+        return false;
+    }
+    std::vector<std::string> segments = list_segments(opt_.dir);
+    if (!segments.empty() && resume_segment(segments.back())) {
+        printf("✅ 结果存储续写 %s (%llu 条)\n", path_.c_str(), (unsigned long long)records_);
+        return true;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return create_segment((uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+void ResultStore::close() {
+    // 未满的块不写索引，续写时由 resume_segment() 从数据重建
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    if (idx_fd_ >= 0) {
+        ::close(idx_fd_);
+        idx_fd_ = -1;
+    }
+}
+
+bool ResultStore::create_segment(uint64_t now_us) {
+    time_t sec = (time_t)(now_us / 1000000ULL);
+    struct tm tm;
+    localtime_r(&sec, &tm);
+    char name[64];
+    strftime(name, sizeof(name), "results-%Y%m%d-%H%M%S", &tm);
+    std::string path = opt_.dir + "/" + name + ".bin";
+    for (int i = 1; access(path.c_str(), F_OK) == 0; i++) {
+        char suffix[16];
+        snprintf(suffix, sizeof(suffix), ".%03d", i);
+        path = opt_.dir + "/" + name + suffix + ".bin";
+    }
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        errors_++;
+        printf("⚠️ 无法创建结果数据段 %s: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    SegmentHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kFormatVersion;
+    header.record_size = sizeof(ResultRecord);
+    header.created_us = now_us;
+    int idx_fd = ::open(index_path(path).c_str(),
+                        O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (idx_fd < 0 || !write_all(fd, &header, sizeof(header))) {
+        errors_++;
+        printf("⚠️ 无法初始化结果数据段 %s: %s\n", path.c_str(), strerror(errno));
+        if (idx_fd >= 0) ::close(idx_fd);
+        ::close(fd);
+        return false;
+    }
+
+    close();
+    fd_ = fd;
+    idx_fd_ = idx_fd;
+    path_ = path;
+    records_ = 0;
+    memset(&block_, 0, sizeof(block_));
+    segments_created_++;
+    return true;
+}
+
+// 续写最后一个数据段：截掉不完整的尾部记录，从数据重建未写入索引的块
+bool ResultStore::resume_segment(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+    if (fd < 0) return false;
+    SegmentHeader header;
+    struct stat st;
+    if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kFormatVersion ||
+        header.record_size != sizeof(ResultRecord) || fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    uint64_t records = ((uint64_t)st.st_size - sizeof(header)) / sizeof(ResultRecord);
+    uint64_t valid = sizeof(header) + records * sizeof(ResultRecord);
+    if ((uint64_t)st.st_size != valid && ftruncate(fd, (off_t)valid) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    int idx_fd = ::open(index_path(path).c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (idx_fd < 0 || fstat(idx_fd, &st) != 0) {
+        if (idx_fd >= 0) ::close(idx_fd);
+        ::close(fd);
+        return false;
+    }
+    uint64_t entries = (uint64_t)st.st_size / sizeof(IndexEntry);
+    uint64_t indexed = 0;
+    if (entries > 0) {
+        IndexEntry last;
+        if (pread(idx_fd, &last, sizeof(last), (off_t)((entries - 1) * sizeof(last))) ==
+            (ssize_t)sizeof(last)) {
+            indexed = (uint64_t)last.first + last.count;
+        }
+        if (ftruncate(idx_fd, (off_t)(entries * sizeof(IndexEntry))) != 0) {
+            errors_++;
+        }
+    }
+    if (indexed > records) {
+        // 索引超出数据（数据被截断），放弃续写，另起一段
+        ::close(idx_fd);
+        ::close(fd);
+        return false;
+    }
+
+    close();
+    fd_ = fd;
+    idx_fd_ = idx_fd;
+    path_ = path;
+    records_ = records;
+    memset(&block_, 0, sizeof(block_));
+    block_.first = (uint32_t)indexed;
+    for (uint64_t i = indexed; i < records; i++) {
+        ResultRecord rec;
+        if (pread(fd, &rec, sizeof(rec), (off_t)(sizeof(header) + i * sizeof(rec))) !=
+            (ssize_t)sizeof(rec)) {
+            break;
+        }
+        if (block_.count == 0 || rec.time_us < block_.min_us) block_.min_us = rec.time_us;
+        if (block_.count == 0 || rec.time_us > block_.max_us) block_.max_us = rec.time_us;
+        block_.count++;
+    }
+    return true;
+}
+
+void ResultStore::flush_block() {
+    if (block_.count == 0) return;
+    if (!write_all(idx_fd_, &block_, sizeof(block_))) {
+        errors_++;
+    }
+    uint32_t next = block_.first + block_.count;
+    memset(&block_, 0, sizeof(block_));
+    block_.first = next;
+}
+
+bool ResultStore::append(const ResultRecord *recs, size_t n) {
+    if (fd_ < 0 || n == 0) return fd_ >= 0;
+    if (!write_all(fd_, recs, n * sizeof(ResultRecord))) {
+        errors_++;
+        printf("⚠️ 写入结果数据段失败: %s\n", strerror(errno));
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        uint64_t t = recs[i].time_us;
+        if (block_.count == 0 || t < block_.min_us) block_.min_us = t;
+        if (block_.count == 0 || t > block_.max_us) block_.max_us = t;
+        if (++block_.count == kIndexBlock) {
+            flush_block();
+        }
+    }
+    records_ += n;
+    appended_ += n;
+
+    if (opt_.segment_bytes > 0 &&
+        sizeof(SegmentHeader) + records_ * sizeof(ResultRecord) >= opt_.segment_bytes) {
+        flush_block();  // 已写满的段把尾块也写进索引
+        if (create_segment(recs[n - 1].time_us)) {
+            enforce_retention();
+        }
+    }
+    return true;
+}
+
+void ResultStore::sync() {
+    if (fd_ >= 0) fdatasync(fd_);
+    if (idx_fd_ >= 0) fdatasync(idx_fd_);
+}
+
+// 从最旧的数据段开始删除，当前段不删
+void ResultStore::enforce_retention() {
+    if (opt_.retain_bytes == 0) return;
+    std::vector<std::string> segments = list_segments(opt_.dir);
+    std::vector<uint64_t> sizes(segments.size(), 0);
+    uint64_t total = 0;
+    for (size_t i = 0; i < segments.size(); i++) {
+        struct stat st;
+        if (stat(segments[i].c_str(), &st) == 0) sizes[i] += (uint64_t)st.st_size;
+        if (stat(index_path(segments[i]).c_str(), &st) == 0) sizes[i] += (uint64_t)st.st_size;
+        total += sizes[i];
+    }
+    for (size_t i = 0; i + 1 < segments.size() && total > opt_.retain_bytes; i++) {
+        if (segments[i] == path_) continue;
+        unlink(index_path(segments[i]).c_str());
+        if (unlink(segments[i].c_str()) == 0) {
+            total -= sizes[i];
+            segments_deleted_++;
+            printf("🗑️ 删除旧结果数据段 %s\n", segments[i].c_str());
+        }
+    }
+}
+
+void ResultStore::write_metrics(JsonWriter &w) const {
+    w.begin_object("store");
+    w.field("dir", opt_.dir.c_str());
+    w.field("segment", path_.c_str());
+    w.field("segment_records", (uint64_t)records_);
+    w.field("appended", (uint64_t)appended_.load());
+    w.field("segments_created", (uint64_t)segments_created_.load());
+    w.field("segments_deleted", (uint64_t)segments_deleted_.load());
+    w.field("errors", (uint64_t)errors_.load());
+    w.end_object();
+}
+
+// 扫描记录 [begin, end)，返回 false 表示调用方要求停止
+static bool scan_range(const ResultRecord *recs, uint64_t begin, uint64_t end,
+                       uint64_t from_us, uint64_t to_us, int class_id,
+                       ResultStore::Visitor visit, void *arg, uint64_t *scanned) {
+    for (uint64_t i = begin; i < end; i++) {
+        const ResultRecord &rec = recs[i];
+        (*scanned)++;
+        if (rec.time_us < from_us || rec.time_us > to_us) continue;
+        if (class_id >= 0 && rec.class_id != class_id) continue;
+        if (!visit(rec, arg)) return false;
+    }
+    return true;
+}
+
+uint64_t ResultStore::query(const std::string &dir, uint64_t from_us, uint64_t to_us,
+                            int class_id, Visitor visit, void *arg) {
+    uint64_t scanned = 0;
+    std::vector<std::string> segments = list_segments(dir);
+    bool more = true;
+    for (size_t s = 0; s < segments.size() && more; s++) {
+        int fd = ::open(segments[s].c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;  // 可能刚被保留策略删除
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SegmentHeader)) {
+            ::close(fd);
+            continue;
+        }
+        // 写入线程可能正在追加，只映射当前已完整写出的记录
+        size_t map_len = (size_t)st.st_size;
+        void *map = mmap(NULL, map_len, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) continue;
+
+        const SegmentHeader *header = (const SegmentHeader *)map;
+        if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+            header->version == 0 || header->version > kFormatVersion ||
+            header->record_size != sizeof(ResultRecord)) {
+            munmap(map, map_len);
+            continue;
+        }
+        const ResultRecord *recs =
+            (const ResultRecord *)((const char *)map + sizeof(SegmentHeader));
+        uint64_t count = (map_len - sizeof(SegmentHeader)) / sizeof(ResultRecord);
+
+        // 稀疏索引很小，直接读入
+        std::vector<IndexEntry> index;
+        int idx_fd = ::open(index_path(segments[s]).c_str(), O_RDONLY | O_CLOEXEC);
+        if (idx_fd >= 0) {
+            if (fstat(idx_fd, &st) == 0) {
+                index.resize((size_t)st.st_size / sizeof(IndexEntry));
+                ssize_t want = (ssize_t)(index.size() * sizeof(IndexEntry));
+                if (want > 0 && pread(idx_fd, &index[0], (size_t)want, 0) != want) {
+                    index.clear();
+                }
+            }
+            ::close(idx_fd);
+        }
+
+        uint64_t indexed = 0;
+        for (size_t i = 0; i < index.size() && more; i++) {
+            const IndexEntry &e = index[i];
+            uint64_t end = std::min<uint64_t>((uint64_t)e.first + e.count, count);
+            if (e.first != indexed || end < e.first) break;  // 索引异常，剩余部分顺序扫描
+            indexed = end;
+            if (e.max_us < from_us || e.min_us > to_us) continue;
+            more = scan_range(recs, e.first, end, from_us, to_us, class_id, visit, arg, &scanned);
+        }
+        if (more) {
+            more = scan_range(recs, indexed, count, from_us, to_us, class_id, visit, arg, &scanned);
+        }
+        munmap(map, map_len);
+    }
+    return scanned;
+}
+
+bool parse_unix_time_us(const char *text, bool clamp, uint64_t *out) {
+    char *end = NULL;
+    double sec = strtod(text, &end);
+    if (end == text || *end != '\0' || !(sec >= 0)) return false;
+    double us = sec * 1e6;
+    if (us >= 18446744073709551616.0) {  // 2^64，转换为 uint64_t 是未定义行为
+        if (!clamp) return false;
+        *out = UINT64_MAX;
+        return true;
+    }
+    *out = (uint64_t)us;
+    return true;
+}
@@ -0,0 +1,118 @@
+#ifndef _RESULT_STORE_H
+#define _RESULT_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <string>
+
+#include "metrics.h"
+
+// 各阶段耗时在记录中的下标，与 RequestTiming 字段一一对应
+enum ResultStage {
+    kStageDispatch, kStageParse, kStageBase64, kStageQueue, kStageDecode,
+    kStagePreprocess, kStageNpu, kStageSvm, kStageJoinWait, kStageParallel,
+    kStageFusion, kStageTotal, kStageCount
+};
+
+// 阶段名，供JSON与CSV导出使用
+extern const char *const kResultStageNames[kStageCount];
+
+// 分类类别数（0: 健康, 1: 细菌感染, 2: 支原体感染），两个模型的输出均为各类别概率
+static const int kResultClasses = 3;
+
+enum ResultFlags {
+    kResultFeatureOnly = 1 << 0,  // 只用特征模型应答（级联命中或降级）
+    kResultDegraded = 1 << 1,     // 过载降级
+    kResultCached = 1 << 2,       // 来自结果缓存
+    kResultCoalesced = 1 << 3,    // 与处理中的相同请求共用结果
+    kResultNearDuplicate = 1 << 4, // 图像模型得分来自近似重复图像
+    kResultCpuBackend = 1 << 5     // 图像模型溢出到CPU推理
+};
+
+// 定长二进制结果记录（128字节，小端，按追加顺序存放）
+// 格式版本2起记录两个模型的各类别概率；版本1数据段中这两项为0（原为保留字段）
+struct ResultRecord {
+    uint64_t time_us;           // Unix时间（微秒）
+    uint64_t request_id;
+    uint64_t input_hash;        // 图像base64文本与特征值的内容哈希
+    uint32_t rknn_model;        // 模型文件内容哈希低32位，作为版本号
+    uint32_t svm_model;
+    int32_t class_id;
+    uint32_t flags;             // ResultFlags
+    float probability;
+    float svm_score;            // 特征模型预测的类别（与 inference_results.csv 相同）
+    float rknn_score;
+    uint32_t reserved0;
+    uint32_t stage_us[kStageCount];
+    float svm_probs[kResultClasses];   // 特征模型各类别概率，未运行时为0
+    float rknn_probs[kResultClasses];  // 图像模型各类别概率，未运行时为0
+};
+
+// 结果存储目录：results-YYYYmmdd-HHMMSS.bin 数据段 + 同名 .idx 稀疏时间索引
+// 索引每 kIndexBlock 条记录一项，记录该块的最早/最晚时间，查询时跳过不相交的块；
+// 尚未凑满一块的尾部记录直接顺序扫描。
+// 写入端只由结果写入线程调用；query() 只读，可在任意线程调用。
+class ResultStore {
+public:
+    static const uint32_t kIndexBlock = 256;
+
+    struct Options {
+        std::string dir;
+        uint64_t segment_bytes;  // 数据段超过该大小时新建下一段
+        uint64_t retain_bytes;   // 所有数据段合计上限，0 为不限制
+    };
+
+    // 查询回调，返回 false 时停止扫描
+    typedef bool (*Visitor)(const ResultRecord &rec, void *arg);
+
+    ResultStore();
+    ~ResultStore();
+
+    bool open(const Options &opt);
+    void close();
+    bool is_open() const { return fd_ >= 0; }
+
+    // 追加若干条记录；返回 false 表示写入失败
+    bool append(const ResultRecord *recs, size_t n);
+    void sync();
+
+    void write_metrics(JsonWriter &w) const;
+
+    // 扫描 [from_us, to_us] 内、类别匹配（class_id < 0 表示任意）的记录
+    // 返回扫描过的记录数
+    static uint64_t query(const std::string &dir, uint64_t from_us, uint64_t to_us,
+                          int class_id, Visitor visit, void *arg);
+
+private:
+    struct IndexEntry {
+        uint64_t min_us;
+        uint64_t max_us;
+        uint32_t first;   // 块内第一条记录的序号
+        uint32_t count;
+    };
+
+    bool create_segment(uint64_t now_us);
+    bool resume_segment(const std::string &path);
+    void flush_block();
+    void enforce_retention();
+
+    Options opt_;
+    int fd_;
+    int idx_fd_;
+    std::string path_;
+    uint64_t records_;       // 当前段记录数
+    IndexEntry block_;       // 当前未满的块
+
+    std::atomic<uint64_t> appended_;
+    std::atomic<uint64_t> segments_created_;
+    std::atomic<uint64_t> segments_deleted_;
+    std::atomic<uint64_t> errors_;
+};
+
+// 把查询参数中的Unix时间（秒，可带小数）解析为微秒，整个文本须为数字。
+// 非数字、负数、NaN 返回 false；超出 uint64 微秒范围时 clamp 为真取 UINT64_MAX
+// （用于区间上限），否则返回 false
+bool parse_unix_time_us(const char *text, bool clamp, uint64_t *out);
+
+#endif // _RESULT_STORE_H
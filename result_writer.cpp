@@ -0,0 +1,333 @@
+#include "result_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+
+// 缓冲区超过该大小或累计该行数时立即写出
+static const size_t kWriteChunk = 64 * 1024;
+static const size_t kMaxBatchRows = 512;
+// 队列为空时写入线程的最长休眠时间
+static const int kIdleWaitMs = 100;
+// 队列满时请求线程的最长等待时间，写入线程卡在 fsync 等操作上时不拖住请求
+static const int kFullWaitMs = 5;
+
+ResultWriter::ResultWriter()
+    : fd_(-1), file_bytes_(0), period_(-1), mask_(0), enqueue_pos_(0), dequeue_pos_(0),
+      sleeping_(false), flush_requested_(false), stop_(false), full_waiters_(0),
+      rows_since_flush_(0), cached_sec_(-1),
+      rows_enqueued_(0), rows_written_(0), flushes_(0), full_stalls_(0), rows_dropped_(0),
+      write_errors_(0),
+      rotations_(0) {
+    cached_time_[0] = '\0';
+}
+
+ResultWriter::~ResultWriter() {
+    stop();
+}
+
+bool ResultWriter::start(const Options &opt) {
+    opt_ = opt;
+    if (opt_.flush_rows == 0) opt_.flush_rows = 1;
+    if (!opt_.store_dir.empty()) {
+        ResultStore::Options store_opt;
+        store_opt.dir = opt_.store_dir;
+        store_opt.segment_bytes = opt_.store_segment_bytes;
+        store_opt.retain_bytes = opt_.store_retain_bytes;
+        store_.open(store_opt);  // 失败时只写CSV
+    }
+    if (!opt_.path.empty()) {
+        fd_ = open(opt_.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            printf("⚠️ 无法打开结果文件 %s: %s\n", opt_.path.c_str(), strerror(errno));
+        }
+    }
+    if (fd_ < 0 && !store_.is_open()) {
+        return false;
+    }
+    struct stat st;
+    if (fd_ >= 0 && fstat(fd_, &st) == 0) {
+        file_bytes_ = (uint64_t)st.st_size;
+    }
+    period_ = period_index(time(NULL));
+
+    if (fd_ >= 0 &&
+        (opt_.rotate_bytes > 0 || opt_.rotate_period_s > 0 || opt_.retain_bytes > 0)) {
+        LogArchiver::Options archive_opt;
+        archive_opt.path = opt_.path;
+        archive_opt.compress = opt_.compress;
+        archive_opt.retain_bytes = opt_.retain_bytes;
+        archiver_.start(archive_opt);
+    }
+
+    size_t capacity = 2;
+    while (capacity < opt_.queue_capacity) capacity <<= 1;
+    cells_.reset(new Cell[capacity]);
+    for (size_t i = 0; i < capacity; i++) {
+        cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+    mask_ = capacity - 1;
+    buf_.reserve(kWriteChunk * 2);
+    batch_.reserve(kMaxBatchRows);
+
+    thread_ = std::thread(&ResultWriter::run, this);
+    return true;
+}
+
+void ResultWriter::stop() {
+    if (!thread_.joinable()) return;
+    stop_ = true;
+    wake_cv_.notify_one();
+    {
+        std::lock_guard<std::mutex> lock(space_mutex_);
+        space_cv_.notify_all();
+    }
+    thread_.join();
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    store_.close();
+    archiver_.stop();
+}
+
+bool ResultWriter::push(const ResultRow &row) {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+        Cell &cell = cells_[pos & mask_];
+        size_t seq = cell.seq.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.row = row;
+                cell.seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;  // 队列已满
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool ResultWriter::pop(ResultRow *row) {
+    Cell &cell = cells_[dequeue_pos_ & mask_];
+    size_t seq = cell.seq.load(std::memory_order_acquire);
+    if (seq != dequeue_pos_ + 1) return false;
+    *row = cell.row;
+    cell.seq.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+    dequeue_pos_++;
+    return true;
+}
+
+bool ResultWriter::enqueue(const ResultRow &row) {
+    if (!cells_ || stop_.load()) return false;
+    if (!push(row)) {
+        full_stalls_++;
+        wake_cv_.notify_one();
+        std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(kFullWaitMs);
+        std::unique_lock<std::mutex> lock(space_mutex_);
+        full_waiters_++;
+        bool pushed = push(row);
+        while (!pushed && !stop_.load() &&
+               space_cv_.wait_until(lock, deadline) != std::cv_status::timeout) {
+            pushed = push(row);
+        }
+        if (!pushed && !stop_.load()) pushed = push(row);
+        full_waiters_--;
+        if (!pushed) {
+            rows_dropped_++;
+            return false;
+        }
+    }
+    // 用 fetch_add 的返回值判断，并发入队时每个 flush_rows 的整数倍都恰好有一个线程看到
+    uint64_t enqueued = rows_enqueued_.fetch_add(1) + 1;
+    if (sleeping_.load(std::memory_order_relaxed) && enqueued % opt_.flush_rows == 0) {
+        wake_cv_.notify_one();
+    }
+    return true;
+}
+
+void ResultWriter::request_flush() {
+    flush_requested_ = true;
+    wake_cv_.notify_one();
+}
+
+// 同一秒内的时间戳复用上次格式化结果，localtime_r 为线程安全版本
+const char *ResultWriter::format_time(int64_t sec) {
+    if (sec != cached_sec_) {
+        time_t t = (time_t)sec;
+        struct tm tm;
+        localtime_r(&t, &tm);
+        strftime(cached_time_, sizeof(cached_time_), "%Y-%m-%d %H:%M:%S", &tm);
+        cached_sec_ = sec;
+    }
+    return cached_time_;
+}
+
+void ResultWriter::append_row(const ResultRow &row) {
+    const ResultRecord &rec = row.record;
+    if (fd_ >= 0) {
+        // 数值格式与原先 std::ofstream 默认输出一致（%g）
+        char line[160];
+        int n = snprintf(line, sizeof(line), "%s,%d,%g,%g,%g,%g\n",
+                         format_time((int64_t)(rec.time_us / 1000000ULL)), rec.class_id,
+                         rec.probability, rec.svm_score, rec.rknn_score, row.processing_time);
+        if (n > 0) {
+            buf_.append(line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1);
+        }
+    }
+    if (store_.is_open()) {
+        batch_.push_back(rec);
+    }
+    rows_since_flush_++;
+}
+
+void ResultWriter::flush() {
+    if (!batch_.empty()) {
+        store_.append(batch_.data(), batch_.size());
+        if (opt_.fsync) store_.sync();
+    }
+    bool wrote = !buf_.empty() || !batch_.empty();
+    batch_.clear();
+
+    size_t off = 0;
+    while (off < buf_.size()) {
+        ssize_t n = write(fd_, buf_.data() + off, buf_.size() - off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            write_errors_++;
+            printf("⚠️ 写入结果文件失败: %s\n", strerror(errno));
+            break;
+        }
+        off += (size_t)n;
+    }
+    file_bytes_ += off;
+    if (opt_.fsync && !buf_.empty()) {
+        fdatasync(fd_);
+    }
+    if (wrote) {
+        flushes_++;
+    }
+    rows_written_ += rows_since_flush_;
+    rows_since_flush_ = 0;
+    buf_.clear();
+}
+
+void ResultWriter::run() {
+    for (;;) {
+        bool stopping = stop_.load();
+        size_t drained = 0;
+        ResultRow row;
+        while (buf_.size() < kWriteChunk && rows_since_flush_ < kMaxBatchRows && pop(&row)) {
+            append_row(row);
+            drained++;
+        }
+        if (drained && full_waiters_.load() > 0) {
+            std::lock_guard<std::mutex> lock(space_mutex_);
+            space_cv_.notify_all();
+        }
+
+        if (buf_.size() >= kWriteChunk || rows_since_flush_ >= opt_.flush_rows ||
+            rows_since_flush_ >= kMaxBatchRows || flush_requested_.exchange(false)) {
+            flush();
+        }
+        if (rows_since_flush_ == 0 && fd_ >= 0) {
+            maybe_rotate();
+        }
+        if (stopping && drained == 0) {
+            flush();  // stop() 之后队列已取空
+            return;
+        }
+        if (drained) continue;
+
+        // 队列为空：休眠到有新数据、定时刷新或超时
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        sleeping_ = true;
+        wake_cv_.wait_for(lock, std::chrono::milliseconds(kIdleWaitMs));
+        sleeping_ = false;
+    }
+}
+
+// 周期按本地时间对齐，例如86400即每天零点轮转
+int64_t ResultWriter::period_index(time_t now) const {
+    if (opt_.rotate_period_s <= 0) return 0;
+    struct tm tm;
+    localtime_r(&now, &tm);
+    return ((int64_t)now + tm.tm_gmtoff) / opt_.rotate_period_s;
+}
+
+void ResultWriter::maybe_rotate() {
+    if (file_bytes_ == 0) return;  // 空文件不轮转
+    time_t now = time(NULL);
+    int64_t period = period_index(now);
+    if ((opt_.rotate_bytes > 0 && file_bytes_ >= opt_.rotate_bytes) ||
+        (opt_.rotate_period_s > 0 && period != period_)) {
+        if (rotate(now)) {
+            period_ = period;
+        }
+    }
+}
+
+// 只有写入线程写这个文件，rename 后重新打开即可，不会丢行
+bool ResultWriter::rotate(time_t now) {
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+
+    std::string segment = opt_.path + "." + stamp;
+    struct stat st;
+    for (int i = 1; stat(segment.c_str(), &st) == 0 ||
+                    stat((segment + ".gz").c_str(), &st) == 0; i++) {
+        char suffix[16];
+        snprintf(suffix, sizeof(suffix), ".%03d", i);  // 补零以保持字典序
+        segment = opt_.path + "." + stamp + suffix;
+    }
+
+    if (rename(opt_.path.c_str(), segment.c_str()) != 0) {
+        write_errors_++;
+        printf("⚠️ 轮转结果文件失败: %s\n", strerror(errno));
+        return false;
+    }
+    int fd = open(opt_.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        // 继续写入已改名的文件，下次再试
+        write_errors_++;
+        printf("⚠️ 无法重新打开结果文件 %s: %s\n", opt_.path.c_str(), strerror(errno));
+        rename(segment.c_str(), opt_.path.c_str());
+        return false;
+    }
+    close(fd_);
+    fd_ = fd;
+    file_bytes_ = 0;
+    rotations_++;
+    printf("🔄 结果文件已轮转: %s\n", segment.c_str());
+    archiver_.submit(segment);
+    return true;
+}
+
+void ResultWriter::write_metrics(JsonWriter &w) const {
+    w.begin_object("result_writer");
+    w.field("path", opt_.path.c_str());
+    w.field("rows_enqueued", (uint64_t)rows_enqueued_.load());
+    w.field("rows_written", (uint64_t)rows_written_.load());
+    w.field("pending", (uint64_t)(rows_enqueued_.load() - rows_written_.load()));
+    w.field("flushes", (uint64_t)flushes_.load());
+    w.field("queue_full_stalls", (uint64_t)full_stalls_.load());
+    w.field("rows_dropped", (uint64_t)rows_dropped_.load());
+    w.field("write_errors", (uint64_t)write_errors_.load());
+    w.field("rotations", (uint64_t)rotations_.load());
+    archiver_.write_metrics(w);
+    if (store_.is_open()) {
+        store_.write_metrics(w);
+    }
+    w.end_object();
+}
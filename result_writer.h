@@ -0,0 +1,118 @@
+#ifndef _RESULT_WRITER_H
+#define _RESULT_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "log_archiver.h"
+#include "metrics.h"
+#include "result_store.h"
+
+// 一条推理结果
+struct ResultRow {
+    ResultRecord record;     // 写入二进制结果存储的完整记录
+    double processing_time;  // 秒，CSV沿用原先的格式
+};
+
+// 后台结果写入线程
+// 请求线程只做一次无锁入队（有界MPSC环形队列），队列满时短暂等待，仍满则丢弃该行；
+// 写入线程保持文件常开，把多行拼成大块后一次 write()，按行数或定时器触发刷新，可选 fsync。
+// 文件达到大小上限或跨过轮转周期时，在两次写出之间 rename 并重新打开，
+// 分段交给 LogArchiver 在后台压缩与清理。
+// 配置了 store_dir 时同一批记录同时追加到二进制结果存储（ResultStore）。
+class ResultWriter {
+public:
+    struct Options {
+        std::string path;       // CSV文件，为空时不写CSV
+        size_t flush_rows;      // 累计多少行刷新一次
+        bool fsync;             // 每次刷新后 fsync
+        size_t queue_capacity;  // 队列容量，向上取整为2的幂
+        uint64_t rotate_bytes;  // 文件超过该大小时轮转，0 为关闭
+        int rotate_period_s;    // 按本地时间对齐的轮转周期（秒），0 为关闭
+        bool compress;          // gzip压缩轮转出的分段
+        uint64_t retain_bytes;  // 分段合计上限，0 为不限制
+        std::string store_dir;          // 二进制结果存储目录，为空时关闭
+        uint64_t store_segment_bytes;   // 数据段大小
+        uint64_t store_retain_bytes;    // 数据段合计上限，0 为不限制
+    };
+
+    ResultWriter();
+    ~ResultWriter();
+
+    bool start(const Options &opt);
+    // 写出队列与缓冲区中剩余的数据后退出写入线程
+    void stop();
+
+    // 请求线程调用；队列满时等待写入线程腾出空间，最多5ms，
+    // 仍满则丢弃该行并计数。丢弃或 stop() 之后返回 false
+    bool enqueue(const ResultRow &row);
+    // 由 mg_timer_add 的定时回调调用，要求写入线程尽快刷新
+    void request_flush();
+
+    void write_metrics(JsonWriter &w) const;
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        ResultRow row;
+    };
+
+    bool push(const ResultRow &row);
+    bool pop(ResultRow *row);
+    void run();
+    void append_row(const ResultRow &row);
+    void flush();
+    const char *format_time(int64_t sec);
+    void maybe_rotate();
+    bool rotate(time_t now);
+    int64_t period_index(time_t now) const;
+
+    Options opt_;
+    int fd_;
+    uint64_t file_bytes_;   // 当前文件大小，仅写入线程访问
+    int64_t period_;        // 当前文件所属的轮转周期序号
+    LogArchiver archiver_;
+    ResultStore store_;
+    std::vector<ResultRecord> batch_;  // 待追加到 store_ 的记录，仅写入线程访问
+
+    // 有界MPSC队列（Vyukov 序号环）
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    std::atomic<size_t> enqueue_pos_;
+    size_t dequeue_pos_;  // 仅写入线程访问
+
+    std::thread thread_;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::atomic<bool> sleeping_;
+    std::atomic<bool> flush_requested_;
+    std::atomic<bool> stop_;
+
+    // 队列满时请求线程在此等待，写入线程取出数据后唤醒
+    std::mutex space_mutex_;
+    std::condition_variable space_cv_;
+    std::atomic<int> full_waiters_;
+
+    // 以下仅写入线程访问
+    std::string buf_;
+    size_t rows_since_flush_;
+    int64_t cached_sec_;
+    char cached_time_[32];
+
+    std::atomic<uint64_t> rows_enqueued_;
+    std::atomic<uint64_t> rows_written_;
+    std::atomic<uint64_t> flushes_;
+    std::atomic<uint64_t> full_stalls_;
+    std::atomic<uint64_t> rows_dropped_;
+    std::atomic<uint64_t> write_errors_;
+    std::atomic<uint64_t> rotations_;
+};
+
+#endif // _RESULT_WRITER_H
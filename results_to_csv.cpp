@@ -0,0 +1,80 @@
+// 把二进制结果存储导出为CSV
+// 用法: results_to_csv <存储目录> [from] [to] [class]
+//   from/to 为Unix时间（秒），class 为类别编号，省略表示不限
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <stdint.h>
+
+#include "result_store.h"
+
+static bool print_record(const ResultRecord &rec, void *arg) {
+    (void)arg;
+    time_t sec = (time_t)(rec.time_us / 1000000ULL);
+    struct tm tm;
+    localtime_r(&sec, &tm);
+    char when[32];
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+
+    // 前六列与 inference_results.csv 相同
+    printf("%s,%d,%g,%g,%g,%g,%llu,%d,%d,%d,%d,%d,%d,%016llx,%08x,%08x",
+           when, rec.class_id, rec.probability, rec.svm_score, rec.rknn_score,
+           rec.stage_us[kStageTotal] / 1e6,
+           (unsigned long long)rec.request_id,
+           (rec.flags & kResultFeatureOnly) ? 1 : 0,
+           (rec.flags & kResultDegraded) ? 1 : 0,
+           (rec.flags & kResultCached) ? 1 : 0,
+           (rec.flags & kResultCoalesced) ? 1 : 0,
+           (rec.flags & kResultNearDuplicate) ? 1 : 0,
+           (rec.flags & kResultCpuBackend) ? 1 : 0,
+           (unsigned long long)rec.input_hash, rec.rknn_model, rec.svm_model);
+    for (int i = 0; i < kStageCount; i++) {
+        printf(",%u", rec.stage_us[i]);
+    }
+    for (int i = 0; i < kResultClasses; i++) {
+        printf(",%g", rec.svm_probs[i]);
+    }
+    for (int i = 0; i < kResultClasses; i++) {
+        printf(",%g", rec.rknn_probs[i]);
+    }
+    printf("\n");
+    return true;
+}
+
+static int usage(const char *prog) {
+    fprintf(stderr, "用法: %s <存储目录> [from] [to] [class]\n", prog);
+    fprintf(stderr, "  from/to 为非负的Unix时间（秒，可带小数）\n");
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) return usage(argv[0]);
+    uint64_t from_us = 0, to_us = UINT64_MAX;
+    if (argc > 2 && !parse_unix_time_us(argv[2], false, &from_us)) {
+        fprintf(stderr, "无效的 from: %s\n", argv[2]);
+        return usage(argv[0]);
+    }
+    if (argc > 3 && !parse_unix_time_us(argv[3], true, &to_us)) {
+        fprintf(stderr, "无效的 to: %s\n", argv[3]);
+        return usage(argv[0]);
+    }
+    int class_id = argc > 4 ? atoi(argv[4]) : -1;
+
+    printf("time,class,probability,blood_score,rknn_score,processing_time,"
+           "request_id,feature_only,degraded,cached,coalesced,near_duplicate,cpu_backend,input_hash,rknn_model,svm_model");
+    for (int i = 0; i < kStageCount; i++) {
+        printf(",%s_us", kResultStageNames[i]);
+    }
+    for (int i = 0; i < kResultClasses; i++) {
+        printf(",svm_prob%d", i);
+    }
+    for (int i = 0; i < kResultClasses; i++) {
+        printf(",rknn_prob%d", i);
+    }
+    printf("\n");
+
+    uint64_t scanned = ResultStore::query(argv[1], from_us, to_us, class_id, print_record, NULL);
+    fprintf(stderr, "扫描 %llu 条记录\n", (unsigned long long)scanned);
+    return 0;
+}
@@ -0,0 +1,238 @@
+// 主机端的 librknn_api 替身（HOST_BUILD=ON 时代替板端的 librknn_api.so）
+// 不做真实推理：按环境变量模拟输入形状、推理耗时与NPU并发能力，
+// 输出由输入内容哈希得到，同一图像每次得到相同的类别。
+//
+//   RKNN_MOCK_INPUT=224x224   输入宽x高
+//   RKNN_MOCK_BATCH=1         输入批大小
+//   RKNN_MOCK_CLASSES=3       每张图像的输出个数
+//   RKNN_MOCK_RUN_US=8000     每次 rknn_run 的固定耗时（延迟）
+//   RKNN_MOCK_ITEM_US=0       批内每张图像追加的耗时
+//   RKNN_MOCK_CORES=1         可同时执行 rknn_run 的数量（吞吐上限）
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "rknn_api.h"
+
+namespace {
+
+struct MockConfig {
+    int width, height, batch, classes;
+    int run_us, item_us, cores;
+};
+
+int env_int(const char *name, int def) {
+    const char *v = getenv(name);
+    return v && *v ? atoi(v) : def;
+}
+
+const MockConfig &config() {
+    static MockConfig cfg = []() {
+        MockConfig c;
+        c.width = 224;
+        c.height = 224;
+        const char *input = getenv("RKNN_MOCK_INPUT");
+        if (input) sscanf(input, "%dx%d", &c.width, &c.height);
+        c.batch = env_int("RKNN_MOCK_BATCH", 1);
+        c.classes = env_int("RKNN_MOCK_CLASSES", 3);
+        c.run_us = env_int("RKNN_MOCK_RUN_US", 8000);
+        c.item_us = env_int("RKNN_MOCK_ITEM_US", 0);
+        c.cores = env_int("RKNN_MOCK_CORES", 1);
+        if (c.batch < 1) c.batch = 1;
+        if (c.classes < 1) c.classes = 1;
+        if (c.cores < 1) c.cores = 1;
+        return c;
+    }();
+    return cfg;
+}
+
+// 模拟的NPU核心：所有上下文共享
+std::mutex s_core_mutex;
+std::condition_variable s_core_cv;
+int s_cores_busy = 0;
+
+struct MockContext {
+    std::vector<float> scores;  // 上一次 rknn_run 的输出
+    int64_t last_run_us;
+};
+
+size_t input_bytes() {
+    const MockConfig &c = config();
+    return (size_t)c.width * c.height * 3 * c.batch;
+}
+
+MockContext *get(rknn_context ctx) {
+    return (MockContext *)(uintptr_t)ctx;
+}
+
+// FNV-1a
+uint64_t hash_bytes(const uint8_t *p, size_t n) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < n; i++) {
+        h = (h ^ p[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+}  // namespace
+
+int rknn_init(rknn_context *context, void *model, uint32_t size, uint32_t flag) {
+    (void)model;
+    (void)size;
+    (void)flag;
+    MockContext *ctx = new MockContext();
+    ctx->last_run_us = 0;
+    *context = (rknn_context)(uintptr_t)ctx;
+    const MockConfig &c = config();
+    fprintf(stderr, "[rknn mock] 输入 %dx%d 批大小 %d, 输出 %d, 单次 %d+%d*N 微秒, 并发 %d\n",
+            c.width, c.height, c.batch, c.classes, c.run_us, c.item_us, c.cores);
+    return RKNN_SUCC;
+}
+
+int rknn_destroy(rknn_context context) {
+    delete get(context);
+    return RKNN_SUCC;
+}
+
+int rknn_query(rknn_context context, rknn_query_cmd cmd, void *info, uint32_t size) {
+    const MockConfig &c = config();
+    switch (cmd) {
+    case RKNN_QUERY_IN_OUT_NUM: {
+        if (size < sizeof(rknn_input_output_num)) return RKNN_ERR_PARAM_INVALID;
+        rknn_input_output_num *num = (rknn_input_output_num *)info;
+        num->n_input = 1;
+        num->n_output = 1;
+        return RKNN_SUCC;
+    }
+    case RKNN_QUERY_INPUT_ATTR:
+    case RKNN_QUERY_OUTPUT_ATTR: {
+        if (size < sizeof(rknn_tensor_attr)) return RKNN_ERR_PARAM_INVALID;
+        rknn_tensor_attr *attr = (rknn_tensor_attr *)info;
+        uint32_t index = attr->index;
+        if (index != 0) return RKNN_ERR_PARAM_INVALID;
+        memset(attr, 0, sizeof(*attr));
+        attr->index = index;
+        if (cmd == RKNN_QUERY_INPUT_ATTR) {
+            // 与 RKNN 1.x 相同，dims 顺序与 NHWC 相反
+            attr->n_dims = 4;
+            attr->dims[0] = 3;
+            attr->dims[1] = c.width;
+            attr->dims[2] = c.height;
+            attr->dims[3] = c.batch;
+            attr->n_elems = (uint32_t)input_bytes();
+            attr->size = attr->n_elems;
+            attr->fmt = RKNN_TENSOR_NHWC;
+            attr->type = RKNN_TENSOR_UINT8;
+            snprintf(attr->name, sizeof(attr->name), "input");
+        } else {
+            attr->n_dims = 2;
+            attr->dims[0] = c.classes;
+            attr->dims[1] = c.batch;
+            attr->n_elems = c.classes * c.batch;
+            attr->size = attr->n_elems * sizeof(float);
+            attr->fmt = RKNN_TENSOR_NCHW;
+            attr->type = RKNN_TENSOR_FLOAT32;
+            snprintf(attr->name, sizeof(attr->name), "output");
+        }
+        return RKNN_SUCC;
+    }
+    case RKNN_QUERY_PERF_RUN: {
+        if (size < sizeof(rknn_perf_run)) return RKNN_ERR_PARAM_INVALID;
+        ((rknn_perf_run *)info)->run_duration = get(context)->last_run_us;
+        return RKNN_SUCC;
+    }
+    case RKNN_QUERY_SDK_VERSION: {
+        if (size < sizeof(rknn_sdk_version)) return RKNN_ERR_PARAM_INVALID;
+        rknn_sdk_version *v = (rknn_sdk_version *)info;
+        snprintf(v->api_version, sizeof(v->api_version), "mock");
+        snprintf(v->drv_version, sizeof(v->drv_version), "mock");
+        return RKNN_SUCC;
+    }
+    default:
+        return RKNN_ERR_PARAM_INVALID;
+    }
+}
+
+int rknn_inputs_set(rknn_context context, uint32_t n_inputs, rknn_input inputs[]) {
+    const MockConfig &c = config();
+    if (n_inputs != 1 || inputs[0].index != 0 || inputs[0].size != input_bytes()) {
+        fprintf(stderr, "[rknn mock] 输入大小 %u 与模型 %zu 不符\n",
+                n_inputs ? inputs[0].size : 0, input_bytes());
+        return RKNN_ERR_INPUT_INVALID;
+    }
+    // 设置输入时即算好输出，rknn_run 只负责模拟耗时
+    MockContext *ctx = get(context);
+    size_t item = input_bytes() / c.batch;
+    ctx->scores.assign((size_t)c.classes * c.batch, 0.0f);
+    for (int b = 0; b < c.batch; b++) {
+        uint64_t h = hash_bytes((const uint8_t *)inputs[0].buf + b * item, item);
+        float *out = &ctx->scores[(size_t)b * c.classes];
+        for (int k = 0; k < c.classes; k++) {
+            out[k] = (float)((h >> ((k * 8) % 64)) & 0xff) / 32.0f;
+        }
+    }
+    return RKNN_SUCC;
+}
+
+int rknn_run(rknn_context context, rknn_run_extend *extend) {
+    const MockConfig &c = config();
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::unique_lock<std::mutex> lock(s_core_mutex);
+        s_core_cv.wait(lock, [&c]() { return s_cores_busy < c.cores; });
+        s_cores_busy++;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(c.run_us + c.item_us * c.batch));
+    {
+        std::lock_guard<std::mutex> lock(s_core_mutex);
+        s_cores_busy--;
+    }
+    s_core_cv.notify_one();
+    get(context)->last_run_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    if (extend) extend->frame_id = 0;
+    return RKNN_SUCC;
+}
+
+int rknn_outputs_get(rknn_context context, uint32_t n_outputs, rknn_output outputs[],
+                     rknn_output_extend *extend) {
+    MockContext *ctx = get(context);
+    if (n_outputs != 1 || ctx->scores.empty() || !outputs[0].want_float) {
+        return RKNN_ERR_OUTPUT_INVALID;
+    }
+    size_t bytes = ctx->scores.size() * sizeof(float);
+    if (outputs[0].is_prealloc) {
+        if (outputs[0].size < bytes) return RKNN_ERR_PARAM_INVALID;
+    } else {
+        outputs[0].buf = malloc(bytes);
+        outputs[0].size = (uint32_t)bytes;
+    }
+    memcpy(outputs[0].buf, ctx->scores.data(), bytes);
+    if (extend) extend->frame_id = 0;
+    return RKNN_SUCC;
+}
+
+int rknn_outputs_release(rknn_context context, uint32_t n_ouputs, rknn_output outputs[]) {
+    (void)context;
+    for (uint32_t i = 0; i < n_ouputs; i++) {
+        if (!outputs[i].is_prealloc) {
+            free(outputs[i].buf);
+            outputs[i].buf = NULL;
+        }
+    }
+    return RKNN_SUCC;
+}
+
+// 零拷贝接口未模拟
+int rknn_inputs_map(rknn_context, uint32_t, rknn_tensor_mem[]) { return RKNN_ERR_FAIL; }
+int rknn_inputs_sync(rknn_context, uint32_t, rknn_tensor_mem[]) { return RKNN_ERR_FAIL; }
+int rknn_inputs_unmap(rknn_context, uint32_t, rknn_tensor_mem[]) { return RKNN_ERR_FAIL; }
+int rknn_outputs_map(rknn_context, uint32_t, rknn_tensor_mem[]) { return RKNN_ERR_FAIL; }
+int rknn_outputs_sync(rknn_context, uint32_t, rknn_tensor_mem[]) { return RKNN_ERR_FAIL; }
+int rknn_outputs_unmap(rknn_context, uint32_t, rknn_tensor_mem[]) { return RKNN_ERR_FAIL; }
@@ -0,0 +1,117 @@
+#include "rknn_backend.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <iterator>
+
+RknnBackend::RknnBackend() : ctx_(0), loaded_(false), outputs_held_(false) {
+    memset(&io_, 0, sizeof(io_));
+}
+
+RknnBackend::~RknnBackend() {
+    release_outputs();
+    if (loaded_) {
+        rknn_destroy(ctx_);
+    }
+}
+
+bool RknnBackend::load(const std::string &model_path, std::string *error) {
+    std::ifstream in(model_path.c_str(), std::ios::binary);
+    if (!in) {
+        *error = "无法打开 " + model_path;
+        return false;
+    }
+    std::vector<char> model((std::istreambuf_iterator<char>(in)),
+                            std::istreambuf_iterator<char>());
+    if (rknn_init(&ctx_, model.data(), (uint32_t)model.size(), 0) < 0) {
+        *error = "rknn_init 失败";
+        return false;
+    }
+    loaded_ = true;
+
+    // 查询输入输出数量
+    if (rknn_query(ctx_, RKNN_QUERY_IN_OUT_NUM, &io_, sizeof(io_)) < 0 || io_.n_output == 0) {
+        *error = "查询输入输出数量失败";
+        return false;
+    }
+    outputs_.resize(io_.n_output);
+    output_bufs_.resize(io_.n_output);
+    for (uint32_t i = 0; i < io_.n_output; i++) {
+        rknn_tensor_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.index = i;
+        if (rknn_query(ctx_, RKNN_QUERY_OUTPUT_ATTR, &attr, sizeof(attr)) < 0) {
+            *error = "查询输出属性失败";
+            return false;
+        }
+        output_bufs_[i].resize(attr.n_elems);
+    }
+    return true;
+}
+
+bool RknnBackend::query(BackendAttrs *attrs) {
+    rknn_tensor_attr input_attr;
+    memset(&input_attr, 0, sizeof(input_attr));
+    input_attr.index = 0;
+    if (rknn_query(ctx_, RKNN_QUERY_INPUT_ATTR, &input_attr, sizeof(input_attr)) < 0) {
+        return false;
+    }
+    // RKNN 1.x 的 dims 与 NHWC 顺序相反：C, W, H, N
+    attrs->width = (int)input_attr.dims[1];
+    attrs->height = (int)input_attr.dims[2];
+    attrs->batch = input_attr.n_dims >= 4 ? (int)input_attr.dims[input_attr.n_dims - 1] : 1;
+    if (attrs->batch < 1) attrs->batch = 1;
+    attrs->n_outputs = (int)io_.n_output;
+    return true;
+}
+
+bool RknnBackend::set_input(const uint8_t *data, size_t bytes) {
+    rknn_input inputs[1];
+    memset(inputs, 0, sizeof(inputs));
+    inputs[0].index = 0;
+    inputs[0].buf = (void *)data;
+    inputs[0].size = (uint32_t)bytes;
+    inputs[0].pass_through = false;
+    inputs[0].type = RKNN_TENSOR_UINT8;
+    inputs[0].fmt = RKNN_TENSOR_NHWC;
+    if (rknn_inputs_set(ctx_, 1, inputs) < 0) {
+        fprintf(stderr, "设置输入失败\n");
+        return false;
+    }
+    return true;
+}
+
+bool RknnBackend::run() {
+    if (rknn_run(ctx_, nullptr) < 0) {
+        fprintf(stderr, "Inference failed\n");
+        return false;
+    }
+    return true;
+}
+
+bool RknnBackend::get_outputs(const float **data, size_t *count) {
+    release_outputs();
+    memset(outputs_.data(), 0, outputs_.size() * sizeof(rknn_output));
+    for (size_t i = 0; i < outputs_.size(); i++) {
+        outputs_[i].want_float = 1;
+        outputs_[i].is_prealloc = 1;
+        outputs_[i].buf = output_bufs_[i].data();
+        outputs_[i].size = (uint32_t)(output_bufs_[i].size() * sizeof(float));
+    }
+    if (rknn_outputs_get(ctx_, io_.n_output, outputs_.data(), NULL) < 0) {
+        fprintf(stderr, "获取输出失败\n");
+        return false;
+    }
+    outputs_held_ = true;
+    *data = (const float *)outputs_[0].buf;
+    *count = outputs_[0].size / sizeof(float);
+    return true;
+}
+
+void RknnBackend::release_outputs() {
+    if (outputs_held_) {
+        rknn_outputs_release(ctx_, io_.n_output, outputs_.data());
+        outputs_held_ = false;
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef _RKNN_BACKEND_H
+#define _RKNN_BACKEND_H
+
+#include <vector>
+
+#include "rknn_api.h"
+#include "inference_backend.h"
+
+// RV1126 NPU 后端（librknn_api 1.x）
+class RknnBackend : public InferenceBackend {
+public:
+    RknnBackend();
+    ~RknnBackend();
+
+    const char *name() const { return "rknn"; }
+    bool load(const std::string &model_path, std::string *error);
+    bool query(BackendAttrs *attrs);
+    bool set_input(const uint8_t *data, size_t bytes);
+    bool run();
+    bool get_outputs(const float **data, size_t *count);
+    void release_outputs();
+
+private:
+    rknn_context ctx_;
+    bool loaded_;
+    rknn_input_output_num io_;
+    std::vector<rknn_output> outputs_;
+    std::vector<std::vector<float> > output_bufs_;  // 预分配的输出缓冲，rknn_outputs_get 不再每次分配
+    bool outputs_held_;  // outputs_ 尚未 rknn_outputs_release
+};
+
+#endif // _RKNN_BACKEND_H
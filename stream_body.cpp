@@ -0,0 +1,108 @@
+#include "stream_body.h"
+
+#include <string.h>
+#include <time.h>
+
+static const char kImageKey[] = "\"image\":";
+static const size_t kImageKeyLen = sizeof(kImageKey) - 1;
+
+static double now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+StreamingBody::StreamingBody(size_t content_length, bool keep_text)
+    : content_length_(content_length), received_(0), keep_text_(keep_text),
+      state_(kSearchKey),
+      image_(new unsigned char[base64_decoded_capacity(content_length)]),
+      decoder_(image_.get()), check_hasher_(kContentCheckSeed), image_text_len_(0),
+      image_size_(0), image_hash_(0), image_check_(0),
+      format_(kImageUnknown), format_checked_(false), header_status_(kHeaderIncomplete),
+      info_(), decode_us_(0), error_(nullptr) {
+    if (keep_text_) text_.reserve(content_length);
+}
+
+bool StreamingBody::feed(const char *data, size_t len) {
+    if (len > remaining()) len = remaining();
+    received_ += len;
+    const char *p = data;
+    const char *end = data + len;
+    while (p < end) {
+        switch (state_) {
+        case kSearchKey:
+            // 逐字节保留，直到请求体文本以 "image": 结尾
+            text_ += *p++;
+            if (text_.size() >= kImageKeyLen &&
+                memcmp(text_.data() + text_.size() - kImageKeyLen, kImageKey, kImageKeyLen) == 0) {
+                state_ = kSearchQuote;
+            }
+            break;
+        case kSearchQuote:
+            text_ += *p;
+            if (*p++ == '"') state_ = kInImage;
+            break;
+        case kInImage: {
+            // 到闭合引号为止的整段一次解码
+            const char *quote = (const char *)memchr(p, '"', end - p);
+            const char *run_end = quote ? quote : end;
+            double t0 = now_us();
+            decoder_.feed(p, run_end - p);
+            hasher_.update(p, run_end - p);
+            check_hasher_.update(p, run_end - p);
+            decode_us_ += now_us() - t0;
+            if (keep_text_) text_.append(p, run_end - p);
+            image_text_len_ += run_end - p;
+            p = run_end;
+            if (!check_format()) return false;
+            check_header();
+            if (quote) {
+                text_ += '"';
+                p++;
+                state_ = kDone;
+            }
+            break;
+        }
+        case kDone:
+            text_.append(p, end - p);
+            p = end;
+            break;
+        }
+    }
+    if (complete()) finish();
+    return true;
+}
+
+bool StreamingBody::check_format() {
+    if (format_checked_ || decoder_.size() < kImageSniffBytes) return true;
+    format_checked_ = true;
+    format_ = sniff_image_format(image_.get(), decoder_.size());
+    if (format_ == kImageUnknown) {
+        error_ = "Unsupported image format";
+        return false;
+    }
+    return true;
+}
+
+void StreamingBody::check_header() {
+    if (header_status_ != kHeaderIncomplete || !format_checked_) return;
+    header_status_ = parse_image_header(image_.get(), decoder_.size(), &info_);
+}
+
+void StreamingBody::finish() {
+    if (state_ != kDone) {
+        // 没有完整的 image 字段，与缓冲模式一样按缺少图像处理
+        image_size_ = 0;
+        image_text_len_ = 0;
+        return;
+    }
+    image_size_ = decoder_.finish();
+    image_hash_ = image_text_len_ ? hasher_.digest() : 0;
+    image_check_ = image_text_len_ ? check_hasher_.digest() : 0;
+    if (!format_checked_) {
+        format_ = sniff_image_format(image_.get(), image_size_);
+    }
+    if (header_status_ == kHeaderIncomplete) {
+        header_status_ = parse_image_header(image_.get(), image_size_, &info_);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef _STREAM_BODY_H
+#define _STREAM_BODY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+
+#include "base64.h"
+#include "content_hash.h"
+#include "image_header.h"
+
+// 边接收边处理的 /api/classify 请求体（--stream-body）
+// 请求体按到达的分段依次 feed()：image 字段的内容直接Base64解码到按 Content-Length
+// 预分配的缓冲并同时计算其哈希，不在内存中保留Base64文本；其余部分（特征值等）
+// 原样保留在 text() 中，image 字段内容为空。解码出前 kImageSniffBytes 字节后即识别
+// 图像格式，不是支持的图像时提前结束，不必等整个请求体到达；之后继续尝试读取文件头中的
+// 尺寸（header_status()），调用方据此在请求体收完之前拒绝过大的图像。
+// 字段的定位方式与缓冲模式的 find_image_field 相同：第一个 "image": 之后的一对引号。
+class StreamingBody {
+public:
+    // keep_text 为 true 时 text() 保留完整的请求体（流量采集需要原始请求）
+    StreamingBody(size_t content_length, bool keep_text);
+
+    // 返回 false 表示图像格式无法识别，error() 给出原因
+    bool feed(const char *data, size_t len);
+
+    size_t content_length() const { return content_length_; }
+    size_t remaining() const { return content_length_ - received_; }
+    bool complete() const { return received_ == content_length_; }
+    const char *error() const { return error_; }
+
+    // 读到尺寸后为 kHeaderParsed，之后不再变化
+    ImageHeaderStatus header_status() const { return header_status_; }
+    const ImageInfo &image_info() const { return info_; }
+
+    // 以下在 complete() 之后有效
+    const std::string &text() const { return text_; }
+    std::string take_text() { return std::move(text_); }
+    bool has_image() const { return state_ == kDone; }
+    size_t image_text_len() const { return image_text_len_; }
+    uint64_t image_hash() const { return image_hash_; }  // image字段文本的 content_hash64
+    uint64_t image_check() const { return image_check_; }  // 同上，种子为 kContentCheckSeed
+    const unsigned char *image() const { return image_.get(); }
+    size_t image_size() const { return image_size_; }
+    ImageFormat image_format() const { return format_; }
+    double decode_us() const { return decode_us_; }
+
+private:
+    enum State { kSearchKey, kSearchQuote, kInImage, kDone };
+
+    void finish();
+    bool check_format();
+    void check_header();
+
+    size_t content_length_;
+    size_t received_;
+    bool keep_text_;
+    State state_;
+    std::string text_;
+    std::unique_ptr<unsigned char[]> image_;
+    Base64StreamDecoder decoder_;
+    ContentHasher hasher_;
+    ContentHasher check_hasher_;
+    size_t image_text_len_;
+    size_t image_size_;
+    uint64_t image_hash_;
+    uint64_t image_check_;
+    ImageFormat format_;
+    bool format_checked_;
+    ImageHeaderStatus header_status_;
+    ImageInfo info_;
+    double decode_us_;
+    const char *error_;
+};
+
+#endif // _STREAM_BODY_H
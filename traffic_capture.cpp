@@ -0,0 +1,189 @@
+#include "traffic_capture.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <chrono>
+
+TrafficCapture::TrafficCapture()
+    : file_(NULL), running_(false), queued_bytes_(0), stop_(false),
+      records_(0), dropped_(0), raw_bytes_(0) {
+    opt_.sample = 1;
+    opt_.max_bytes = 0;
+    opt_.queue_bytes = 0;
+}
+
+TrafficCapture::~TrafficCapture() {
+    stop();
+}
+
+bool TrafficCapture::start(const Options &opt) {
+    opt_ = opt;
+    if (opt_.sample < 1) opt_.sample = 1;
+    if (mkdir(opt_.dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "无法创建流量存档目录 %s: %s\n", opt_.dir.c_str(), strerror(errno));
+        return false;
+    }
+    char name[64];
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    strftime(name, sizeof(name), "/traffic-%Y%m%d-%H%M%S.atkcap.gz", &tm);
+    path_ = opt_.dir + name;
+    // 压缩级别1：请求体主要是base64文本，低级别已能去掉大部分冗余
+    file_ = gzopen(path_.c_str(), "ab1");
+    if (!file_) {
+        fprintf(stderr, "无法打开流量存档 %s\n", path_.c_str());
+        return false;
+    }
+    gzwrite(file_, kTrafficFileMagic, sizeof(kTrafficFileMagic));
+    stop_ = false;
+    running_ = true;
+    thread_ = std::thread(&TrafficCapture::run, this);
+    printf("📼 流量采集已开启: %s (每 %d 个请求采集1个)\n", path_.c_str(), opt_.sample);
+    return true;
+}
+
+void TrafficCapture::stop() {
+    if (!thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+    running_ = false;
+    gzclose(file_);
+    file_ = NULL;
+}
+
+void TrafficCapture::record(uint64_t arrival_us, double latency_us, int status,
+                            const std::string &body, const std::string &response) {
+    size_t bytes = body.size() + response.size();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_ || queued_bytes_ + bytes > opt_.queue_bytes) {
+        dropped_++;
+        return;
+    }
+    queue_.push_back(TrafficRecord());
+    TrafficRecord &rec = queue_.back();
+    rec.arrival_us = arrival_us;
+    rec.latency_us = latency_us > 0 ? (uint32_t)latency_us : 0;
+    rec.status = status;
+    rec.body = body;
+    rec.response = response;
+    queued_bytes_ += bytes;
+    cv_.notify_one();
+}
+
+void TrafficCapture::run() {
+    bool full = false;
+    bool dirty = false;
+    auto last_flush = std::chrono::steady_clock::now();
+    for (;;) {
+        // 每秒至少刷新一次，异常退出最多丢失最近1秒的记录
+        auto now = std::chrono::steady_clock::now();
+        if (dirty && now - last_flush >= std::chrono::seconds(1)) {
+            gzflush(file_, Z_SYNC_FLUSH);
+            last_flush = now;
+            dirty = false;
+        }
+        TrafficRecord rec;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!cv_.wait_for(lock, std::chrono::seconds(1),
+                              [this]() { return stop_ || !queue_.empty(); })) {
+                continue;
+            }
+            if (queue_.empty()) break;  // stop_
+            rec.body.swap(queue_.front().body);
+            rec.response.swap(queue_.front().response);
+            rec.arrival_us = queue_.front().arrival_us;
+            rec.latency_us = queue_.front().latency_us;
+            rec.status = queue_.front().status;
+            queue_.pop_front();
+            queued_bytes_ -= rec.body.size() + rec.response.size();
+        }
+        if (!full && opt_.max_bytes > 0 && (uint64_t)gzoffset(file_) >= opt_.max_bytes) {
+            full = true;
+            printf("⚠️ 流量存档达到上限 %llu 字节，停止采集\n",
+                   (unsigned long long)opt_.max_bytes);
+        }
+        if (full) {
+            dropped_++;
+            continue;
+        }
+        TrafficRecordHeader h;
+        memset(&h, 0, sizeof(h));
+        h.magic = kTrafficRecordMagic;
+        h.latency_us = rec.latency_us;
+        h.arrival_us = rec.arrival_us;
+        h.status = rec.status;
+        h.body_len = (uint32_t)rec.body.size();
+        h.response_len = (uint32_t)rec.response.size();
+        gzwrite(file_, &h, sizeof(h));
+        gzwrite(file_, rec.body.data(), (unsigned)rec.body.size());
+        gzwrite(file_, rec.response.data(), (unsigned)rec.response.size());
+        dirty = true;
+        records_++;
+        raw_bytes_ += sizeof(h) + rec.body.size() + rec.response.size();
+    }
+}
+
+void TrafficCapture::write_metrics(JsonWriter &w) const {
+    w.begin_object("capture");
+    w.field("enabled", running_);
+    if (running_) {
+        w.field("file", path_.c_str());
+        w.field("sample", (uint64_t)opt_.sample);
+    }
+    w.field("records", (uint64_t)records_.load());
+    w.field("dropped", (uint64_t)dropped_.load());
+    w.field("raw_bytes", (uint64_t)raw_bytes_.load());
+    w.end_object();
+}
+
+bool TrafficReader::open(const std::string &path, std::string *error) {
+    close();
+    file_ = gzopen(path.c_str(), "rb");
+    if (!file_) {
+        *error = "无法打开 " + path;
+        return false;
+    }
+    char magic[sizeof(kTrafficFileMagic)];
+    if (gzread(file_, magic, sizeof(magic)) != (int)sizeof(magic) ||
+        memcmp(magic, kTrafficFileMagic, sizeof(magic)) != 0) {
+        *error = path + " 不是流量存档";
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool TrafficReader::next(TrafficRecord *rec) {
+    TrafficRecordHeader h;
+    if (!file_ || gzread(file_, &h, sizeof(h)) != (int)sizeof(h) ||
+        h.magic != kTrafficRecordMagic) {
+        return false;
+    }
+    rec->arrival_us = h.arrival_us;
+    rec->latency_us = h.latency_us;
+    rec->status = h.status;
+    rec->body.resize(h.body_len);
+    rec->response.resize(h.response_len);
+    if ((h.body_len && gzread(file_, &rec->body[0], h.body_len) != (int)h.body_len) ||
+        (h.response_len &&
+         gzread(file_, &rec->response[0], h.response_len) != (int)h.response_len)) {
+        return false;
+    }
+    return true;
+}
+
+void TrafficReader::close() {
+    if (file_) {
+        gzclose(file_);
+        file_ = NULL;
+    }
+}
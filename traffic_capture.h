@@ -0,0 +1,104 @@
+#ifndef _TRAFFIC_CAPTURE_H
+#define _TRAFFIC_CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <zlib.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "metrics.h"
+
+// 流量存档：/api/classify 的请求体与到达时间、原始耗时、状态码和响应体，
+// 供 replay 工具按原始节奏重放并比较结果。
+// 文件为gzip压缩的追加写入流：8字节文件头 "ATKCAP01"，之后每条记录为
+// TrafficRecordHeader（小端）+ 请求体 + 响应体。进程异常退出时已刷新的记录仍可读出。
+struct TrafficRecordHeader {
+    uint32_t magic;        // kTrafficRecordMagic
+    uint32_t latency_us;   // 服务端从收到完整请求到生成响应的耗时
+    uint64_t arrival_us;   // 收到请求的Unix时间（微秒）
+    int32_t status;        // HTTP状态码
+    uint32_t body_len;
+    uint32_t response_len;
+    uint32_t reserved;
+};
+
+static const char kTrafficFileMagic[8] = {'A', 'T', 'K', 'C', 'A', 'P', '0', '1'};
+static const uint32_t kTrafficRecordMagic = 0x52435441;  // "ATCR"
+
+struct TrafficRecord {
+    uint64_t arrival_us;
+    uint32_t latency_us;
+    int status;
+    std::string body;
+    std::string response;
+};
+
+// 服务器端的采集：请求线程只把记录放入队列，由后台线程压缩写出；
+// 队列积压超过上限或文件达到大小上限时丢弃新记录并计数
+class TrafficCapture {
+public:
+    struct Options {
+        std::string dir;        // 存档目录，文件名为 traffic-<启动时间>.atkcap.gz
+        int sample;             // 每 sample 个请求采集一个，1 为全部
+        uint64_t max_bytes;     // 单个存档压缩后的大小上限，0 为不限制
+        size_t queue_bytes;     // 待写出数据上限
+    };
+
+    TrafficCapture();
+    ~TrafficCapture();
+
+    bool start(const Options &opt);
+    void stop();
+
+    bool enabled() const { return running_; }
+    // 按请求编号抽样
+    bool sampled(uint64_t request_id) const {
+        return running_ && request_id % (uint64_t)opt_.sample == 0;
+    }
+
+    void record(uint64_t arrival_us, double latency_us, int status,
+                const std::string &body, const std::string &response);
+
+    void write_metrics(JsonWriter &w) const;
+
+private:
+    void run();
+
+    Options opt_;
+    std::string path_;
+    gzFile file_;
+    bool running_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<TrafficRecord> queue_;
+    size_t queued_bytes_;
+    bool stop_;
+    std::thread thread_;
+
+    std::atomic<uint64_t> records_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> raw_bytes_;  // 压缩前写出的字节数
+};
+
+// 顺序读取存档
+class TrafficReader {
+public:
+    TrafficReader() : file_(NULL) {}
+    ~TrafficReader() { close(); }
+
+    bool open(const std::string &path, std::string *error);
+    // 读到文件末尾或残缺的最后一条记录时返回 false
+    bool next(TrafficRecord *rec);
+    void close();
+
+private:
+    gzFile file_;
+};
+
+#endif // _TRAFFIC_CAPTURE_H
@@ -0,0 +1,55 @@
+#include "worker_pool.h"
+
+WorkerPool::WorkerPool(int threads) : stop_(false), running_(0) {
+    for (int i = 0; i < threads; i++) {
+        threads_.push_back(std::thread(&WorkerPool::run, this));
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (size_t i = 0; i < threads_.size(); i++) {
+        threads_[i].join();
+    }
+}
+
+size_t WorkerPool::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return jobs_.size();
+}
+
+bool WorkerPool::idle() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return jobs_.empty() && running_ == 0;
+}
+
+void WorkerPool::post(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(std::move(job));
+    }
+    cv_.notify_one();
+}
+
+void WorkerPool::run() {
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return stop_ || !jobs_.empty(); });
+            if (jobs_.empty()) {
+                return;  // stop_ 且队列已清空
+            }
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+            running_++;
+        }
+        job();
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_--;
+    }
+}
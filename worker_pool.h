@@ -0,0 +1,48 @@
+#ifndef _WORKER_POOL_H
+#define _WORKER_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 固定线程数的CPU任务池，submit() 返回 future 用于 fork/join
+class WorkerPool {
+public:
+    explicit WorkerPool(int threads);
+    ~WorkerPool();
+
+    int size() const { return (int)threads_.size(); }
+    // 当前排队（尚未开始执行）的任务数
+    size_t pending() const;
+    // 没有排队也没有正在执行的任务
+    bool idle() const;
+
+    template <class F>
+    std::future<typename std::result_of<F()>::type> submit(F f) {
+        typedef typename std::result_of<F()>::type R;
+        std::shared_ptr<std::packaged_task<R()> > task(new std::packaged_task<R()>(f));
+        std::future<R> result = task->get_future();
+        post([task]() { (*task)(); });
+        return result;
+    }
+
+    // 不需要结果的任务
+    void post(std::function<void()> job);
+
+private:
+    void run();
+
+    std::vector<std::thread> threads_;
+    std::deque<std::function<void()> > jobs_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_;
+    int running_;  // 正在执行的任务数
+};
+
+#endif // _WORKER_POOL_H